@@ -4,18 +4,23 @@ layout(location = 0) in vec3 attrib_position;
 layout(location = 1) in vec3 attrib_normal;
 layout(location = 2) in vec2 attrib_uv;
 
+// per instance, from the scene's instance buffer (takes locations 3 to 6)
+layout(location = 3) in mat4 attrib_model;
+
 out vec3 position;
 out vec3 normal;
 out vec2 uv;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+// bound to uniform_block::camera, updated once per frame
+layout(std140, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+};
 
 void main() {
     normal = attrib_normal;
     uv = attrib_uv;
-    gl_Position = proj * view * model * vec4(attrib_position, 1.0f);
+    gl_Position = proj * view * attrib_model * vec4(attrib_position, 1.0f);
     position = vec3(gl_Position);
 }
 
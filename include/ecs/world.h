@@ -0,0 +1,466 @@
+#ifndef ECS_WORLD_H
+#define ECS_WORLD_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "threading/thread.h"
+
+/**
+ * An archetype based entity component system. Entities with the same set of
+ * component types share an archetype, which stores them in fixed size
+ * chunks with one array per component type, so iterating over a component
+ * reads memory in order. Adding or removing a component moves an entity to
+ * another archetype.
+ */
+namespace ecs {
+
+// the most component types there can be, one bit each in a signature
+static constexpr size_t max_components = 64;
+// the size of a chunk, unless a single entity needs more
+static constexpr size_t chunk_size = 16 << 10;
+// the alignment of a chunk, and the most a component can ask for
+static constexpr size_t chunk_alignment = 64;
+
+using ComponentId = uint32_t;
+using Signature = uint64_t;
+
+/**
+ * A handle to an entity. The generation tells it apart from earlier
+ * entities that had the same index.
+ */
+struct Entity {
+    enum : uint32_t { null = UINT32_MAX };
+
+    uint32_t index = null;
+    uint32_t generation = 0;
+
+    bool operator==(Entity const &) const = default;
+};
+
+/**
+ * What the world needs to know to store a component type without knowing
+ * the type
+ */
+struct ComponentInfo {
+    size_t size;
+    size_t align;
+    /** move constructs a component into to, and destroys the one at from */
+    void (*relocate)(void *to, void *from);
+    /** destroys a component */
+    void (*destroy)(void *component);
+
+    template <typename T>
+    static ComponentInfo of() {
+        static_assert(std::is_nothrow_move_constructible_v<T>,
+            "components are moved between chunks");
+        static_assert(alignof(T) <= chunk_alignment,
+            "component aligned more than a chunk");
+        return {
+            sizeof(T),
+            alignof(T),
+            [](void *to, void *from) {
+                T *component = static_cast<T *>(from);
+                new (to) T(std::move(*component));
+                component->~T();
+            },
+            [](void *component) {
+                static_cast<T *>(component)->~T();
+            }
+        };
+    }
+};
+
+/**
+ * Gives a component type the next free id
+ * @param info how to store the type
+ * @return the id
+ */
+ComponentId registerComponent(ComponentInfo const &info);
+
+/**
+ * @param id a component id
+ * @return how to store components with the id
+ */
+ComponentInfo const &componentInfo(ComponentId id);
+
+/**
+ * @return the id of a component type, registering it on first use
+ */
+template <typename T>
+ComponentId componentId() {
+    static ComponentId const id
+        = registerComponent(ComponentInfo::of<std::remove_cv_t<T>>());
+    return id;
+}
+
+/**
+ * @return the signature with a bit set for each component type
+ */
+template <typename... Ts>
+Signature signatureOf() {
+    return (Signature(0) | ... | (Signature(1) << componentId<Ts>()));
+}
+
+/**
+ * A block of memory holding up to an archetype's capacity of entities: their
+ * handles first, then an array for each component type
+ */
+struct Chunk {
+    std::byte *data;
+    uint32_t count;
+};
+
+/**
+ * Every entity with one particular set of component types
+ */
+struct Archetype {
+    Signature signature;
+    std::vector<ComponentId> components;
+    // the offset of each component's array in a chunk, and the size of one
+    // component, indexed by component id
+    size_t offsets[max_components];
+    size_t sizes[max_components];
+    // the entities a chunk holds, and the bytes it takes
+    uint32_t capacity;
+    size_t chunk_bytes;
+    // every chunk but the last is full
+    std::vector<Chunk> chunks;
+    size_t count;
+    // the archetypes with one component added or removed, by that component
+    std::unordered_map<ComponentId, Archetype *> edges;
+
+    Entity *entities(Chunk const &chunk) const {
+        return reinterpret_cast<Entity *>(chunk.data);
+    }
+
+    template <typename T>
+    T *column(Chunk const &chunk) const {
+        return reinterpret_cast<T *>(chunk.data
+            + offsets[componentId<T>()]);
+    }
+
+    void *at(Chunk const &chunk, ComponentId id, uint32_t row) const {
+        return chunk.data + offsets[id] + row * sizes[id];
+    }
+};
+
+template <typename... Ts>
+class Query;
+
+/**
+ * Owns every entity and component
+ */
+class World {
+public:
+
+    World();
+    ~World();
+
+    World(World const &) = delete;
+    World &operator=(World const &) = delete;
+
+    /**
+     * Creates an entity
+     * @param components its components, one of each type at most
+     * @return the entity
+     */
+    template <typename... Ts>
+    Entity create(Ts &&... components) {
+        Archetype *archetype
+            = findArchetype(signatureOf<std::decay_t<Ts>...>());
+        Entity entity = allocate();
+        Location &location = place(entity, archetype);
+        Chunk const &chunk = archetype->chunks[location.chunk];
+        (new (archetype->at(chunk, componentId<std::decay_t<Ts>>(),
+                location.row))
+            std::decay_t<Ts>(std::forward<Ts>(components)), ...);
+        return entity;
+    }
+
+    /**
+     * Destroys an entity and its components
+     * @param entity the entity, must be alive
+     */
+    void destroy(Entity entity);
+
+    /**
+     * Destroys every entity
+     */
+    void clear();
+
+    /**
+     * @param entity an entity
+     * @return whether it has been created and not yet destroyed
+     */
+    bool alive(Entity entity) const {
+        return entity.index < locations.size()
+            && locations[entity.index].generation == entity.generation
+            && locations[entity.index].archetype != nullptr;
+    }
+
+    /**
+     * @param entity an entity, must be alive
+     * @return whether it has a component
+     */
+    template <typename T>
+    bool has(Entity entity) const {
+        assert(alive(entity));
+        Archetype const *archetype = locations[entity.index].archetype;
+        return archetype->signature & (Signature(1) << componentId<T>());
+    }
+
+    /**
+     * @param entity an entity, must be alive
+     * @return its component, or nullptr if it has none. Only valid until
+     *         components are next added or removed, or entities destroyed.
+     */
+    template <typename T>
+    T *get(Entity entity) {
+        if(!has<T>(entity)) {
+            return nullptr;
+        }
+        Location const &location = locations[entity.index];
+        Archetype const *archetype = location.archetype;
+        return static_cast<T *>(archetype->at(
+            archetype->chunks[location.chunk], componentId<T>(),
+            location.row));
+    }
+
+    /**
+     * Adds a component to an entity, or replaces the one it has
+     * @param entity the entity, must be alive
+     * @param component the component
+     * @return the component, valid as long as get's would be
+     */
+    template <typename T>
+    std::decay_t<T> &add(Entity entity, T &&component) {
+        using C = std::decay_t<T>;
+        if(C *existing = get<C>(entity)) {
+            *existing = std::forward<T>(component);
+            return *existing;
+        }
+
+        Location const &location = move(entity,
+            neighbour(locations[entity.index].archetype, componentId<C>()));
+        Archetype const *archetype = location.archetype;
+        return *new (archetype->at(archetype->chunks[location.chunk],
+                componentId<C>(), location.row))
+            C(std::forward<T>(component));
+    }
+
+    /**
+     * Removes a component from an entity, if it has one
+     * @param entity the entity, must be alive
+     */
+    template <typename T>
+    void remove(Entity entity) {
+        if(has<T>(entity)) {
+            move(entity, neighbour(locations[entity.index].archetype,
+                componentId<T>()));
+        }
+    }
+
+    /**
+     * @return a query over the entities with every one of some components
+     */
+    template <typename... Ts>
+    Query<Ts...> query() { return Query<Ts...>(*this); }
+
+    /**
+     * @return the number of entities alive
+     */
+    size_t size() const { return num_alive; }
+
+private:
+
+    template <typename... Ts>
+    friend class Query;
+
+    struct Location {
+        Archetype *archetype;
+        uint32_t chunk;
+        uint32_t row;
+        uint32_t generation;
+    };
+
+    // indexed by entity index, a null archetype for free indices
+    std::vector<Location> locations;
+    std::vector<uint32_t> free_indices;
+    size_t num_alive;
+
+    // never shrinks, so queries only look at the ones added since
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::unordered_map<Signature, Archetype *> signatures;
+
+    Archetype *findArchetype(Signature signature);
+    Archetype *neighbour(Archetype *archetype, ComponentId id);
+    Entity allocate();
+    Location &place(Entity entity, Archetype *archetype);
+    void erase(Archetype *archetype, uint32_t chunk, uint32_t row);
+    Location &move(Entity entity, Archetype *to);
+};
+
+/**
+ * Iterates over the entities with every one of some component types, chunk
+ * by chunk. Entities must not be created or destroyed, nor components added
+ * or removed, while a query iterates.
+ * A query remembers the archetypes it matched, so keeping one around saves
+ * looking at every archetype each time it runs.
+ */
+template <typename... Ts>
+class Query {
+public:
+
+    Query(World &world) :
+        world(world),
+        required(signatureOf<std::remove_cv_t<Ts>...>()),
+        num_seen(0) { }
+
+    /**
+     * Calls a function for each chunk of matching entities
+     * @param func called with the number of entities in the chunk, their
+     *             handles and a pointer to each component's array
+     */
+    template <typename Func>
+    void eachChunk(Func &&func) {
+        refresh();
+        for(Archetype *archetype : matches) {
+            for(Chunk const &chunk : archetype->chunks) {
+                func((size_t) chunk.count, archetype->entities(chunk),
+                    archetype->template column<std::remove_cv_t<Ts>>(chunk)...);
+            }
+        }
+    }
+
+    /**
+     * Calls a function for each matching entity
+     * @param func called with the entity's components, and optionally the
+     *             entity before them
+     */
+    template <typename Func>
+    void each(Func &&func) {
+        refresh();
+        for(Archetype *archetype : matches) {
+            for(Chunk const &chunk : archetype->chunks) {
+                rows(archetype, chunk, func);
+            }
+        }
+    }
+
+    /**
+     * Calls a function for each matching entity, splitting the chunks across
+     * a thread pool and the calling thread, and waits for every call
+     * @param pool the threads to split the work with
+     * @param func called as by each, from several threads at once
+     */
+    template <typename Func>
+    void parallelEach(ThreadPool &pool, Func const &func) {
+        refresh();
+        work.clear();
+        for(Archetype *archetype : matches) {
+            for(Chunk const &chunk : archetype->chunks) {
+                work.push_back({ archetype, &chunk });
+            }
+        }
+
+        size_t num_parts = std::min<size_t>(pool.size() + 1, work.size());
+        if(num_parts < 2) {
+            for(Work const &w : work) {
+                rows(w.archetype, *w.chunk, func);
+            }
+            return;
+        }
+
+        // every chunk but the last of each archetype is full, so splitting
+        // by chunk keeps the parts close enough in size
+        size_t part_size = (work.size() + num_parts - 1) / num_parts;
+        auto part = [this, &func](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                rows(work[i].archetype, *work[i].chunk, func);
+            }
+        };
+
+        std::latch done(num_parts - 1);
+        for(size_t p = 1; p < num_parts; p++) {
+            size_t begin = p * part_size;
+            size_t end = std::min(work.size(), begin + part_size);
+            pool.run([&part, &done, begin, end]() {
+                part(begin, end);
+                done.count_down();
+            });
+        }
+        part(0, std::min(work.size(), part_size));
+        done.wait();
+    }
+
+    /**
+     * @return the number of matching entities
+     */
+    size_t size() {
+        refresh();
+        size_t count = 0;
+        for(Archetype *archetype : matches) {
+            count += archetype->count;
+        }
+        return count;
+    }
+
+private:
+
+    struct Work {
+        Archetype *archetype;
+        Chunk const *chunk;
+    };
+
+    World &world;
+    Signature required;
+    size_t num_seen;
+    std::vector<Archetype *> matches;
+    std::vector<Work> work;
+
+    /**
+     * Picks up the archetypes created since the last call
+     */
+    void refresh() {
+        while(num_seen < world.archetypes.size()) {
+            Archetype *archetype = world.archetypes[num_seen++].get();
+            if((archetype->signature & required) == required) {
+                matches.push_back(archetype);
+            }
+        }
+    }
+
+    template <typename Func>
+    static void rows(Archetype const *archetype, Chunk const &chunk,
+            Func &func) {
+        rows(archetype->entities(chunk), chunk.count, func,
+            archetype->template column<std::remove_cv_t<Ts>>(chunk)...);
+    }
+
+    template <typename Func>
+    static void rows(Entity const *entities, uint32_t count, Func &func,
+            Ts *... columns) {
+        for(uint32_t i = 0; i < count; i++) {
+            if constexpr (std::is_invocable_v<Func &, Entity, Ts &...>) {
+                func(entities[i], columns[i]...);
+            }
+            else {
+                func(columns[i]...);
+            }
+        }
+    }
+};
+
+};
+
+#endif // ECS_WORLD_H
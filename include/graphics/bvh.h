@@ -0,0 +1,179 @@
+#ifndef GRAPHICS_BVH_H
+#define GRAPHICS_BVH_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "threading/thread.h"
+
+#include "utils/ring_queue.h"
+
+/**
+ * A dynamic bounding volume hierarchy over axis aligned boxes, for finding
+ * what is in a frustum, along a ray or near a point without looking at every
+ * box. Each box is a proxy with a leaf of its own.
+ * Moving a proxy refits the boxes above its leaf, which keeps the tree
+ * correct but lets it loosen as things move. Once its surface area cost has
+ * grown enough, the tree is rebuilt from scratch with the surface area
+ * heuristic on a worker thread, and swapped in when done. Edits made during
+ * the rebuild are carried over.
+ * Apart from the rebuild, everything runs on the thread that calls in.
+ */
+class Bvh {
+public:
+
+    enum : int { null = -1 };
+
+    Bvh();
+    ~Bvh();
+
+    /**
+     * Adds a box
+     * @param min the minimum corner of the box
+     * @param max the maximum corner of the box
+     * @return the proxy for the box, to move or remove it with
+     */
+    int insert(glm::vec3 const &min, glm::vec3 const &max);
+
+    /**
+     * Removes a box. Its proxy may be reused by a later insert.
+     * @param proxy the proxy of the box
+     */
+    void remove(int proxy);
+
+    /**
+     * Moves a box, refitting the boxes above it
+     * @param proxy the proxy of the box
+     * @param min the new minimum corner of the box
+     * @param max the new maximum corner of the box
+     */
+    void update(int proxy, glm::vec3 const &min, glm::vec3 const &max);
+
+    /**
+     * Swaps in a finished rebuild, and starts one if the tree has degraded.
+     * Meant to be called once per frame.
+     */
+    void maintain();
+
+    /**
+     * Rebuilds the tree with the surface area heuristic, and waits for it
+     */
+    void rebuild();
+
+    /**
+     * Finds the boxes that are at least partly inside a frustum
+     * @param planes the frustum planes, normals pointing inside
+     * @param out the destination, appended to
+     */
+    void query(glm::vec4 const planes[6], std::vector<int> &out) const;
+
+    /**
+     * Finds the boxes that overlap a sphere
+     * @param center the center of the sphere
+     * @param radius the radius of the sphere
+     * @param out the destination, appended to
+     */
+    void query(glm::vec3 const &center, float radius,
+            std::vector<int> &out) const;
+
+    /**
+     * Finds the nearest box along a ray
+     * @param origin the start of the ray
+     * @param direction the direction of the ray, need not be normalized
+     * @param max_distance how far along the ray to look, in multiples of
+     *                     direction
+     * @param distance the destination for how far along the ray the box
+     *                 starts, 0 if the origin is inside it
+     * @return the proxy of the box, or null if the ray hits nothing
+     */
+    int raycast(glm::vec3 const &origin, glm::vec3 const &direction,
+            float max_distance, float &distance) const;
+
+    /**
+     * @return the number of boxes in the tree
+     */
+    size_t size() const { return num_proxies; }
+
+    /**
+     * @return the surface area heuristic cost of the tree: the area of
+     *         every internal node over that of the root
+     */
+    float cost() const;
+
+private:
+
+    struct Node {
+        glm::vec3 min, max;
+        int parent;
+        // both null for a leaf
+        int left, right;
+        // the proxy of a leaf
+        int proxy;
+    };
+
+    struct Proxy {
+        glm::vec3 min, max;
+        int leaf;
+        // bumped every time the slot is reused
+        unsigned generation;
+        bool alive;
+    };
+
+    /**
+     * A proxy as it was when a rebuild started
+     */
+    struct Item {
+        glm::vec3 min, max;
+        glm::vec3 centroid;
+        int proxy;
+        unsigned generation;
+        int leaf;
+    };
+
+    struct Build {
+        std::vector<Item> items;
+        std::vector<Node> nodes;
+        int root;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> free_nodes;
+    int root;
+
+    std::vector<Proxy> proxies;
+    std::vector<int> free_proxies;
+    size_t num_proxies;
+
+    // the cost right after the last rebuild, and edits since checking it
+    float build_cost;
+    size_t edits;
+
+    // only one build runs at a time, so this has one producer
+    RingQueue<Build *, RingSharing::spsc> built;
+    bool building;
+
+    // traversal scratch, each node with the planes it still has to be
+    // tested against
+    mutable std::vector<std::pair<int, unsigned>> stack;
+
+    // last, so a build still pushing its result finishes before the queue
+    // it pushes to is destroyed
+    ThreadPool threads;
+
+    int allocateNode();
+    void freeNode(int index);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    void refit(int index);
+    Build *snapshot() const;
+    void apply(Build &build);
+
+    static int build(std::vector<Item> &items, size_t begin, size_t end,
+            int parent, std::vector<Node> &nodes);
+};
+
+#endif // GRAPHICS_BVH_H
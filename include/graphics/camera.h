@@ -3,6 +3,7 @@
 
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 /**
  * Represents a camera that can be a scene can be rendered from
@@ -16,6 +17,12 @@ struct Camera {
     glm::vec3 up;
     /** the camera's projection matrix */
     glm::mat4 proj;
+    /**
+     * the world space frustum planes as (normal, distance), normals pointing
+     * inside, from the last call to updateFrustum. In order: left, right,
+     * bottom, top, near, far.
+     */
+    glm::vec4 planes[6];
 
     /**
      * Initializes the camera
@@ -34,6 +41,11 @@ struct Camera {
      */
     void setProjection(float fov, float aspect_ratio);
     glm::mat4 getView();
+
+    /**
+     * Extracts the frustum planes from the current view and projection
+     */
+    void updateFrustum();
 };
 
 #endif // GRAPHICS_CAMERA_HH
@@ -0,0 +1,79 @@
+#ifndef GRAPHICS_CULLING_H
+#define GRAPHICS_CULLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/**
+ * Frustum culling of axis aligned boxes. Boxes are kept as a structure of
+ * arrays so that four are tested against a plane at once with SSE where
+ * available.
+ */
+namespace culling {
+
+/**
+ * World space boxes, stored as centers and half extents
+ */
+struct BoxList {
+    std::vector<float> center_x, center_y, center_z;
+    std::vector<float> extent_x, extent_y, extent_z;
+
+    /**
+     * Empties the list, keeping its memory
+     */
+    void clear();
+
+    /**
+     * @return the number of boxes in the list
+     */
+    size_t size() const { return center_x.size(); }
+
+    /**
+     * Adds a box
+     * @param center the center of the box
+     * @param extent half the size of the box along each axis
+     */
+    void push(glm::vec3 const &center, glm::vec3 const &extent);
+
+    /**
+     * Adds the world space box around a transformed object space box
+     * @param min the minimum corner of the object space box
+     * @param max the maximum corner of the object space box
+     * @param world the object's world matrix
+     */
+    void push(glm::vec3 const &min, glm::vec3 const &max,
+            glm::mat4 const &world);
+};
+
+/**
+ * Finds the world space box around a transformed object space box
+ * @param min the minimum corner of the object space box
+ * @param max the maximum corner of the object space box
+ * @param world the object's world matrix
+ * @param center the destination for the center of the world space box
+ * @param extent the destination for its half extents
+ */
+void transform(glm::vec3 const &min, glm::vec3 const &max,
+        glm::mat4 const &world, glm::vec3 &center, glm::vec3 &extent);
+
+/**
+ * Tests boxes against a frustum. A box is culled only if it is entirely
+ * behind one of the planes, so a few boxes near the corners of the frustum
+ * are kept even though they are outside of it.
+ * @param planes the frustum planes, normals pointing inside, see Camera
+ * @param boxes the boxes to test
+ * @param visible the destination, 1 for each box that may be visible and 0
+ *                for the rest, with room for boxes.size() entries
+ * @return the number of boxes that may be visible
+ */
+size_t cull(glm::vec4 const planes[6], BoxList const &boxes,
+        uint8_t *visible);
+
+};
+
+#endif // GRAPHICS_CULLING_H
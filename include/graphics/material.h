@@ -5,6 +5,8 @@
 
 #include "texture.h"
 
+#include "utils/registry.h"
+
 /**
  * Represents a loaded material
  */
@@ -14,6 +16,10 @@ struct Material {
     Texture diffuse;
     Texture specular;
     float shininess;
+    /** the path the diffuse texture was loaded from, empty if there is none */
+    std::string diffuse_map;
+    /** the diffuse texture's handle, when shared through a TextureRegistry */
+    Handle diffuse_handle;
 };
 
 #endif // GRAPHICS_MATERIAL_H
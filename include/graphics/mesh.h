@@ -1,29 +1,124 @@
 #ifndef GRAPHICS_MESH_H
 #define GRAPHICS_MESH_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
-#include "graphics/shader.h"
+#include <glm/vec3.hpp>
+
 #include "graphics/material.h"
 #include "graphics/texture.h"
 #include "graphics/vertex.h"
 
+/**
+ * A level of detail of a mesh, a range of its index buffer over the same
+ * vertices as the others
+ */
+struct MeshLod {
+    unsigned int first_index;
+    unsigned int num_indices;
+    /** how far, in object space, the level strays from the full mesh */
+    float error;
+};
+
+/**
+ * A mesh that has been loaded but not uploaded yet
+ */
+struct MeshData {
+    std::vector<Vertex> vertices;
+    /** every level of detail's indices, one after another */
+    std::vector<unsigned int> indices;
+    std::vector<Material> materials;
+    /** the paths of the material libraries the materials came from */
+    std::vector<std::string> material_libraries;
+    /** the levels of detail, the full mesh first. Empty until built. */
+    std::vector<MeshLod> lods;
+    /** the object space bounding box of the vertices */
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+};
+
 // A basic component of a model
 // If we imagine a knight, there would likely be meshes for the head, the body,
 // the arms, the legs, the sword, the shield, the helmet, ...
+// A mesh owns its OpenGL objects and the textures of its materials, so it can
+// be moved but not copied, and frees them when destroyed
 struct Mesh {
-    // OpenGL objects needed for the mesh
-    unsigned int vao, vbo, ebo;
-    unsigned int num_indices;
+    // OpenGL objects needed for the mesh, 0 when there are none
+    unsigned int vao = 0, vbo = 0, ebo = 0;
+    unsigned int num_indices = 0;
     std::vector<Material> materials;
+    // the levels of detail, finest first, set to the whole index buffer by
+    // create until setLods replaces them
+    std::vector<MeshLod> lods;
+    // object space bounding box and the sphere around it, filled in by
+    // whoever loaded the mesh through setBounds
+    glm::vec3 bounds_min, bounds_max;
+    glm::vec3 center;
+    float radius = 0.0f;
+
+    Mesh() = default;
+    Mesh(Mesh const &) = delete;
+    Mesh &operator=(Mesh const &) = delete;
+    Mesh(Mesh &&other) noexcept;
+    Mesh &operator=(Mesh &&other) noexcept;
+    ~Mesh();
 
     void create(std::vector<Vertex> vertices,
             std::vector<unsigned int> indices,
             std::vector<Material> materials);
+
+    /**
+     * Uploads a mesh straight from memory the caller owns, such as a mapped
+     * cache file
+     * @param vertices the vertices
+     * @param num_vertices the number of vertices
+     * @param indices the triangle indices
+     * @param num_indices the number of indices
+     * @param materials the materials used by the mesh
+     */
+    void create(Vertex const *vertices, size_t num_vertices,
+            unsigned int const *indices, size_t num_indices,
+            std::vector<Material> materials);
+
+    /**
+     * Sets the object space bounding box, and the bounding sphere around it
+     * @param min the minimum corner of the box
+     * @param max the maximum corner of the box
+     */
+    void setBounds(glm::vec3 const &min, glm::vec3 const &max);
+
+    /**
+     * Sets the levels of detail, leaving the whole index buffer as the only
+     * level if there are none
+     * @param levels the levels of detail, finest first
+     */
+    void setLods(std::vector<MeshLod> levels);
+
+    /**
+     * Frees the OpenGL objects and textures of the mesh. Does nothing if
+     * the mesh has none.
+     */
     void destroy();
 
-    void draw(ShaderProgram const &shader);
+    /**
+     * Points the per instance model matrix (attribute locations 3 to 6) of
+     * the mesh at a buffer of tightly packed matrices
+     * @param buffer the instance buffer
+     */
+    void bindInstanceBuffer(unsigned int buffer);
+
+    /**
+     * Draws instances of the mesh, one per matrix in its instance buffer.
+     * Its vertex array and material textures must already be bound, which
+     * the RenderQueue takes care of.
+     * @param instances the number of instances to draw
+     * @param base_instance the first matrix to use
+     * @param lod the level of detail to draw
+     */
+    void draw(unsigned int instances, unsigned int base_instance,
+            unsigned int lod = 0) const;
 };
 
 #endif // GRAPHICS_MESH_H
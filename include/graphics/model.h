@@ -4,13 +4,20 @@
 #include <string>
 #include <vector>
 
+#include <glm/vec3.hpp>
+
 #include "graphics/mesh.h"
 #include "graphics/shader.h"
 
 // Represents a model, which is represented by a list of meshes
 // Currently only support loading from a OBJ file
+// Like its meshes, a model can be moved but not copied
 struct Model {
     std::vector<Mesh> meshes;
+    // object space bounds of every mesh together, and the sphere around them
+    glm::vec3 bounds_min, bounds_max;
+    glm::vec3 center;
+    float radius = 0.0f;
 
     /**
      * Creates a model from the specified file
@@ -18,9 +25,11 @@ struct Model {
      * @return whether or not loading is successful
      */
     bool create(std::string path);
-    void destroy();
 
-    void draw(ShaderProgram const &shader);
+    /**
+     * Destroys every mesh of the model
+     */
+    void destroy();
 };
 
 #endif // GRAPHICS_MODEL_H
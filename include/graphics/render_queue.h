@@ -0,0 +1,90 @@
+#ifndef GRAPHICS_RENDER_QUEUE_H
+#define GRAPHICS_RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "graphics/mesh.h"
+#include "graphics/shader.h"
+
+/**
+ * One instanced draw of a mesh
+ */
+struct DrawPacket {
+    /** orders the packet against the others, see RenderQueue::makeKey */
+    uint64_t key;
+    ShaderProgram const *shader;
+    Mesh const *mesh;
+    unsigned int instances;
+    unsigned int base_instance;
+    /** the mesh's level of detail */
+    unsigned int lod;
+    /** the shader's mat.shininess, so submit never looks it up by name */
+    UniformHandle shininess;
+};
+
+/**
+ * Collects the draws of a frame, sorts them so that draws sharing state end
+ * up next to each other, then submits them while skipping the OpenGL calls
+ * that would not change anything.
+ */
+struct RenderQueue {
+
+    /**
+     * The draws and state changes made by the last submit
+     */
+    struct Stats {
+        unsigned draw_calls;
+        unsigned instances;
+        unsigned program_binds;
+        unsigned vertex_array_binds;
+        unsigned texture_binds;
+        unsigned uniform_sets;
+    };
+
+    std::vector<DrawPacket> packets;
+    Stats stats;
+
+    /**
+     * Packs a sort key. From the most significant bits down it holds the
+     * pass (2 bits), the shader (12), the material's diffuse texture (14),
+     * the vertex array (12) and the depth (24). Ids are truncated to their
+     * field, so a collision only costs a state change.
+     * @param pass the pass to draw in, lower passes are drawn first
+     * @param shader the shader to draw with
+     * @param mesh the mesh to draw
+     * @param depth the view space distance, nearer is drawn first
+     * @return the key
+     */
+    static uint64_t makeKey(unsigned int pass, ShaderProgram const &shader,
+            Mesh const &mesh, float depth);
+
+    /**
+     * Empties the queue, keeping its memory for the next frame
+     */
+    void clear() { packets.clear(); }
+
+    /**
+     * Queues a draw
+     * @param packet the draw
+     */
+    void push(DrawPacket const &packet) { packets.push_back(packet); }
+
+    /**
+     * Sorts the queued draws by key, with a radix sort
+     */
+    void sort();
+
+    /**
+     * Draws everything queued, in order. Instance buffers and uniform blocks
+     * must already be filled and bound.
+     */
+    void submit();
+
+private:
+
+    // the other half of the radix sort's ping-pong
+    std::vector<DrawPacket> scratch;
+};
+
+#endif // GRAPHICS_RENDER_QUEUE_H
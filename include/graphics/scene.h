@@ -1,74 +1,500 @@
 #ifndef GRAPHICS_SCENE_H
 #define GRAPHICS_SCENE_H
 
-#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <map>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <glad/gl.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
 
+#include "ecs/world.h"
+
+#include "graphics/bvh.h"
 #include "graphics/camera.h"
+#include "graphics/culling.h"
 #include "graphics/mesh.h"
+#include "graphics/model.h"
+#include "graphics/render_queue.h"
 #include "graphics/shader.h"
+#include "graphics/transform_hierarchy.h"
+#include "graphics/uniform_buffer.h"
+
+#include "threading/thread.h"
+
+#include "utils/registry.h"
 
-struct SceneObject {
-    Model model;
-    glm::mat4 world;
+/**
+ * Every object drawn with the same mesh and shader. The mesh carries its
+ * material, so a batch is drawn with one instanced call per level of detail.
+ */
+struct SceneBatch {
+    ShaderProgram const *shader;
+    Mesh const *mesh;
+    // the shader's mat.shininess, resolved when the batch is made
+    UniformHandle shininess;
+    // the transforms of the objects the spatial index found in the frustum
+    // this frame, by the level of detail they are drawn at
+    std::vector<std::vector<int>> visible;
 };
 
+/**
+ * The component placing an entity in the scene's transforms
+ */
+struct SceneTransform {
+    /** the entity's id in the scene's transforms */
+    int id;
+};
+
+/**
+ * The component drawing an entity
+ */
+struct SceneRenderable {
+    /** the model, a handle into the scene's models */
+    Handle model;
+    /** the entity's proxy in the scene's spatial index */
+    int proxy;
+    /** the batches the model's meshes are drawn in */
+    std::vector<SceneBatch *> batches;
+    /** the level of detail each mesh was last drawn at */
+    std::vector<uint8_t> lods;
+    /** the world space box around the model, refit whenever it moves */
+    glm::vec3 bounds_min, bounds_max;
+};
+
+/**
+ * The objects in a scene are entities. Each has a SceneTransform, and a
+ * SceneRenderable if it is drawn, next to whatever other components the
+ * game gives it. Each frame runs the scene's systems over them in turn:
+ * the transform update, the refit of the spatial index around whatever
+ * moved, then the extraction of the visible instances into the render
+ * queue. The refit and the extraction are chunk queries over the drawn
+ * entities, their per entity work split across a pool of workers, and only
+ * what has to stay on one thread (the spatial index and the batches' lists)
+ * left to a serial pass over the same chunks.
+ */
 struct Scene {
 
-    std::list<SceneObject *> objects;
-    std::map<ShaderProgram, std::list<SceneObject>> shader_obj_map;
+    // every model in the scene, keyed by the path it was loaded from
+    Registry<std::string, Model> models;
+
+    // the shaders the batches are drawn with
+    std::set<ShaderProgram> shaders;
+
+    // keyed by (shader, vertex array), the render queue orders them
+    std::map<std::pair<unsigned int, unsigned int>, SceneBatch> batches;
+
+    // every object
+    ecs::World entities;
+
+    // the drawn objects, kept as one query so that running it only looks at
+    // the archetypes made since
+    ecs::Query<SceneTransform const, SceneRenderable> renderables{ entities };
+
+    // the threads the systems split their chunks across, besides the
+    // calling thread, shared with the rest of the engine
+    ThreadPool &workers;
+
+    // every object's transform, and the entity each transform belongs to
+    TransformHierarchy transforms{ workers };
+    std::vector<ecs::Entity> transform_entities;
+    // set for the transforms the running update recomputed
+    std::vector<uint8_t> transform_moved;
+
+    // the world space box of every drawn object's model, and the entity
+    // each proxy belongs to
+    Bvh spatial;
+    std::vector<ecs::Entity> proxy_entities;
+    std::vector<int> visible_proxies;
+    // set for the proxies in visible_proxies while a frame is extracted
+    std::vector<uint8_t> proxy_visible;
+
+    UniformBuffer camera_buffer;
+
+    // every instance's model matrix, batch by batch
+    unsigned int instance_buffer;
+    size_t instance_capacity;
+    std::vector<glm::mat4> instance_staging;
+
+    // the world space box of every instance, and whether it is visible
+    culling::BoxList instance_bounds;
+    std::vector<uint8_t> instance_visible;
+
+    // the frame's draws, and the state changes they took
+    RenderQueue queue;
+
+    // the error, as a share of the screen's height, a level of detail may
+    // show before a finer one is drawn instead
+    float lod_threshold = 0.002f;
+    // how far under the threshold a coarser level must be to replace the
+    // one drawn last frame, so objects at the boundary do not flicker
+    float lod_hysteresis = 0.25f;
+
+    /**
+     * @param workers the pool to split the systems' work across, besides
+     *                the calling thread. Shared with whatever else uses it,
+     *                and must outlive the scene.
+     */
+    explicit Scene(ThreadPool &workers) : workers(workers) { }
+
+    void create() {
+        camera_buffer.create(sizeof(CameraBlock));
+
+        instance_capacity = 0;
+        glGenBuffers(1, &instance_buffer);
+    }
+
+    void destroy() {
+        entities.query<SceneRenderable const>().each(
+            [this](SceneRenderable const &renderable) {
+                spatial.remove(renderable.proxy);
+            });
+        entities.clear();
+        proxy_entities.clear();
+        proxy_visible.clear();
+        transform_entities.clear();
+        transform_moved.clear();
+
+        batches.clear();
+        shaders.clear();
+
+        for (auto &[handle, model] : models.entries) {
+            model.destroy();
+        }
+        models.entries.clear();
+        models.registry.clear();
+
+        camera_buffer.destroy();
+        glDeleteBuffers(1, &instance_buffer);
+    }
+
+    /**
+     * Loads a model into the scene, or finds it if it is already loaded
+     * @param path the path to the model
+     * @return a handle to the model, invalid if it could not be loaded
+     */
+    Handle loadModel(std::string const &path) {
+        Handle handle = models.find(path);
+        if (handle.id != Handle::invalid) {
+            return handle;
+        }
+
+        Model model;
+        if (!model.create(path)) {
+            return Handle{};
+        }
+        return models.put(path, std::move(model));
+    }
+
+    /**
+     * Adds an object to the scene
+     * @param model the object's model, from loadModel
+     * @param local the object's transform, relative to its parent
+     * @param s the shader to draw it with
+     * @param parent the object to attach it to, or a null entity
+     * @return the object's entity
+     */
+    ecs::Entity addObject(Handle model, Transform const &local,
+            ShaderProgram const &s, ecs::Entity parent = ecs::Entity{}) {
+        auto [iter, inserted] = shaders.insert(s);
+        ShaderProgram const &shader = *iter;
+        if (inserted) {
+            // the texture units never change, so only set them once
+            glUseProgram(shader.id);
+            shader.setUniformInt("mat.diffuse", 0);
+            shader.setUniformInt("mat.ambient", 1);
+            shader.setUniformInt("mat.specular", 2);
+        }
+
+        SceneTransform transform;
+        transform.id = transforms.create(local,
+            parent.index == ecs::Entity::null ? TransformHierarchy::null
+                : entities.get<SceneTransform>(parent)->id);
+
+        // the next update places it, once its world matrix is known
+        SceneRenderable renderable;
+        renderable.model = model;
+        renderable.proxy = spatial.insert(glm::vec3(0.0f), glm::vec3(0.0f));
+        renderable.bounds_min = renderable.bounds_max = glm::vec3(0.0f);
+
+        for (Mesh &mesh : models[model].meshes) {
+            auto [batch_iter, new_batch]
+                = batches.try_emplace({ shader.id, mesh.vao });
+            SceneBatch &batch = batch_iter->second;
+            if (new_batch) {
+                batch.shader = &shader;
+                batch.mesh = &mesh;
+                batch.shininess = shader.uniform("mat.shininess");
+                batch.visible.resize(mesh.lods.size());
+                mesh.bindInstanceBuffer(instance_buffer);
+            }
+            renderable.batches.push_back(&batch);
+            renderable.lods.push_back(0);
+        }
+
+        int id = transform.id;
+        int proxy = renderable.proxy;
+        ecs::Entity entity
+            = entities.create(transform, std::move(renderable));
 
-    SceneObject &addObject(Model m, glm::mat4 wld, ShaderProgram s) {
-        decltype(shader_obj_map)::iterator iter;
-        std::list<SceneObject> &list = shader_obj_map[s];
-        SceneObject &so = list.emplace_back();
-        so = {m, wld};
-        objects.push_back(&so);
-        return so;
+        if (id >= (int) transform_entities.size()) {
+            transform_entities.resize(id + 1);
+            transform_moved.resize(id + 1);
+        }
+        transform_entities[id] = entity;
+        if (proxy >= (int) proxy_entities.size()) {
+            proxy_entities.resize(proxy + 1);
+            proxy_visible.resize(proxy + 1);
+        }
+        proxy_entities[proxy] = entity;
+
+        return entity;
+    }
+
+    /**
+     * @param entity an object
+     * @return its id in the scene's transforms
+     */
+    int transformOf(ecs::Entity entity) {
+        return entities.get<SceneTransform>(entity)->id;
+    }
+
+    /**
+     * Finds the world space box around a model
+     * @param model the model
+     * @param world the model's world matrix
+     * @param min the destination for the minimum corner
+     * @param max the destination for the maximum corner
+     */
+    void worldBounds(Handle model, glm::mat4 const &world, glm::vec3 &min,
+            glm::vec3 &max) {
+        Model &m = models[model];
+        glm::vec3 center, extent;
+        culling::transform(m.bounds_min, m.bounds_max, world, center, extent);
+        min = center - extent;
+        max = center + extent;
+    }
+
+    /**
+     * Runs the scene's systems short of drawing: propagates the transforms
+     * changed since the last update down the hierarchy, then refits the
+     * spatial index around every drawn object moved
+     */
+    void update() {
+        transforms.update();
+        std::vector<int> const &changed = transforms.changed();
+        if (changed.empty()) {
+            return;
+        }
+
+        // the boxes are refit across the workers, then handed to the
+        // spatial index, which only takes them one at a time
+        for (int id : changed) {
+            transform_moved[id] = 1;
+        }
+        renderables.parallelEach(workers,
+            [this](SceneTransform const &transform,
+                    SceneRenderable &renderable) {
+                if (transform_moved[transform.id]) {
+                    worldBounds(renderable.model,
+                        transforms.world(transform.id),
+                        renderable.bounds_min, renderable.bounds_max);
+                }
+            });
+        renderables.each([this](SceneTransform const &transform,
+                SceneRenderable const &renderable) {
+            if (transform_moved[transform.id]) {
+                spatial.update(renderable.proxy, renderable.bounds_min,
+                    renderable.bounds_max);
+            }
+        });
+        for (int id : changed) {
+            transform_moved[id] = 0;
+        }
     }
 
+    /**
+     * Picks the level of detail to draw a mesh at: the coarsest whose error
+     * stays under the threshold on screen. Levels coarser than the current
+     * one must beat the threshold by the hysteresis margin.
+     * @param mesh the mesh
+     * @param current the level drawn last frame
+     * @param scale the share of the screen's height one object space unit
+     *              covers at the mesh's distance
+     * @return the level
+     */
+    unsigned int selectLod(Mesh const &mesh, unsigned int current,
+            float scale) const {
+        unsigned int lod = 0;
+        while (lod + 1 < mesh.lods.size()) {
+            float limit = lod + 1 > current
+                ? lod_threshold * (1.0f - lod_hysteresis)
+                : lod_threshold;
+            if (mesh.lods[lod + 1].error * scale > limit) {
+                break;
+            }
+            lod++;
+        }
+        return lod;
+    }
+
+    /**
+     * Finds the object whose bounds a ray enters first
+     * @param origin the start of the ray
+     * @param direction the direction of the ray
+     * @return the object, or a null entity if the ray hits nothing
+     */
+    ecs::Entity pick(glm::vec3 const &origin, glm::vec3 const &direction) {
+        float distance;
+        int proxy = spatial.raycast(origin, direction,
+            std::numeric_limits<float>::max(), distance);
+        return proxy == Bvh::null ? ecs::Entity{} : proxy_entities[proxy];
+    }
+
+    /**
+     * Draws every object. Nothing is allocated once the staging vector has
+     * grown to fit every instance.
+     * @param cam the camera to draw from
+     */
     void draw(Camera &cam) {
-        // calculate view matrix
+        update();
+
         glm::mat4 view = cam.getView();
+        CameraBlock camera = { view, cam.proj };
+        camera_buffer.update(&camera, sizeof(camera));
+        camera_buffer.bind(uniform_block::camera);
 
-        for (auto &[shader, objs] : shader_obj_map) {
+        // find the objects in the frustum through the spatial index, then
+        // cull their meshes at once, batch by batch
+        cam.updateFrustum();
+        spatial.maintain();
+        visible_proxies.clear();
+        spatial.query(cam.planes, visible_proxies);
 
-            glUseProgram(shader.id);
-            glUniformMatrix4fv(
-                glGetUniformLocation(shader.id, "view"),
-                1,
-                GL_FALSE,
-                glm::value_ptr(view)
-            );
-
-            glUniformMatrix4fv(
-                glGetUniformLocation(shader.id, "proj"),
-                1,
-                GL_FALSE,
-                glm::value_ptr(cam.proj)
-            );
-
-            for (auto &obj : objs) {
-                
-                glUniformMatrix4fv(
-                    glGetUniformLocation(shader.id, "model"),
-                    1,
-                    GL_FALSE,
-                    glm::value_ptr(obj.world)
-                );
-
-                shader.setUniformInt("mat.diffuse", 0);
-                shader.setUniformInt("mat.ambient", 1);
-                shader.setUniformInt("mat.specular", 2);
-
-                obj.model.draw(shader);
+        for (auto &[key, batch] : batches) {
+            for (std::vector<int> &level : batch.visible) {
+                level.clear();
             }
         }
+
+        for (int proxy : visible_proxies) {
+            proxy_visible[proxy] = 1;
+        }
+
+        // pick each visible mesh's level of detail from how large its
+        // error would show at its distance, where proj[1][1] is the
+        // cotangent of half the vertical field of view, across the workers
+        float projection = cam.proj[1][1] * 0.5f;
+        renderables.parallelEach(workers,
+            [this, &cam, projection](SceneTransform const &transform,
+                    SceneRenderable &renderable) {
+                if (!proxy_visible[renderable.proxy]) {
+                    return;
+                }
+
+                glm::mat4 const &world = transforms.world(transform.id);
+                float scale = std::max({ glm::length(glm::vec3(world[0])),
+                    glm::length(glm::vec3(world[1])),
+                    glm::length(glm::vec3(world[2])) });
+
+                for (size_t i = 0; i < renderable.batches.size(); i++) {
+                    Mesh const &mesh = *renderable.batches[i]->mesh;
+                    glm::vec3 center(world * glm::vec4(mesh.center, 1.0f));
+                    float distance = std::max(glm::length(center - cam.pos)
+                        - mesh.radius * scale, 1e-3f);
+
+                    renderable.lods[i] = selectLod(mesh, renderable.lods[i],
+                        scale * projection / distance);
+                }
+            });
+
+        // then file them into their batches, which are shared, on this
+        // thread
+        renderables.each([this](SceneTransform const &transform,
+                SceneRenderable const &renderable) {
+            if (!proxy_visible[renderable.proxy]) {
+                return;
+            }
+            for (size_t i = 0; i < renderable.batches.size(); i++) {
+                renderable.batches[i]->visible[renderable.lods[i]]
+                    .push_back(transform.id);
+            }
+        });
+        for (int proxy : visible_proxies) {
+            proxy_visible[proxy] = 0;
+        }
+
+        instance_bounds.clear();
+        for (auto &[key, batch] : batches) {
+            for (std::vector<int> const &level : batch.visible) {
+                for (int id : level) {
+                    instance_bounds.push(batch.mesh->bounds_min,
+                        batch.mesh->bounds_max, transforms.world(id));
+                }
+            }
+        }
+        instance_visible.resize(instance_bounds.size());
+        culling::cull(cam.planes, instance_bounds, instance_visible.data());
+
+        // gather the visible instances' matrices, batch by batch, and queue
+        // a draw for each batch keyed by its nearest instance
+        instance_staging.clear();
+        queue.clear();
+        size_t instance = 0;
+        for (auto &[key, batch] : batches) {
+            glm::vec4 center(batch.mesh->center, 1.0f);
+            for (unsigned int lod = 0; lod < batch.visible.size(); lod++) {
+                unsigned int base_instance = instance_staging.size();
+                float depth = std::numeric_limits<float>::max();
+                for (int id : batch.visible[lod]) {
+                    if (!instance_visible[instance++]) {
+                        continue;
+                    }
+                    glm::mat4 const &world = transforms.world(id);
+                    instance_staging.push_back(world);
+                    depth = std::min(depth, -(view * world * center).z);
+                }
+
+                unsigned int count = instance_staging.size() - base_instance;
+                if (count == 0) {
+                    continue;
+                }
+
+                queue.push({
+                    RenderQueue::makeKey(0, *batch.shader, *batch.mesh,
+                        depth),
+                    batch.shader,
+                    batch.mesh,
+                    count,
+                    base_instance,
+                    lod,
+                    batch.shininess
+                });
+            }
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+        if (instance_staging.size() > instance_capacity) {
+            instance_capacity = std::max(instance_staging.size(),
+                instance_capacity * 2);
+            glBufferData(GL_ARRAY_BUFFER,
+                instance_capacity * sizeof(glm::mat4), nullptr,
+                GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0,
+            instance_staging.size() * sizeof(glm::mat4),
+            instance_staging.data());
+
+        queue.sort();
+        queue.submit();
     }
 };
 
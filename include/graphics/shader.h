@@ -2,6 +2,33 @@
 #define UTILS_SHADER_H
 
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+/**
+ * An active uniform of a shader program, found when the program is linked
+ */
+struct Uniform {
+    std::string name;
+    int location;
+    /** the GLSL type, e.g. GL_FLOAT_MAT4 */
+    unsigned int type;
+    /** the number of elements, more than 1 for arrays */
+    int size;
+};
+
+/**
+ * The location of a uniform, resolved once up front instead of by name on
+ * every use. Setting through an invalid handle does nothing.
+ */
+struct UniformHandle {
+    int location = -1;
+
+    bool valid() const { return location != -1; }
+};
 
 /**
  * Represents an OpenGL shader program
@@ -9,6 +36,8 @@
 struct ShaderProgram {
     /** The ID of the program */
     unsigned int id;
+    /** the active uniforms outside of uniform blocks, sorted by name */
+    std::vector<Uniform> uniforms;
 
     /**
      * Compiles a basic shader program
@@ -28,6 +57,25 @@ struct ShaderProgram {
      */
     void use();
 
+    /**
+     * Looks up a uniform in the table built at link time, without calling
+     * into OpenGL
+     * @param name the name of the uniform
+     * @return a handle to the uniform, invalid if the program has none
+     */
+    UniformHandle uniform(std::string_view name) const;
+
+    /**
+     * Sets uniforms through pre-resolved handles. The shader must be bound
+     * for these to work properly
+     * @param handle the uniform to set
+     * @param value the value to set the uniform to
+     */
+    void set(UniformHandle handle, int value) const;
+    void set(UniformHandle handle, float value) const;
+    void set(UniformHandle handle, glm::vec3 const &value) const;
+    void set(UniformHandle handle, glm::mat4 const &value) const;
+
     /**
      * Sets an integer uniform in the given shader program. The shader must be
      * bound for this to work properly
@@ -35,7 +83,7 @@ struct ShaderProgram {
      * @param value the value to set the uniform too
      * @return whether or not the function succeeded
      */
-    bool setUniformInt(std::string name, int value) const;
+    bool setUniformInt(std::string_view name, int value) const;
 
     /**
      * Sets an float uniform in the given shader program. The shader must be
@@ -44,14 +92,14 @@ struct ShaderProgram {
      * @param value the value to set the uniform too
      * @return whether or not the function succeeded
      */
-    bool setUniformFloat(std::string name, float value) const;
+    bool setUniformFloat(std::string_view name, float value) const;
 
     /**
      * A less than operator for maps
      * @param other the other shader program to compare to
      * @return whether or not this shader program is less than the other
      */
-    bool operator<(ShaderProgram const other) const;
+    bool operator<(ShaderProgram const &other) const;
 };
 
 #endif // UTILS_SHADER_H
@@ -3,6 +3,29 @@
 
 #include <string>
 
+/**
+ * How the texels of a texture are stored
+ */
+enum class TextureFormat {
+    // uncompressed, 4 bytes per texel
+    rgba8,
+
+    // block compressed, see utils/block_compress.h
+    bc1,
+    bc3,
+    bc7
+};
+
+/**
+ * One level of a texture's mip chain, either tightly packed RGBA8 or blocks
+ * of a compressed format
+ */
+struct TextureLevel {
+    int width;
+    int height;
+    unsigned char const *pixels;
+};
+
 /**
  * Represents an OpenGL texture
  */
@@ -11,12 +34,33 @@ struct Texture {
     unsigned int id;
 
     /**
-     * Creates a texture from the specified file path
+     * Creates a texture from the specified file path. A fresh cooked copy of
+     * the file is used instead when there is one, otherwise the mip chain is
+     * built on the CPU.
      * @path the path to the file
      * @return whether or not the texture was successfully created
      */
     bool create(std::string path);
 
+    /**
+     * Creates a texture from decoded levels. Only the levels given are
+     * sampled, so pass the full chain for mipmapping.
+     * @param levels the mip chain, largest first
+     * @param num_levels the number of levels
+     * @param format the format the levels are stored in
+     */
+    void create(TextureLevel const *levels, int num_levels,
+            TextureFormat format = TextureFormat::rgba8);
+
+    /**
+     * Uploads one level into the bound texture
+     * @param level the level to upload
+     * @param index the mip level to upload it as
+     * @param format the format the level is stored in
+     */
+    static void uploadLevel(TextureLevel const &level, int index,
+            TextureFormat format);
+
     /**
      * Destroys the given texture
      */
@@ -0,0 +1,117 @@
+#ifndef GRAPHICS_TEXTURE_LOADER_H
+#define GRAPHICS_TEXTURE_LOADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "graphics/texture.h"
+
+#include "threading/thread.h"
+
+#include "utils/image.h"
+#include "utils/tsq.h"
+
+/**
+ * Loads textures in the background. Decoding (or reading a cooked copy) and
+ * building the mip chain happen on worker threads, and the GL thread uploads
+ * the finished levels a few at a time under a per-frame byte budget.
+ * A texture is usable as soon as it is requested: it starts out as a 1x1
+ * placeholder, then sharpens as its levels arrive, smallest first.
+ * Whoever destroys a texture still loading must cancel it first, since GL
+ * hands a freed texture name out again and the upload would land in
+ * whatever texture took it.
+ */
+class TextureLoader {
+private:
+
+    /**
+     * A texture whose levels are being decoded or uploaded
+     */
+    struct Request {
+        unsigned int id;
+        std::string path;
+        std::vector<Image> levels;
+        TextureFormat format;
+        bool ok;
+
+        // the smallest level not yet uploaded, counting down to 0
+        int next_level;
+
+        // set by cancel, only touched on the GL thread
+        bool cancelled;
+    };
+
+    ThreadPool threads;
+    TSQ<Request *> decoded;
+    Request *uploading;
+    std::atomic<unsigned> num_pending;
+
+    // the requests not yet finished or cancelled, by texture id. Only
+    // touched on the GL thread.
+    std::unordered_map<unsigned int, Request *> requests;
+
+    static TextureLoader *active;
+
+    void decode(Request *request);
+
+    void uploadLevel(Request &request);
+
+    void finish();
+
+public:
+
+    /**
+     * @param num_threads the number of decoding threads
+     */
+    TextureLoader(unsigned num_threads);
+
+    ~TextureLoader();
+
+    /**
+     * Creates a placeholder texture and queues the real image to be decoded.
+     * Must be called on the GL thread. The texture keeps its id once the
+     * image arrives, so copies of it taken now see the real image too.
+     * @param texture the texture to create
+     * @param path the path to the image file
+     */
+    void load(Texture &texture, std::string const &path);
+
+    /**
+     * Stops loading a texture, so nothing more is uploaded to its id. Must
+     * be called on the GL thread, before the texture is destroyed. Does
+     * nothing if the texture is not loading.
+     * @param id the id of the texture
+     */
+    void cancel(unsigned int id);
+
+    /**
+     * Uploads decoded levels until the byte budget is used up. Must be
+     * called on the GL thread, once per frame. At least one level is
+     * uploaded per call if one is ready, however large it is.
+     * @param byte_budget the number of bytes to upload at most
+     * @return the number of bytes uploaded
+     */
+    size_t update(size_t byte_budget);
+
+    /**
+     * @return the number of textures not yet fully uploaded
+     */
+    unsigned pending() const { return num_pending; }
+
+    /**
+     * Sets the loader that material textures are loaded through. With none
+     * set, textures are loaded synchronously.
+     * @param loader the loader to use, or nullptr
+     */
+    static void use(TextureLoader *loader) { active = loader; }
+
+    /**
+     * @return the loader set with use(), or nullptr
+     */
+    static TextureLoader *current() { return active; }
+};
+
+#endif // GRAPHICS_TEXTURE_LOADER_H
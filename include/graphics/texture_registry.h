@@ -0,0 +1,116 @@
+#ifndef GRAPHICS_TEXTURE_REGISTRY_H
+#define GRAPHICS_TEXTURE_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "graphics/texture.h"
+
+#include "utils/asset_stamp.h"
+#include "utils/registry.h"
+
+/**
+ * Shares textures between everything that uses the same image. Textures are
+ * keyed by the hash of the image's contents, found through its canonical
+ * path, so the same file reached by different paths (or two identical
+ * files) is decoded and uploaded once.
+ * Textures are reference counted through acquire and release. Once nothing
+ * references a texture it stays resident in case it is wanted again, until
+ * the textures resident exceed the memory budget, at which point the least
+ * recently released are destroyed first.
+ */
+class TextureRegistry {
+private:
+
+    struct Entry {
+        Texture texture;
+        uint64_t hash;
+        std::string path;
+
+        // estimated bytes of texture memory
+        size_t size;
+
+        unsigned refs;
+
+        // position in the unused list, valid while refs is 0
+        std::list<Handle>::iterator unused_it;
+    };
+
+    Registry<uint64_t, Entry> textures;
+
+    // canonical path to the stamp of the file last seen there
+    std::unordered_map<std::string, AssetStamp> stamps;
+
+    // unreferenced textures, least recently released first
+    std::list<Handle> unused;
+
+    size_t budget;
+    size_t resident;
+
+    static TextureRegistry *active;
+
+    void evict();
+
+public:
+
+    /**
+     * @param budget the bytes of texture memory to keep resident at most,
+     *               unless more than that is referenced
+     */
+    TextureRegistry(size_t budget);
+
+    /**
+     * Gets a texture for an image, loading it if it is not resident. Loads
+     * go through the current TextureLoader if one is in use. Must be called
+     * on the GL thread.
+     * @param path the path to the image file
+     * @return a handle to the texture, to be released when done with, or an
+     *         invalid handle if the file could not be read
+     */
+    Handle acquire(std::string const &path);
+
+    /**
+     * Drops a reference to a texture
+     * @param handle a handle from acquire
+     */
+    void release(Handle handle);
+
+    /**
+     * @param handle a handle from acquire that has not been released
+     * @return the texture
+     */
+    Texture const &operator[](Handle handle) { return textures[handle].texture; }
+
+    /**
+     * Sets the memory budget, evicting unused textures to fit it
+     * @param bytes the bytes of texture memory to keep resident at most
+     */
+    void setBudget(size_t bytes);
+
+    /**
+     * @return the estimated bytes of texture memory in use
+     */
+    size_t residentSize() const { return resident; }
+
+    /**
+     * Destroys every texture, referenced or not
+     */
+    void destroy();
+
+    /**
+     * Sets the registry that material textures are shared through. With
+     * none set, each material loads its own.
+     * @param registry the registry to use, or nullptr
+     */
+    static void use(TextureRegistry *registry) { active = registry; }
+
+    /**
+     * @return the registry set with use(), or nullptr
+     */
+    static TextureRegistry *current() { return active; }
+};
+
+#endif // GRAPHICS_TEXTURE_REGISTRY_H
@@ -0,0 +1,157 @@
+#ifndef GRAPHICS_TRANSFORM_HIERARCHY_H
+#define GRAPHICS_TRANSFORM_HIERARCHY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "threading/thread.h"
+
+/**
+ * A local transform, applied as scale, then rotation, then translation
+ */
+struct Transform {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+/**
+ * Transforms arranged in a hierarchy, each relative to its parent.
+ * Local transforms and world matrices are stored as structures of arrays,
+ * sorted by depth in the hierarchy so that every parent comes before its
+ * children. Transforms are referred to by ids that stay the same as they
+ * move around in the arrays.
+ * Changing a transform queues it at its depth. An update then works down
+ * the queued depths, recomputing world matrices and queueing the children
+ * of each transform it recomputes, so it only touches the subtrees below
+ * what changed. Depths with enough transforms to recompute are split across
+ * worker threads.
+ * Adding, removing and reparenting transforms leave the arrays out of order
+ * until enough of them have piled up to be worth a sort, so attaching a
+ * transform only costs the update of its own subtree.
+ */
+class TransformHierarchy {
+public:
+
+    enum : int { null = -1 };
+
+    /**
+     * @param threads the pool to split large updates across, besides the
+     *                calling thread. Shared with whatever else uses it, and
+     *                must outlive the hierarchy.
+     */
+    TransformHierarchy(ThreadPool &threads);
+
+    /**
+     * Adds a transform
+     * @param local the transform relative to its parent
+     * @param parent the id of the parent, or null for a root
+     * @return the id of the transform
+     */
+    int create(Transform const &local, int parent = null);
+
+    /**
+     * Removes a transform and everything below it. Their ids may be reused
+     * by later calls to create.
+     * @param id the transform
+     */
+    void destroy(int id);
+
+    /**
+     * Moves a transform, and everything below it, under another parent. Its
+     * local transform is kept, so it moves in the world.
+     * @param id the transform
+     * @param parent the id of the new parent, or null to make it a root.
+     *               Must not be below the transform.
+     */
+    void setParent(int id, int parent);
+
+    /**
+     * @param id the transform
+     * @return the id of its parent, or null for a root
+     */
+    int parent(int id) const;
+
+    /**
+     * Sets all or part of a local transform
+     * @param id the transform
+     */
+    void setLocal(int id, Transform const &local);
+    void setPosition(int id, glm::vec3 const &position);
+    void setRotation(int id, glm::quat const &rotation);
+    void setScale(int id, glm::vec3 const &scale);
+
+    /**
+     * @param id the transform
+     * @return its transform relative to its parent
+     */
+    Transform local(int id) const;
+
+    /**
+     * @param id the transform
+     * @return its world matrix as of the last update
+     */
+    glm::mat4 const &world(int id) const { return worlds[slots[id]]; }
+
+    /**
+     * Recomputes the world matrices of everything changed since the last
+     * update, and of everything below it
+     */
+    void update();
+
+    /**
+     * @return the ids whose world matrices the last update recomputed
+     */
+    std::vector<int> const &changed() const { return changed_ids; }
+
+    /**
+     * @return the number of transforms
+     */
+    size_t size() const { return num_alive; }
+
+private:
+
+    // indexed by slot, in depth order after an update
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<int> parents;
+    std::vector<int> first_children;
+    std::vector<int> next_siblings;
+    std::vector<unsigned> depths;
+    // the id in each slot, null once destroyed
+    std::vector<int> ids;
+    // 1 while a slot is queued, 2 while its depth is being processed
+    std::vector<uint8_t> dirty;
+
+    // the slot of each id, null for free ids
+    std::vector<int> slots;
+    std::vector<int> free_ids;
+    size_t num_alive;
+
+    // queued slots by depth
+    std::vector<std::vector<int>> pending;
+
+    // the slots added, removed or reparented out of order since the last sort
+    size_t num_unsorted;
+
+    std::vector<int> changed_ids;
+
+    ThreadPool &threads;
+
+    void markDirty(int slot);
+    void link(int slot, int parent_slot);
+    void unlink(int slot);
+    void updateDepths(int slot);
+    void process(int depth, std::vector<int> &level);
+    void sort();
+    void computeWorlds(int const *level, size_t count);
+};
+
+#endif // GRAPHICS_TRANSFORM_HIERARCHY_H
@@ -0,0 +1,64 @@
+#ifndef GRAPHICS_UNIFORM_BUFFER_H
+#define GRAPHICS_UNIFORM_BUFFER_H
+
+#include <cstddef>
+
+#include <glm/mat4x4.hpp>
+
+/**
+ * The binding points of the uniform blocks shared by every shader. Blocks
+ * with these names are bound to them when a shader program is created.
+ */
+namespace uniform_block {
+
+enum : unsigned int {
+    // Camera, set once per frame
+    camera = 0
+};
+
+};
+
+/**
+ * The std140 layout of the Camera block
+ */
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 proj;
+};
+
+/**
+ * Represents an OpenGL uniform buffer
+ */
+struct UniformBuffer {
+    /** the id of the buffer */
+    unsigned int id;
+    /** the size of the buffer in bytes */
+    size_t size;
+
+    /**
+     * Creates an empty uniform buffer
+     * @param size the size of the buffer in bytes
+     */
+    void create(size_t size);
+
+    /**
+     * Writes into the buffer
+     * @param data the data to write
+     * @param size the number of bytes to write
+     * @param offset where in the buffer to write them
+     */
+    void update(void const *data, size_t size, size_t offset = 0);
+
+    /**
+     * Binds the whole buffer to a uniform block binding point
+     * @param binding the binding point
+     */
+    void bind(unsigned int binding);
+
+    /**
+     * Destroys the buffer
+     */
+    void destroy();
+};
+
+#endif // GRAPHICS_UNIFORM_BUFFER_H
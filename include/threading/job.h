@@ -1,182 +1,253 @@
 #ifndef UTILS_JOB_H
 #define UTILS_JOB_H
 
-#include <deque>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <functional>
-#include <list>
-#include <map>
-#include <mutex>
+#include <memory>
 #include <ostream>
 #include <string>
-#include <syncstream>
-#include <thread>
-#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "engine.h"
 #include "threading/thread.h"
-#include "utils/log.h"
-#include "utils/tsq.h"
 
+/**
+ * Runs a graph of jobs on a thread pool once per iteration (a frame), each
+ * job once its dependencies have finished, starting from a root job.
+ * Several frames can be in flight at once. A job waits for its own run in
+ * the frame before, but not for the rest of that frame, so the jobs late in
+ * one frame overlap the jobs early in the next. runIteration returns the
+ * frame it started, which wait then serves as a fence for.
+ * Jobs are registered by name, but are kept in a flat array and refer to
+ * each other by id. Each job has an atomic counter per frame in flight of
+ * the dependencies that have finished, which only ever goes up: the n-th
+ * time a counter is used, its job is ready once it reaches n times the
+ * job's number of dependencies. So a finished dependency costs its dependent
+ * one atomic add, and nothing has to be reset between frames.
+ */
 class JobManager {
-private:
+public:
 
-    struct Job;
+    using JobId = unsigned;
+    using ResourceId = unsigned;
+    using Frame = uint64_t;
 
-    struct Edge {
-        Job *dependent;
-        Job *dependency;
+private:
+
+    // a job waiting for another, in the same frame or lag frames later
+    struct Link {
+        JobId job;
+        uint32_t lag;
     };
 
     struct Job {
-        unsigned id;
         std::string name;
         std::function<void (void *)> entry;
         void *arg;
-        std::vector<Edge *> dependencies;
-        std::vector<Edge *> dependents;
+        std::vector<Link> dependents;
+        unsigned num_dependencies;
+    };
+
+    struct Resource {
+        std::string name;
+        JobId writer;
+        std::vector<JobId> readers;
+    };
+
+    // kept apart, since different threads bump different counters
+    struct alignas(64) Counter {
+        std::atomic<uint64_t> finished;
+    };
+
+    struct alignas(64) Slot {
+        // jobs of the slot's frame still to finish
+        std::atomic<uint32_t> remaining;
+        // one past the last frame finished in the slot
+        std::atomic<Frame> completed;
     };
 
     bool compiled;
-    std::list<Edge> edges;
-    std::map<std::string, Job> jobs;
-    Job *root;
+    unsigned frames_in_flight;
+    std::vector<Job> jobs;
+    std::unordered_map<std::string, JobId> ids;
+    std::vector<std::pair<JobId, JobId>> edges;
+    std::vector<Resource> resources;
+
+    // built by compile: every job's dependents back to back, job i's from
+    // dependents_begin[i] up to dependents_begin[i + 1]
+    std::vector<Link> dependents;
+    std::vector<uint32_t> dependents_begin;
+    // one counter per job for each frame in flight, frame by frame
+    std::unique_ptr<Counter[]> counters;
+    std::unique_ptr<Slot[]> slots;
+    Frame iteration;
+
+    // last, so running jobs finish before anything they use is destroyed
     ThreadPool threads;
-    unsigned *dependency_matrix;
-    std::mutex dep_mat_sync;
 
-    static void rootDummyFuncImpl(void *) {
-        //std::osyncstream(std::cerr) << "Running __root\n";
-    }
+    // the frame the job running on this thread is for
+    static thread_local Frame current_frame;
+
+    static void rootDummyFuncImpl(void *) { }
+
+    void finish(JobId id, Frame frame);
+    void run(JobId id, Frame frame);
 
 public:
 
-    JobManager() :
+    static constexpr JobId root = 0;
+
+    /**
+     * @param frames_in_flight the most frames that run at once
+     */
+    JobManager(unsigned frames_in_flight = 2) :
         compiled(false),
-        threads(5),
-        dependency_matrix(nullptr) {
-        
-        root = &jobs["__root"];
-        root->name = "__root";
-        root->entry = rootDummyFuncImpl;
-        root->arg = nullptr;
-    }
+        frames_in_flight(frames_in_flight),
+        iteration(0),
+        threads(5) {
 
-    ~JobManager() {
-        //std::osyncstream(std::cerr) << "Destructing JobManager@" << this << "\n";
-        if (compiled) {
-            delete[] dependency_matrix;
-        }
+        assert(frames_in_flight > 0);
+        registerJob("__root", rootDummyFuncImpl, nullptr);
     }
 
-    Job *graphRoot() { return root; }
+    /**
+     * Waits for the frames in flight
+     */
+    ~JobManager();
 
-    Job *findJob(std::string name) {
-        return &jobs.at(name);
-    }
+    JobId graphRoot() { return root; }
 
-    Job *registerJob(std::string name, std::function<void (void *)> ef, void *arg) {
-        assert(!compiled);
-        Job &j = jobs[name];
-        j.name = name;
-        j.entry = ef;
-        j.arg = arg;
-        return &j;
+    JobId findJob(std::string const &name) {
+        return ids.at(name);
     }
 
-    void registerDependencies(Job *) { return; }
-
+    /**
+     * Adds a job, or replaces the function of the one with the same name
+     * @param name the job's name
+     * @param ef the function to run
+     * @param arg passed to the function
+     * @return the job's id
+     */
+    JobId registerJob(std::string const &name,
+            std::function<void (void *)> ef, void *arg);
+
+    void registerDependencies(JobId) { return; }
+
+    /**
+     * Makes a job wait for others in each frame. A job with no
+     * dependencies waits for the root.
+     * @param dependent the job to wait
+     * @param dependency a job it waits for, and optionally more
+     */
     template <typename... Args>
-    void registerDependencies(Job *dependent, Job *dependency, Args... args) {
+    void registerDependencies(JobId dependent, JobId dependency, Args... args) {
         assert(!compiled);
-        Edge *edge = &edges.emplace_back(Edge{dependent, dependency});
-        dependent->dependencies.push_back(edge);
-        dependency->dependents.push_back(edge);
+        edges.emplace_back(dependent, dependency);
+        jobs[dependency].dependents.push_back({ dependent, 0 });
+        jobs[dependent].num_dependencies++;
         registerDependencies(dependent, args...);
     }
 
-    std::ostream &dumpGraph(std::ostream &os) const {
-        os << "digraph {\n";
-        for (auto &edge : edges) {
-            os << "    " << edge.dependent->name << " -> " << edge.dependency->name << "\n";
-        }
-        os << "}\n";
-        return os;
-    }
+    /**
+     * Adds a resource that one job writes each frame and others read. It
+     * is meant to be kept in a DoubleBuffered, so the writer can fill in
+     * one frame's copy while readers are still on the frame before's.
+     * @param name the resource's name, for dumpGraph
+     * @return the resource's id
+     */
+    ResourceId registerResource(std::string const &name);
+
+    /**
+     * Makes a job the one that writes a resource. Readers in a frame then
+     * wait for it, and it waits for the readers two frames back, which
+     * used the same copy.
+     */
+    void registerWrite(JobId job, ResourceId resource);
+
+    /**
+     * Makes a job read a resource
+     */
+    void registerRead(JobId job, ResourceId resource);
+
+    std::ostream &dumpGraph(std::ostream &os) const;
+
+    /**
+     * @return the pool the jobs run on, which other work that splits itself
+     *         across threads can share rather than starting a pool of its own
+     */
+    ThreadPool &pool() { return threads; }
 
     friend std::ostream &operator<<(std::ostream &os, JobManager const &manager) {
         return manager.dumpGraph(os);
     }
 
-    void compile() {
-        assert(!compiled);
-        compiled = true;
-
-        // generate dependency matrix
-        dependency_matrix = new unsigned[jobs.size()];
-        unsigned id_gen = 0;
-        for (auto &[name, job] : jobs) {
-            job.id = id_gen;
-            dependency_matrix[id_gen] = job.dependencies.size();
-            //std::osyncstream(std::cerr) << std::format("Job '{}': id={}, dm[id]={}\n", name, id_gen, dependency_matrix[id_gen]);
-            id_gen++;
-        }
-
-        assert(dependency_matrix[root->id] == 0);
-    }
+    /**
+     * Fixes the graph, after which no jobs, dependencies or resources can
+     * be added
+     */
+    void compile();
+
+    /**
+     * Starts the next frame, first waiting for the frame frames_in_flight
+     * back to finish
+     * @return the frame started
+     */
+    Frame runIteration();
+
+    /**
+     * @param frame a frame that has been started
+     * @return whether every job in it has finished
+     */
+    bool finished(Frame frame) const;
+
+    /**
+     * Blocks until every job in a frame has finished
+     * @param frame a frame that has been started
+     */
+    void wait(Frame frame) const;
+
+    /**
+     * @return the frame the calling job is running for. Only valid in a job.
+     */
+    static Frame frame() { return current_frame; }
+};
 
+/**
+ * Two copies of something a job graph writes one frame while the frame
+ * before is still being read. See JobManager::registerResource.
+ */
+template <typename T>
+class DoubleBuffered {
 private:
 
-    static void jobRunner(JobManager &jm, Job &job) {
-
-        //std::osyncstream(std::cerr) << std::format("Starting job '{}'...\n", job.name);
-
-        // run job
-        std::invoke(job.entry, job.arg);
-
-        //std::osyncstream(std::cerr) << std::format("Finished job '{}'...\n", job.name);
-        
-        //  update all dependents
-        for (Edge *edge : job.dependents) {
-            //std::osyncstream(std::cerr) << std::format("{} -- Checking dependent '{}'...\n", job.name, edge->dependent->name);
-
-            // get entry from dependency matrix
-            unsigned *dep_entry = jm.dependency_matrix + edge->dependent->id;
-
-            jm.dep_mat_sync.lock();
-
-            // >> CRITICAL SECTION
-
-            //std::osyncstream(std::cerr) << std::format("{} -- CRITICAL SECTION start...\n", job.name);
-
-            assert(*dep_entry > 0);
-
-            // update dependency counter
-            *dep_entry -= 1;
-
-            // if there are no dependencies left
-            if (*dep_entry == 0) {
-                
-                // reset this job's dependency counter for next iteration
-                *dep_entry = edge->dependent->dependencies.size();
-
-                // run it
-                jm.threads.run(jobRunner, jm, *edge->dependent);
-            }
-
-            // << CRITICAL SECTION
-
-            //std::osyncstream(std::cerr) << std::format("{} -- CRITICAL SECTION end...\n", job.name);
-
-            jm.dep_mat_sync.unlock();
-        }
-    }
+    T copies[2];
 
 public:
 
-    void runIteration() {
-        threads.run(jobRunner, *this, *root);
+    DoubleBuffered(T const &initial = T()) : copies{ initial, initial } { }
+
+    /**
+     * @return the copy for a frame
+     */
+    T &get(JobManager::Frame frame) { return copies[frame % 2]; }
+
+    /**
+     * @return the copy for the frame the calling job is running for
+     */
+    T &current() { return get(JobManager::frame()); }
+
+    /**
+     * @return the copy for the frame before the calling job's, which holds
+     *         the initial value in the first frame
+     */
+    T &previous() {
+        // the same copy as the frame before, without wrapping at frame 0
+        return get(JobManager::frame() + 1);
     }
-
 };
 
 
@@ -0,0 +1,129 @@
+#ifndef THREADING_TASK_H
+#define THREADING_TASK_H
+
+#include <concepts>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * A move only function with no arguments and return type void.
+ * Functions up to inline_size bytes are stored in the task itself, and
+ * tasks made with new come from a free list kept by each thread, so queueing
+ * a small function never touches the heap. Larger functions are moved to
+ * the heap.
+ */
+class Task {
+public:
+
+    // the largest function stored without a heap allocation
+    static constexpr size_t inline_size = 48;
+
+    Task() : ops(nullptr) { }
+
+    template <typename Func>
+    requires (!std::same_as<std::decay_t<Func>, Task>)
+        && std::invocable<std::decay_t<Func> &>
+    Task(Func &&func) {
+        using F = std::decay_t<Func>;
+        if constexpr (fitsInline<F>()) {
+            new (storage) F(std::forward<Func>(func));
+            ops = &inlineOps<F>;
+        }
+        else {
+            *reinterpret_cast<F **>(storage) = new F(std::forward<Func>(func));
+            ops = &heapOps<F>;
+        }
+    }
+
+    Task(Task &&other) noexcept : ops(other.ops) {
+        if(ops) {
+            ops->relocate(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept {
+        if(this != &other) {
+            reset();
+            ops = other.ops;
+            if(ops) {
+                ops->relocate(storage, other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(Task const &) = delete;
+    Task &operator=(Task const &) = delete;
+
+    ~Task() { reset(); }
+
+    /**
+     * Calls the function, which must be set
+     */
+    void operator()() { ops->invoke(storage); }
+
+    explicit operator bool() const { return ops != nullptr; }
+
+    /**
+     * Allocates a task from the calling thread's free list
+     */
+    static void *operator new(size_t size);
+
+    /**
+     * Returns a task to the free list of the thread that allocated it. May
+     * be called from any thread.
+     */
+    static void operator delete(void *task);
+
+private:
+
+    struct Ops {
+        void (*invoke)(void *storage);
+        // move constructs into to, and destroys what is left in from
+        void (*relocate)(void *to, void *from);
+        void (*destroy)(void *storage);
+    };
+
+    template <typename F>
+    static constexpr bool fitsInline() {
+        return sizeof(F) <= inline_size
+            && alignof(F) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible_v<F>;
+    }
+
+    template <typename F>
+    static constexpr Ops inlineOps = {
+        [](void *storage) { (*std::launder(static_cast<F *>(storage)))(); },
+        [](void *to, void *from) {
+            F *func = std::launder(static_cast<F *>(from));
+            new (to) F(std::move(*func));
+            func->~F();
+        },
+        [](void *storage) { std::launder(static_cast<F *>(storage))->~F(); }
+    };
+
+    template <typename F>
+    static constexpr Ops heapOps = {
+        [](void *storage) { (**static_cast<F **>(storage))(); },
+        [](void *to, void *from) {
+            *static_cast<F **>(to) = *static_cast<F **>(from);
+        },
+        [](void *storage) { delete *static_cast<F **>(storage); }
+    };
+
+    Ops const *ops;
+    alignas(std::max_align_t) std::byte storage[inline_size];
+
+    void reset() {
+        if(ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+};
+
+#endif // THREADING_TASK_H
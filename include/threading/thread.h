@@ -1,57 +1,81 @@
 #ifndef UTILS_THREAD_H
 #define UTILS_THREAD_H
 
+#include <atomic>
 #include <cassert>
 #include <concepts>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
-#include <iostream>
-#include <ostream>
-#include <syncstream>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <type_traits>
+#include <vector>
 
 #include "engine.h"
-#include "utils/tsq.h"
+#include "threading/task.h"
+#include "threading/work_deque.h"
 
 
 /**
  * A pool of threads that can be used to run any function
  * with return type void.
- * Functions can be queued to be run by a thread at any
- * point after construction. Once the thread pool is
- * initialized, tasks will be run in the order they were
- * added.
+ * Every thread has a deque of its own. Functions queued
+ * from one of the pool's threads go on its deque and it
+ * runs the newest first, which keeps a job and the jobs
+ * it spawns on one core. Functions queued from anywhere
+ * else go on a shared queue and are run oldest first.
+ * A thread with nothing to do steals the oldest function
+ * from a random other thread, and once it has spun and
+ * yielded for a while without finding any, it parks until
+ * more are queued. No order is promised between functions.
  */
 class ThreadPool {
 private:
 
-    struct Response {
-        unsigned code;
+    struct Worker {
+        WorkDeque<Task *> deque;
+        std::thread thread;
+        // xorshift state for picking who to steal from
+        uint32_t seed;
     };
 
-    struct Command {
-        enum { run, die } cmd;
-        std::function<void ()> func;
-    };
+    // the most threads a pool can ever have added
+    static constexpr unsigned max_workers = 64;
 
+    // a slot is filled before num_workers counts it, and is never emptied
+    // while the pool lives, so thieves can look at any counted slot
+    std::unique_ptr<Worker> workers[max_workers];
+    std::atomic<unsigned> num_workers;
     unsigned num;
-    TSQ<Command> commandQueue;
-    TSQ<Response> responseQueue;
-
-    static void runner(TSQ<Command> &commandQueue, TSQ<Response> &responseQueue) {
-        Command cmd;
-        while(true) {
-            cmd = commandQueue.pop();
-            switch (cmd.cmd) {
-            case Command::die:
-                return;
-            default:
-                break;
-            }
-            std::invoke(cmd.func);
-            //responseQueue.push(Response{0});
-        }
-    }
+    // kills that no thread has taken up yet
+    std::atomic<unsigned> retiring;
+
+    // taken from at injected_head, and only compacted once that is well
+    // in, so queueing from outside the pool does not allocate either
+    std::mutex injected_sync;
+    std::vector<Task *> injected;
+    size_t injected_head;
+    std::atomic<size_t> num_injected;
+
+    std::mutex sleep_sync;
+    std::condition_variable wake;
+    std::atomic<unsigned> num_sleeping;
+    // bumped under sleep_sync each time parked threads are woken
+    std::atomic<uint64_t> epoch;
+
+    // the pool and worker the calling thread belongs to, if any
+    static thread_local ThreadPool *local_pool;
+    static thread_local Worker *local_worker;
+
+    void submit(Task *task);
+    void notify(bool all);
+    Task *find(Worker &self);
+    bool hasWork();
+    bool retire();
+    void park();
+    void runner(Worker &self);
 
     // Reference wrapping utility for function arg binding
     template <typename T>
@@ -59,17 +83,14 @@ private:
     template <typename T>
     static T &&maybeRefWrap(T &&t) { return std::forward<T>(t); }
 
-    template <typename T, typename... Args>
-    static void compileErrorToShowTypeHelper(T &&t, Args &&... args) {
-        using X = typename T::nothing;
-        compileErrorToShowTypeHelper(std::forward<Args>(args)...);
-    }
-
 public:
 
     /**
-     * Queues a function to be run by the next available
-     * thread in the thread pool.
+     * Queues a function to be run by a thread in the
+     * thread pool. Called from one of the pool's threads,
+     * the function is likely to run on that same thread.
+     * Functions small enough to fit in a Task are queued
+     * without allocating, and need only be movable.
      * All args are perfectly forwarded and bound to the
      * function at the time of this call. Be careful when
      * passing references as arguments and then modifying
@@ -81,12 +102,13 @@ public:
     template <typename Callable, typename... Args>
     requires std::invocable<Callable, Args...>
     ThreadPool &run(Callable &&func, Args &&... args) {
-        //compileErrorToShowTypeHelper(std::forward<Args>(args)...);
-        Command cmd{
-            Command::run,
-            std::function<void ()>(std::bind(std::forward<Callable>(func), maybeRefWrap(std::forward<Args>(args))...))
-        };
-        commandQueue.push(cmd);
+        if constexpr (sizeof...(Args) == 0) {
+            submit(new Task(std::forward<Callable>(func)));
+        }
+        else {
+            submit(new Task(std::bind(std::forward<Callable>(func),
+                maybeRefWrap(std::forward<Args>(args))...)));
+        }
         return *this;
     }
 
@@ -96,47 +118,35 @@ public:
      * @param n the number of threads to add
      * @return this threadpool instance for call chaining
      */
-    ThreadPool &add(unsigned n) {
-        std::osyncstream(std::cerr) << "ThreadPool@" << this << " -- adding " << n << " threads\n";
-        for (unsigned i = 0; i < n; i++) {
-            std::thread t(runner, std::ref(commandQueue), std::ref(responseQueue));
-            t.detach();
-        }
-        num += n;
-        return *this;
-    }
+    ThreadPool &add(unsigned n);
 
     /**
      * Kills threads and removes them from the pool.
-     * Threads are killed via a kill command, meaning
-     * that some (or all) threads may not be killed
+     * A thread only dies once it finds nothing left to run,
+     * meaning that some (or all) threads may not be killed
      * immediately.
      * @param n the number of threads to kill
      * @return this threadpool instance for call chaining
      */
-    ThreadPool &kill(unsigned n) {
-        assert(n <= num && "kill more threads than are in the pool?");
-        for (unsigned i = 0; i < n; i++) {
-            Command dieCmd{Command::die};
-            commandQueue.push(dieCmd);
-        }
-        num -= n;
-        return *this;
-    }
+    ThreadPool &kill(unsigned n);
 
     /**
      * Kills all of the threads in the pool.
-     * May not take immediate effect due to other
-     * commands in queue or non-idling threads.
+     * May not take immediate effect due to queued
+     * functions or non-idling threads.
      * @return this threadpool instance for call chaining
      */
     ThreadPool &killAll() { kill(num); return *this; }
 
     unsigned size() { return num; }
 
-    ThreadPool(unsigned n) : num(0) { add(n); }
+    ThreadPool(unsigned n);
 
-    ~ThreadPool() { killAll(); }
+    /**
+     * Kills all of the threads and waits for them to finish
+     * what is queued
+     */
+    ~ThreadPool();
 };
 
 #endif
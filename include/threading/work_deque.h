@@ -0,0 +1,151 @@
+#ifndef THREADING_WORK_DEQUE_H
+#define THREADING_WORK_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A lock free work stealing deque (Chase and Lev, with the memory orders of
+ * Le et al.). One thread owns the deque and pushes and pops at the bottom,
+ * newest first. Any other thread may steal from the top, oldest first.
+ * The ring grows when full. Outgrown rings are kept until the deque is
+ * destroyed, since a thief may still be reading one.
+ */
+template <typename T>
+class WorkDeque {
+private:
+
+    static_assert(std::is_trivially_copyable_v<T>,
+        "items are copied in and out of the ring with plain atomics");
+
+    struct Ring {
+        int64_t capacity;
+        std::atomic<T> *items;
+
+        Ring(int64_t capacity) :
+            capacity(capacity),
+            items(new std::atomic<T>[capacity]) { }
+
+        ~Ring() { delete[] items; }
+
+        T get(int64_t i) const {
+            return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T item) {
+            items[i & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    // apart, so thieves bumping the top do not slow the owner's bottom
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<Ring *> ring;
+    std::vector<Ring *> outgrown;
+
+    Ring *grow(Ring *old, int64_t b, int64_t t) {
+        Ring *bigger = new Ring(old->capacity * 2);
+        for(int64_t i = t; i < b; i++) {
+            bigger->put(i, old->get(i));
+        }
+        outgrown.push_back(old);
+        ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+public:
+
+    /**
+     * @param capacity the starting size of the ring, a power of two
+     */
+    WorkDeque(int64_t capacity = 256) :
+        top(0),
+        bottom(0),
+        ring(new Ring(capacity)) { }
+
+    ~WorkDeque() {
+        delete ring.load(std::memory_order_relaxed);
+        for(Ring *r : outgrown) {
+            delete r;
+        }
+    }
+
+    WorkDeque(WorkDeque const &) = delete;
+    WorkDeque &operator=(WorkDeque const &) = delete;
+
+    /**
+     * Adds an item at the bottom. Only the owner may call this.
+     * @param item the item
+     */
+    void push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Ring *r = ring.load(std::memory_order_relaxed);
+        if(b - t > r->capacity - 1) {
+            r = grow(r, b, t);
+        }
+        r->put(b, item);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    /**
+     * Takes the newest item. Only the owner may call this.
+     * @param item the destination for the item
+     * @return whether there was one
+     */
+    bool pop(T &item) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring *r = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if(t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = r->get(b);
+        if(t == b) {
+            // the last item, which a thief may be taking at the same time
+            bool won = top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    /**
+     * Takes the oldest item. Any thread may call this.
+     * @param item the destination for the item
+     * @return whether one was taken. False when empty, or when another
+     *         thread took the item first.
+     */
+    bool steal(T &item) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b) {
+            return false;
+        }
+
+        Ring *r = ring.load(std::memory_order_acquire);
+        item = r->get(t);
+        return top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    /**
+     * @return whether the deque looked empty, which may be stale by the
+     *         time the caller looks at it
+     */
+    bool empty() const {
+        return bottom.load(std::memory_order_relaxed)
+            <= top.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // THREADING_WORK_DEQUE_H
@@ -0,0 +1,39 @@
+#ifndef UTILS_ASSET_STAMP_H
+#define UTILS_ASSET_STAMP_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Identifies the version of a source asset that a cache or cooked file was
+ * built from. Stored as is inside those files.
+ */
+struct AssetStamp {
+    /** the size of the source in bytes */
+    uint64_t size;
+    /** the modification time of the source, in file clock ticks */
+    int64_t mtime;
+    /** the 64 bit FNV-1a hash of the source's contents */
+    uint64_t hash;
+
+    /**
+     * Stamps a source file
+     * @param path the path to the source file
+     * @return whether or not the file could be read
+     */
+    bool create(std::string const &path);
+
+    /**
+     * Checks whether a source file still matches this stamp. The size and
+     * modification time are compared first, and the contents are only hashed
+     * when the modification time has moved (e.g. after a fresh checkout).
+     * @param path the path to the source file
+     * @param touched set if the contents match but the modification time
+     *                did not, in which case the stamp takes the new time and
+     *                should be written back
+     * @return whether or not the source is unchanged
+     */
+    bool matches(std::string const &path, bool &touched);
+};
+
+#endif // UTILS_ASSET_STAMP_H
@@ -0,0 +1,48 @@
+#ifndef UTILS_BLOCK_COMPRESS_H
+#define UTILS_BLOCK_COMPRESS_H
+
+#include <cstddef>
+
+#include "graphics/texture.h"
+
+#include "utils/image.h"
+
+/**
+ * A CPU encoder for the BC texture formats, used when cooking textures.
+ * Every format works on 4x4 texel blocks; images that are not a multiple of
+ * 4 in size are padded by repeating their edge texels.
+ *   BC1 - 8 bytes per block, RGB, for opaque colour maps
+ *   BC3 - 16 bytes per block, BC1 colour plus a separate alpha block
+ *   BC7 - 16 bytes per block, RGBA at much higher quality. Only mode 6 (one
+ *         endpoint pair with 4 bit indices) is produced.
+ */
+namespace block_compress {
+
+/**
+ * Gets the number of bytes a level takes up in a format
+ * @param format the format of the level
+ * @param width the width of the level in texels
+ * @param height the height of the level in texels
+ * @return the size of the level in bytes
+ */
+size_t levelSize(TextureFormat format, int width, int height);
+
+/**
+ * Checks whether any texel of an image is not fully opaque
+ * @param image the image to check
+ * @return whether or not the image uses its alpha channel
+ */
+bool hasAlpha(Image const &image);
+
+/**
+ * Compresses an RGBA8 image
+ * @param src the image to compress
+ * @param format the block format to compress to, not rgba8
+ * @param dest the destination, with the same size as the source and the
+ *             blocks in place of its pixels, in rows from the top down
+ */
+void encode(Image const &src, TextureFormat format, Image &dest);
+
+};
+
+#endif // UTILS_BLOCK_COMPRESS_H
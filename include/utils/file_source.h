@@ -0,0 +1,142 @@
+#ifndef UTILS_FILE_SOURCE_H
+#define UTILS_FILE_SOURCE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+/**
+ * A read-only source of a file's contents.
+ * The file is memory mapped when the platform allows it, otherwise it is
+ * streamed through a large aligned buffer one chunk at a time. Either way,
+ * lines are handed out as string views into the mapping or the buffer, so
+ * nothing is copied into per-line strings.
+ */
+class FileSource {
+private:
+
+    static constexpr size_t chunk_size = 1 << 20;
+    static constexpr size_t chunk_align = 4096;
+
+    size_t file_size;
+    bool mapped;
+
+    // mapped mode
+    char const *mapping;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#else
+    int fd;
+#endif
+
+    // streamed mode
+    std::FILE *stream;
+    char *buffer;
+    size_t buffer_capacity;
+
+    // line cursor, into either the mapping or the buffer
+    char const *cur;
+    char const *end;
+
+    bool mapFile(std::string const &path);
+    bool refill();
+
+public:
+
+    /**
+     * Input iterator over the lines of a file source
+     */
+    class LineIterator {
+    private:
+        FileSource *source;
+        std::string_view line;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::string_view const *;
+        using reference = std::string_view const &;
+
+        LineIterator() : source(nullptr) { }
+        LineIterator(FileSource *src) : source(src) { ++(*this); }
+
+        reference operator*() const { return line; }
+        pointer operator->() const { return &line; }
+
+        LineIterator &operator++() {
+            if(source && !source->nextLine(line)) {
+                source = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(LineIterator const &other) const {
+            return source == other.source;
+        }
+    };
+
+    /**
+     * Range over the remaining lines of a file source
+     */
+    struct Lines {
+        FileSource *source;
+        LineIterator begin() { return LineIterator(source); }
+        LineIterator end() { return LineIterator(); }
+    };
+
+    FileSource();
+    ~FileSource();
+
+    FileSource(FileSource const &) = delete;
+    FileSource &operator=(FileSource const &) = delete;
+
+    /**
+     * Opens a file, memory mapping it if possible and falling back to
+     * chunked reads otherwise
+     * @param path the path to the file
+     * @return whether or not the file could be opened
+     */
+    bool open(std::string const &path);
+
+    /**
+     * Releases the mapping or buffer. Any views handed out become invalid.
+     */
+    void close();
+
+    /**
+     * @return whether or not the whole file is mapped into memory
+     */
+    bool isMapped() const { return mapped; }
+
+    /**
+     * @return the size of the file in bytes
+     */
+    size_t size() const { return file_size; }
+
+    /**
+     * Gets the contents of the whole file. Only available when mapped.
+     * @return a view of the file, empty if the file is being streamed
+     */
+    std::string_view data() const {
+        return mapped ? std::string_view(mapping, file_size) : std::string_view();
+    }
+
+    /**
+     * Reads the next line, without its trailing newline. The view stays valid
+     * until the next call in streamed mode, and until close in mapped mode.
+     * @param line the destination for the line
+     * @return whether or not there was another line
+     */
+    bool nextLine(std::string_view &line);
+
+    /**
+     * @return a range over the remaining lines, for use in range-based for
+     */
+    Lines lines() { return Lines{ this }; }
+};
+
+#endif // UTILS_FILE_SOURCE_H
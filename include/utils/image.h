@@ -0,0 +1,23 @@
+#ifndef UTILS_IMAGE_H
+#define UTILS_IMAGE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * A decoded image, tightly packed RGBA8 rows from the top down
+ */
+struct Image {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+
+    /**
+     * Decodes an image file (PNG, JPEG, TGA, BMP, ...) to RGBA8
+     * @param path the path to the image file
+     * @return whether or not the image could be decoded
+     */
+    bool create(std::string const &path);
+};
+
+#endif // UTILS_IMAGE_H
@@ -0,0 +1,55 @@
+#ifndef UTILS_MESH_CACHE_H
+#define UTILS_MESH_CACHE_H
+
+#include <string>
+#include <vector>
+
+#include "graphics/mesh.h"
+
+/**
+ * Binary caches of parsed meshes, written next to the source asset as
+ * <source>.meshcache. A cache holds the vertices already in the Vertex layout,
+ * the indices of every level of detail, the bounds and the materials (by
+ * name and texture path), so loading one is a map and an upload with no
+ * parsing.
+ * The header records the size, modification time and hash of the source,
+ * and of every material library it names, since the materials are baked in
+ * too. A cache whose source or libraries have changed is treated as missing,
+ * and is rewritten the next time the source is parsed.
+ */
+namespace mesh_cache {
+
+/**
+ * Gets the path of the cache for a source asset
+ * @param source_path the path to the source asset
+ * @return the path to its cache
+ */
+std::string cachePath(std::string const &source_path);
+
+/**
+ * Checks whether the cache of a source asset exists and is up to date,
+ * without loading it
+ * @param source_path the path to the source asset
+ * @return whether or not the cache is fresh
+ */
+bool isFresh(std::string const &source_path);
+
+/**
+ * Loads meshes from the cache of a source asset, if it is up to date
+ * @param meshes the destination to load to
+ * @param source_path the path to the source asset
+ * @return whether or not a fresh cache was found and loaded
+ */
+bool load(std::vector<Mesh> &meshes, std::string const &source_path);
+
+/**
+ * Writes the cache for a source asset, replacing any existing one
+ * @param data the parsed mesh
+ * @param source_path the path to the source asset it was parsed from
+ * @return whether or not the cache was written
+ */
+bool save(MeshData const &data, std::string const &source_path);
+
+};
+
+#endif // UTILS_MESH_CACHE_H
@@ -0,0 +1,45 @@
+#ifndef UTILS_MESH_SIMPLIFY_H
+#define UTILS_MESH_SIMPLIFY_H
+
+#include <cstddef>
+#include <vector>
+
+#include "graphics/mesh.h"
+#include "graphics/vertex.h"
+
+/**
+ * Mesh simplification by edge collapse with quadric error metrics (Garland
+ * and Heckbert). Each collapse moves one end of an edge onto the other, so a
+ * simplified mesh indexes the same vertices as the original and levels of
+ * detail only need index buffers of their own.
+ * Vertices are welded by position first, so attribute seams are simplified
+ * with the rest of the mesh rather than tearing open. Open boundaries and
+ * seams carry extra planes that keep their outline in place.
+ */
+namespace mesh_simplify {
+
+/**
+ * Simplifies a triangle list
+ * @param vertices the vertices
+ * @param indices the triangles to simplify
+ * @param target_indices the number of indices to stop at, or below
+ * @param out the destination for the simplified triangles
+ * @return the largest object space distance from the original surface the
+ *         simplified one is estimated to stray
+ */
+float simplify(std::vector<Vertex> const &vertices,
+        std::vector<unsigned int> const &indices, size_t target_indices,
+        std::vector<unsigned int> &out);
+
+/**
+ * Appends levels of detail to a mesh's index buffer, each with about half
+ * the triangles of the one before, and fills in data.lods with the full
+ * mesh first. Stops early once the mesh no longer simplifies well.
+ * @param data the mesh
+ * @param max_lods the most levels there will be, counting the full mesh
+ */
+void buildLods(MeshData &data, size_t max_lods = 4);
+
+};
+
+#endif // UTILS_MESH_SIMPLIFY_H
@@ -0,0 +1,38 @@
+#ifndef UTILS_MIPMAP_H
+#define UTILS_MIPMAP_H
+
+#include <vector>
+
+#include "utils/image.h"
+
+/**
+ * CPU mip chain generation, so that textures never depend on the driver's
+ * glGenerateMipmap. Levels are filtered in linear light in floating point,
+ * four channels at a time with SSE where available, and each level is built
+ * from the unquantized level above it.
+ */
+namespace mipmap {
+
+enum class Filter {
+    // 2x2 average, fast enough to run at load time
+    box,
+
+    // 8x8 separable Kaiser windowed sinc, sharper, meant for cooking
+    kaiser
+};
+
+/**
+ * Builds the full mip chain of an image, down to 1x1. Odd sizes round down,
+ * the same as OpenGL, and edges are clamped.
+ * @param levels the chain, holding only the base level on entry
+ * @param filter the downsampling filter
+ * @param srgb whether or not the colour channels are sRGB encoded, in which
+ *             case they are decoded before filtering and re-encoded after.
+ *             Alpha is always linear.
+ */
+void build(std::vector<Image> &levels, Filter filter = Filter::box,
+        bool srgb = true);
+
+};
+
+#endif // UTILS_MIPMAP_H
@@ -2,6 +2,25 @@
 #define UTILS_OBJ_LOADER_H
 
 namespace obj_loader {
+/**
+ * Parses an OBJ file without touching OpenGL, so the result can be cached or
+ * cooked. Material textures are referenced by path but not loaded.
+ * @param data the destination for the mesh
+ * @param path the path to the OBJ file
+ * @param split whether a large file may be split across the loader pool.
+ *              The result is the same either way.
+ * @return whether or not the OBJ file was successfully read
+ */
+bool parseObj(MeshData &data, std::string path, bool split = true);
+
+/**
+ * Turns on or off the report parseObj prints to stderr after each file: the
+ * parse time and rate, and the vertex count and size before and after
+ * duplicate corners are merged. Off by default.
+ * @param on whether or not to print the report
+ */
+void setVerbose(bool on);
+
 /**
  * Loads an OBJ file into a vector of meshes
  * @param meshes the destination to load to
@@ -11,12 +30,21 @@ namespace obj_loader {
 bool loadObj(std::vector<Mesh> &meshes, std::string path);
 
 /**
- * Loads a MTL file into a vector of materials
+ * Loads a MTL file into a vector of materials. Texture paths are recorded,
+ * the textures themselves are created by loadTextures.
  * @param materials the destination to load to
  * @param path the path to the MTL file
  * @return whether or not the MTL file was successfully read
  */
 bool loadMtl(std::vector<Material> &materials, std::string path);
+
+/**
+ * Creates the textures named by each material's maps, loading each distinct
+ * path only once. Textures are shared through the current TextureRegistry
+ * and loaded through the current TextureLoader when those are in use.
+ * @param materials the materials to load textures for
+ */
+void loadTextures(std::vector<Material> &materials);
 };
 
 #endif // UTILS_OBJ_LOADER_H
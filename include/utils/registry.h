@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <map>
+#include <utility>
 
 struct Handle {
 
@@ -53,7 +54,7 @@ struct Registry {
         auto &handle = registry[k];
         assert(handle.id == Handle::invalid && "re-registering?");
         handle = Handle{ id, curr_handle_id++ };
-        entries[handle] = t;
+        entries.emplace(handle, std::move(t));
         return handle;
     }
 
@@ -61,7 +62,19 @@ struct Registry {
         assert(h.regid == id && "using handle from different registry?");
         auto it = entries.find(h);
         assert(it != entries.end() && "attemping to get non-registered entry?");
-        return entries[h];
+        return it->second;
+    }
+
+    Handle find(Key const &k) const {
+        auto it = registry.find(k);
+        return it == registry.end() ? Handle{} : it->second;
+    }
+
+    void remove(Key const &k) {
+        auto it = registry.find(k);
+        assert(it != registry.end() && "removing non-registered entry?");
+        entries.erase(it->second);
+        registry.erase(it);
     }
 
 };
@@ -0,0 +1,379 @@
+#ifndef UTILS_RING_QUEUE_H
+#define UTILS_RING_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define RING_QUEUE_PAUSE() _mm_pause()
+#else
+#define RING_QUEUE_PAUSE() std::this_thread::yield()
+#endif
+
+/**
+ * Who a RingQueue is shared between
+ */
+enum class RingSharing {
+    // any number of threads push and pop
+    mpmc,
+    // one thread pushes and one thread pops, though which thread that is
+    // may change if the handover is synchronized
+    spsc
+};
+
+namespace ring_queue {
+
+// how many times a blocked push or pop checks again before it parks
+static constexpr unsigned spin_rounds = 128;
+
+/**
+ * Blocks until an atomic holds a wanted value, spinning for a while, then
+ * parking on the atomic
+ * @param value the atomic
+ * @param parked how many threads are parked on the atomic, so publish only
+ *               has to notify while there are any
+ * @param ready tells whether a value is the wanted one
+ */
+template <typename Ready>
+void await(std::atomic<size_t> &value, std::atomic<unsigned> &parked,
+        Ready &&ready) {
+    for(unsigned i = 0; i < spin_rounds; i++) {
+        if(ready(value.load(std::memory_order_acquire))) {
+            return;
+        }
+        RING_QUEUE_PAUSE();
+    }
+
+    // counted before the value is checked, so either publish sees the count
+    // or this sees the new value. Every thread parked on the atomic stays
+    // counted until it has the value it wants.
+    parked.fetch_add(1);
+    while(true) {
+        size_t seen = value.load();
+        if(ready(seen)) {
+            break;
+        }
+        value.wait(seen);
+    }
+    parked.fetch_sub(1);
+}
+
+/**
+ * Publishes a new value of an atomic, waking the threads parked in await
+ */
+inline void publish(std::atomic<size_t> &value, size_t to,
+        std::atomic<unsigned> &parked) {
+    value.store(to);
+    if(parked.load() != 0) {
+        value.notify_all();
+    }
+}
+
+};
+
+template <typename T, RingSharing sharing = RingSharing::mpmc>
+class RingQueue;
+
+/**
+ * A bounded lock free queue for any number of producers and consumers
+ * (Vyukov). Each cell carries a sequence number saying which lap of the
+ * ring it is ready for, so a push or pop only touches its own cell once it
+ * has claimed a position.
+ * push and pop block, spinning and then parking, until there is room or an
+ * item. pushAsync and popAsync return straight away instead.
+ * Items are moved in and out, so T only has to be movable.
+ */
+template <typename T>
+class RingQueue<T, RingSharing::mpmc> {
+private:
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        std::atomic<unsigned> parked;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T *item() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+    size_t mask;
+    Cell *cells;
+    // producers and consumers bump these, so keep them off the same line
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) std::atomic<size_t> head;
+
+public:
+
+    /**
+     * @param capacity the most items held at once, rounded up to a power of
+     *                 two
+     */
+    RingQueue(size_t capacity = 1024) :
+        mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        cells(new Cell[mask + 1]),
+        tail(0),
+        head(0) {
+        for(size_t i = 0; i <= mask; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+            cells[i].parked.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~RingQueue() {
+        size_t end = tail.load(std::memory_order_relaxed);
+        for(size_t pos = head.load(std::memory_order_relaxed); pos < end;
+                pos++) {
+            Cell &cell = cells[pos & mask];
+            if(cell.sequence.load(std::memory_order_relaxed) == pos + 1) {
+                cell.item()->~T();
+            }
+        }
+        delete[] cells;
+    }
+
+    RingQueue(RingQueue const &) = delete;
+    RingQueue &operator=(RingQueue const &) = delete;
+
+    /**
+     * Adds an item, waiting for room if the queue is full
+     * @param item the item
+     */
+    template <typename U>
+    requires std::constructible_from<T, U &&>
+    void push(U &&item) {
+        size_t pos = tail.fetch_add(1, std::memory_order_relaxed);
+        Cell &cell = cells[pos & mask];
+        ring_queue::await(cell.sequence, cell.parked,
+            [pos](size_t sequence) { return sequence == pos; });
+        new (cell.storage) T(std::forward<U>(item));
+        ring_queue::publish(cell.sequence, pos + 1, cell.parked);
+    }
+
+    /**
+     * Adds an item if there is room
+     * @param item the item, only moved from if it was added
+     * @return whether it was added
+     */
+    template <typename U>
+    requires std::constructible_from<T, U &&>
+    bool pushAsync(U &&item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        while(true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t lap = (intptr_t) sequence - (intptr_t) pos;
+            if(lap == 0) {
+                if(tail.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if(lap < 0) {
+                // the cell still holds an item from the last lap
+                return false;
+            }
+            else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->storage) T(std::forward<U>(item));
+        ring_queue::publish(cell->sequence, pos + 1, cell->parked);
+        return true;
+    }
+
+    /**
+     * Takes the oldest item, waiting for one if the queue is empty
+     * @return the item
+     */
+    T pop() {
+        size_t pos = head.fetch_add(1, std::memory_order_relaxed);
+        Cell &cell = cells[pos & mask];
+        ring_queue::await(cell.sequence, cell.parked,
+            [pos](size_t sequence) { return sequence == pos + 1; });
+        T item(std::move(*cell.item()));
+        cell.item()->~T();
+        ring_queue::publish(cell.sequence, pos + mask + 1, cell.parked);
+        return item;
+    }
+
+    /**
+     * Takes the oldest item if there is one
+     * @param item the destination for the item
+     * @return whether there was one
+     */
+    bool popAsync(T &item) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        Cell *cell;
+        while(true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t lap = (intptr_t) sequence - (intptr_t) (pos + 1);
+            if(lap == 0) {
+                if(head.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if(lap < 0) {
+                // nothing pushed to the cell yet this lap
+                return false;
+            }
+            else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(*cell->item());
+        cell->item()->~T();
+        ring_queue::publish(cell->sequence, pos + mask + 1,
+            cell->parked);
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+};
+
+/**
+ * A bounded lock free queue for one producer and one consumer (Lamport).
+ * Each side keeps its own copy of the other's index and only reloads it
+ * when the copy says the queue is full or empty, so the two rarely share a
+ * cache line. Otherwise it works as the many producer queue does.
+ */
+template <typename T>
+class RingQueue<T, RingSharing::spsc> {
+private:
+
+    size_t mask;
+    std::byte *storage;
+    // the consumer's index, its copy of the producer's, and whether the
+    // producer is parked waiting for the index to move
+    alignas(64) std::atomic<size_t> head;
+    size_t tail_seen;
+    std::atomic<unsigned> head_parked;
+    // and the same for the producer
+    alignas(64) std::atomic<size_t> tail;
+    size_t head_seen;
+    std::atomic<unsigned> tail_parked;
+
+    T *slot(size_t pos) {
+        return std::launder(reinterpret_cast<T *>(storage
+            + (pos & mask) * sizeof(T)));
+    }
+
+public:
+
+    /**
+     * @param capacity the most items held at once, rounded up to a power of
+     *                 two
+     */
+    RingQueue(size_t capacity = 1024) :
+        mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        storage(static_cast<std::byte *>(::operator new(
+            (mask + 1) * sizeof(T), std::align_val_t(alignof(T))))),
+        head(0),
+        tail_seen(0),
+        head_parked(0),
+        tail(0),
+        head_seen(0),
+        tail_parked(0) { }
+
+    ~RingQueue() {
+        size_t end = tail.load(std::memory_order_relaxed);
+        for(size_t pos = head.load(std::memory_order_relaxed); pos < end;
+                pos++) {
+            slot(pos)->~T();
+        }
+        ::operator delete(storage, std::align_val_t(alignof(T)));
+    }
+
+    RingQueue(RingQueue const &) = delete;
+    RingQueue &operator=(RingQueue const &) = delete;
+
+    /**
+     * Adds an item, waiting for room if the queue is full. Producer only.
+     * @param item the item
+     */
+    template <typename U>
+    requires std::constructible_from<T, U &&>
+    void push(U &&item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        if(pos - head_seen > mask) {
+            ring_queue::await(head, head_parked,
+                [pos, this](size_t h) { return pos - h <= mask; });
+            head_seen = head.load(std::memory_order_acquire);
+        }
+        new (slot(pos)) T(std::forward<U>(item));
+        ring_queue::publish(tail, pos + 1, tail_parked);
+    }
+
+    /**
+     * Adds an item if there is room. Producer only.
+     * @param item the item, only moved from if it was added
+     * @return whether it was added
+     */
+    template <typename U>
+    requires std::constructible_from<T, U &&>
+    bool pushAsync(U &&item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        if(pos - head_seen > mask) {
+            head_seen = head.load(std::memory_order_acquire);
+            if(pos - head_seen > mask) {
+                return false;
+            }
+        }
+        new (slot(pos)) T(std::forward<U>(item));
+        ring_queue::publish(tail, pos + 1, tail_parked);
+        return true;
+    }
+
+    /**
+     * Takes the oldest item, waiting for one if the queue is empty.
+     * Consumer only.
+     * @return the item
+     */
+    T pop() {
+        size_t pos = head.load(std::memory_order_relaxed);
+        if(pos == tail_seen) {
+            ring_queue::await(tail, tail_parked,
+                [pos](size_t t) { return t != pos; });
+            tail_seen = tail.load(std::memory_order_acquire);
+        }
+        T item(std::move(*slot(pos)));
+        slot(pos)->~T();
+        ring_queue::publish(head, pos + 1, head_parked);
+        return item;
+    }
+
+    /**
+     * Takes the oldest item if there is one. Consumer only.
+     * @param item the destination for the item
+     * @return whether there was one
+     */
+    bool popAsync(T &item) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        if(pos == tail_seen) {
+            tail_seen = tail.load(std::memory_order_acquire);
+            if(pos == tail_seen) {
+                return false;
+            }
+        }
+        item = std::move(*slot(pos));
+        slot(pos)->~T();
+        ring_queue::publish(head, pos + 1, head_parked);
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+};
+
+#undef RING_QUEUE_PAUSE
+
+#endif // UTILS_RING_QUEUE_H
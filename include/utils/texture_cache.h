@@ -0,0 +1,78 @@
+#ifndef UTILS_TEXTURE_CACHE_H
+#define UTILS_TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "graphics/texture.h"
+#include "utils/image.h"
+
+/**
+ * Cooked textures, written next to the source image as <source>.texcache by
+ * the asset cooker. A cooked texture holds the full mip chain, either RGBA8
+ * or block compressed, so loading one is a map and an upload with no
+ * decoding or mip generation.
+ * The header records the size, modification time and hash of the source,
+ * and a cooked texture whose source has changed is ignored.
+ */
+namespace texture_cache {
+
+/**
+ * Gets the path of the cooked copy of a source image
+ * @param source_path the path to the source image
+ * @return the path to its cooked copy
+ */
+std::string cachePath(std::string const &source_path);
+
+/**
+ * Checks whether the cooked copy of a source image exists and is up to date,
+ * without loading it
+ * @param source_path the path to the source image
+ * @return whether or not the cooked copy is fresh
+ */
+bool isFresh(std::string const &source_path);
+
+/**
+ * Gets how much texture memory the cooked copy of a source image takes up
+ * once uploaded, without loading it
+ * @param source_path the path to the source image
+ * @return the size of every level in bytes, or 0 if there is no fresh
+ *         cooked copy
+ */
+size_t residentSize(std::string const &source_path);
+
+/**
+ * Creates a texture from the cooked copy of a source image, if it is fresh
+ * @param texture the texture to create
+ * @param source_path the path to the source image
+ * @return whether or not a fresh cooked copy was found and loaded
+ */
+bool load(Texture &texture, std::string const &source_path);
+
+/**
+ * Reads the cooked copy of a source image into memory, if it is fresh. Does
+ * not touch OpenGL, so it can run on any thread.
+ * @param levels the destination for the mip chain, largest first. The
+ *               pixels of compressed levels hold their blocks.
+ * @param format the destination for the format of the levels
+ * @param source_path the path to the source image
+ * @return whether or not a fresh cooked copy was found and read
+ */
+bool read(std::vector<Image> &levels, TextureFormat &format,
+        std::string const &source_path);
+
+/**
+ * Writes the cooked copy of a source image, replacing any existing one
+ * @param levels the mip chain of the image, largest first, already in the
+ *               given format
+ * @param format the format the levels are stored in
+ * @param source_path the path to the source image it was decoded from
+ * @return whether or not the cooked copy was written
+ */
+bool save(std::vector<Image> const &levels, TextureFormat format,
+        std::string const &source_path);
+
+};
+
+#endif // UTILS_TEXTURE_CACHE_H
@@ -0,0 +1,89 @@
+#ifndef UTILS_TRIANGULATOR_H
+#define UTILS_TRIANGULATOR_H
+
+#include <memory_resource>
+#include <set>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+/**
+ * Splits planar polygons into triangles.
+ * Triangles and convex polygons are fanned. Anything else is cut into
+ * monotone pieces by a sweep over its corners from top to bottom, which adds
+ * a diagonal wherever a corner would stop a piece being monotone, then each
+ * piece is triangulated in one pass along its two chains. This is
+ * O(n log n) whatever the shape of the polygon.
+ * Scratch space is kept between calls, so reusing one triangulator for many
+ * polygons does not allocate once it has warmed up.
+ */
+class Triangulator {
+private:
+
+    /**
+     * An edge crossing the sweep line, from its top corner down. Ordered
+     * from left to right along the line, which stays the same for as long
+     * as both edges cross it.
+     */
+    struct Edge {
+        glm::vec2 top;
+        glm::vec2 bottom;
+        // the corner the edge leaves from, which changes when a diagonal
+        // copies that corner
+        mutable unsigned int corner;
+
+        bool operator<(Edge const &other) const;
+    };
+
+    // polygon projected onto its dominant plane, wound counter-clockwise,
+    // followed by the corners copied to split it along diagonals
+    std::vector<glm::vec2> points;
+    // the polygon corner each point is, or is a copy of
+    std::vector<unsigned int> source;
+    // corners as circular linked lists, one per piece
+    std::vector<unsigned int> prev;
+    std::vector<unsigned int> next;
+    // per corner state
+    std::vector<unsigned char> flags;
+    std::vector<unsigned char> kinds;
+    // the original corners from top to bottom
+    std::vector<unsigned int> order;
+
+    // the edges crossing the sweep line, where each edge leaving a corner
+    // sits in it, and the corner each edge's next diagonal goes to
+    std::pmr::unsynchronized_pool_resource status_pool;
+    std::pmr::multiset<Edge> status{ &status_pool };
+    std::vector<std::pmr::multiset<Edge>::iterator> status_edge;
+    std::vector<unsigned int> helper;
+
+    // one monotone piece, sorted from top to bottom, and the corners still
+    // waiting for a triangle
+    std::vector<unsigned int> sorted;
+    std::vector<unsigned int> stack;
+
+    void project(std::vector<glm::vec3> const &polygon);
+    float turn(unsigned int a, unsigned int b, unsigned int c) const;
+    bool above(unsigned int a, unsigned int b) const;
+    unsigned int addDiagonal(unsigned int a, unsigned int b);
+    void insertEdge(unsigned int corner);
+    unsigned int closeEdge(unsigned int corner);
+    std::pmr::multiset<Edge>::iterator edgeLeftOf(unsigned int corner);
+    void splitMonotone();
+    void triangulateMonotone(unsigned int first, unsigned int offset,
+            std::vector<unsigned int> &indices);
+
+public:
+
+    /**
+     * Triangulates a simple polygon. Triangles keep the polygon's winding.
+     * @param polygon the corner positions of the polygon, in order
+     * @param offset added to every emitted index
+     * @param indices the destination, three indices (into the polygon, plus
+     *                the offset) are appended per triangle
+     */
+    void triangulate(std::vector<glm::vec3> const &polygon,
+            unsigned int offset, std::vector<unsigned int> &indices);
+};
+
+#endif // UTILS_TRIANGULATOR_H
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <mutex>
 #include <semaphore>
+#include <utility>
 
 template <typename T>
 class TSQ {
@@ -22,7 +23,7 @@ public:
 
     void push(T t) {
         q_write.lock();
-        q.push_back(t);
+        q.push_back(std::move(t));
         q_counter++;
         q_write.unlock();
         q_sema.release();
@@ -30,7 +31,7 @@ public:
 
     bool pushAsync(T t) {
         if (q_write.try_lock()) {
-            q.push_back(t);
+            q.push_back(std::move(t));
             q_counter++;
             q_write.unlock();
             q_sema.release();
@@ -41,20 +42,35 @@ public:
 
     T top() {
         q_sema.acquire();
-        T val = q.top();
+        q_write.lock();
+        T val = q.front();
+        q_write.unlock();
         q_sema.release();
+        return val;
     }
 
     T pop() {
         q_sema.acquire();
         q_write.lock();
-        T temp = q.front();
+        T temp = std::move(q.front());
         q.pop_front();
         q_counter--;
         q_write.unlock();
         return temp;
     }
 
+    bool popAsync(T &t) {
+        if (q_sema.try_acquire()) {
+            q_write.lock();
+            t = std::move(q.front());
+            q.pop_front();
+            q_counter--;
+            q_write.unlock();
+            return true;
+        }
+        return false;
+    }
+
 };
 
 #endif
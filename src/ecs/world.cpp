@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "ecs/world.h"
+
+namespace ecs {
+
+static ComponentInfo infos[max_components];
+static std::atomic<ComponentId> num_components = 0;
+
+ComponentId registerComponent(ComponentInfo const &info) {
+    // ids are handed out from function statics, which may run on any thread
+    static std::mutex sync;
+    std::lock_guard<std::mutex> lock(sync);
+
+    ComponentId id = num_components.load();
+    assert(id < max_components && "too many component types?");
+    infos[id] = info;
+    num_components.store(id + 1);
+    return id;
+}
+
+ComponentInfo const &componentInfo(ComponentId id) {
+    assert(id < num_components.load());
+    return infos[id];
+}
+
+/**
+ * @return an offset rounded up to a multiple of an alignment
+ */
+static size_t alignUp(size_t offset, size_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+/**
+ * Lays out a chunk's arrays for a number of entities
+ * @param archetype the archetype, whose offsets are set
+ * @param capacity the number of entities
+ * @return the bytes the chunk takes
+ */
+static size_t layout(Archetype &archetype, uint32_t capacity) {
+    size_t offset = sizeof(Entity) * capacity;
+    for(ComponentId id : archetype.components) {
+        ComponentInfo const &info = componentInfo(id);
+        offset = alignUp(offset, info.align);
+        archetype.offsets[id] = offset;
+        offset += info.size * capacity;
+    }
+    return offset;
+}
+
+static std::byte *allocateChunk(size_t bytes) {
+    return static_cast<std::byte *>(::operator new(bytes,
+        std::align_val_t(chunk_alignment)));
+}
+
+static void freeChunk(std::byte *data) {
+    ::operator delete(data, std::align_val_t(chunk_alignment));
+}
+
+World::World() :
+    num_alive(0) {
+    // every entity starts out with no components
+    findArchetype(0);
+}
+
+World::~World() {
+    clear();
+}
+
+Archetype *World::findArchetype(Signature signature) {
+    auto it = signatures.find(signature);
+    if(it != signatures.end()) {
+        return it->second;
+    }
+
+    std::unique_ptr<Archetype> archetype = std::make_unique<Archetype>();
+    archetype->signature = signature;
+    archetype->count = 0;
+
+    size_t row_size = sizeof(Entity);
+    for(ComponentId id = 0; id < max_components; id++) {
+        if(signature & (Signature(1) << id)) {
+            archetype->components.push_back(id);
+            archetype->sizes[id] = componentInfo(id).size;
+            row_size += componentInfo(id).size;
+        }
+    }
+
+    // as many as fit once the arrays are aligned, and at least one
+    uint32_t capacity = (uint32_t) std::max<size_t>(1, chunk_size / row_size);
+    while(capacity > 1 && layout(*archetype, capacity) > chunk_size) {
+        capacity--;
+    }
+    archetype->capacity = capacity;
+    archetype->chunk_bytes = layout(*archetype, capacity);
+
+    Archetype *found = archetype.get();
+    archetypes.push_back(std::move(archetype));
+    signatures.emplace(signature, found);
+    return found;
+}
+
+/**
+ * @return the archetype with a component added to, or removed from, another
+ */
+Archetype *World::neighbour(Archetype *archetype, ComponentId id) {
+    auto it = archetype->edges.find(id);
+    if(it != archetype->edges.end()) {
+        return it->second;
+    }
+
+    Archetype *found
+        = findArchetype(archetype->signature ^ (Signature(1) << id));
+    archetype->edges.emplace(id, found);
+    return found;
+}
+
+/**
+ * @return a handle for a new entity, yet to be placed
+ */
+Entity World::allocate() {
+    uint32_t index;
+    if(!free_indices.empty()) {
+        index = free_indices.back();
+        free_indices.pop_back();
+    }
+    else {
+        index = (uint32_t) locations.size();
+        locations.push_back({ nullptr, 0, 0, 0 });
+    }
+
+    num_alive++;
+    return { index, locations[index].generation };
+}
+
+/**
+ * Gives an entity a row at the end of an archetype, leaving its components
+ * to the caller to construct
+ * @return the entity's location
+ */
+World::Location &World::place(Entity entity, Archetype *archetype) {
+    if(archetype->chunks.empty()
+            || archetype->chunks.back().count == archetype->capacity) {
+        archetype->chunks.push_back({
+            allocateChunk(archetype->chunk_bytes), 0 });
+    }
+
+    Chunk &chunk = archetype->chunks.back();
+    uint32_t row = chunk.count++;
+    archetype->entities(chunk)[row] = entity;
+    archetype->count++;
+
+    Location &location = locations[entity.index];
+    location.archetype = archetype;
+    location.chunk = (uint32_t) archetype->chunks.size() - 1;
+    location.row = row;
+    return location;
+}
+
+/**
+ * Fills a row whose components have been destroyed or moved out with the
+ * archetype's last entity, keeping the chunks packed
+ */
+void World::erase(Archetype *archetype, uint32_t chunk, uint32_t row) {
+    Chunk &last = archetype->chunks.back();
+    uint32_t last_row = last.count - 1;
+    uint32_t last_chunk = (uint32_t) archetype->chunks.size() - 1;
+
+    if(chunk != last_chunk || row != last_row) {
+        Chunk &hole = archetype->chunks[chunk];
+        for(ComponentId id : archetype->components) {
+            componentInfo(id).relocate(archetype->at(hole, id, row),
+                archetype->at(last, id, last_row));
+        }
+
+        Entity moved = archetype->entities(last)[last_row];
+        archetype->entities(hole)[row] = moved;
+        locations[moved.index].chunk = chunk;
+        locations[moved.index].row = row;
+    }
+
+    last.count--;
+    archetype->count--;
+    if(last.count == 0) {
+        freeChunk(last.data);
+        archetype->chunks.pop_back();
+    }
+}
+
+/**
+ * Moves an entity to another archetype, taking the components the two share
+ * and destroying the ones the new archetype lacks. Components only the new
+ * archetype has are left to the caller to construct.
+ * @return the entity's new location
+ */
+World::Location &World::move(Entity entity, Archetype *to) {
+    Location from = locations[entity.index];
+    Chunk &from_chunk = from.archetype->chunks[from.chunk];
+
+    Location &location = place(entity, to);
+    Chunk const &to_chunk = to->chunks[location.chunk];
+    for(ComponentId id : from.archetype->components) {
+        void *component = from.archetype->at(from_chunk, id, from.row);
+        if(to->signature & (Signature(1) << id)) {
+            componentInfo(id).relocate(to->at(to_chunk, id, location.row),
+                component);
+        }
+        else {
+            componentInfo(id).destroy(component);
+        }
+    }
+
+    erase(from.archetype, from.chunk, from.row);
+    return location;
+}
+
+void World::destroy(Entity entity) {
+    assert(alive(entity) && "destroy a dead entity?");
+    Location &location = locations[entity.index];
+    Archetype *archetype = location.archetype;
+    Chunk const &chunk = archetype->chunks[location.chunk];
+    for(ComponentId id : archetype->components) {
+        componentInfo(id).destroy(archetype->at(chunk, id, location.row));
+    }
+
+    erase(archetype, location.chunk, location.row);
+    location.archetype = nullptr;
+    location.generation++;
+    free_indices.push_back(entity.index);
+    num_alive--;
+}
+
+void World::clear() {
+    // the archetypes stay, so queries keep their matches
+    for(std::unique_ptr<Archetype> &archetype : archetypes) {
+        for(Chunk &chunk : archetype->chunks) {
+            for(ComponentId id : archetype->components) {
+                ComponentInfo const &info = componentInfo(id);
+                for(uint32_t row = 0; row < chunk.count; row++) {
+                    info.destroy(archetype->at(chunk, id, row));
+                }
+            }
+            freeChunk(chunk.data);
+        }
+        archetype->chunks.clear();
+        archetype->count = 0;
+    }
+
+    free_indices.clear();
+    for(uint32_t index = 0; index < locations.size(); index++) {
+        if(locations[index].archetype) {
+            locations[index].archetype = nullptr;
+            locations[index].generation++;
+        }
+        free_indices.push_back(index);
+    }
+    num_alive = 0;
+}
+
+};
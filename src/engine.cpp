@@ -2,11 +2,13 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <mutex>
 #include <syncstream>
 #include <thread>
 
 #include <glad/gl.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
@@ -21,8 +23,11 @@
 #include "graphics/scene.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
+#include "graphics/texture_loader.h"
+#include "graphics/texture_registry.h"
 #include "graphics/vertex.h"
 #include "input/input.h"
+#include "threading/job.h"
 #include "utils/event.h"
 #include "utils/registry.h"
 
@@ -30,6 +35,19 @@
 
 static const unsigned TICKRATE = 64;
 
+// frames ------------------------------
+
+// frames simulated at once, so simulating one overlaps rendering the last
+static const unsigned FRAMES_IN_FLIGHT = 2;
+
+// textures ------------------------------
+
+// bytes of texture data uploaded per frame, so streaming never stalls a frame
+static const size_t TEXTURE_UPLOAD_BUDGET = 4 << 20;
+
+// bytes of texture memory kept resident before unused textures are evicted
+static const size_t TEXTURE_MEMORY_BUDGET = 256 << 20;
+
 void tickTrigger() {
     static auto interval = std::chrono::seconds(1) / TICKRATE;
     while (true) {
@@ -42,52 +60,78 @@ void tickTrigger() {
 
 static float const cam_speed = 0.00002f;
 
-static glm::vec3 cam_pos(0.0f, 0.0f, 5.0f);
-static glm::vec3 cam_front(0.0f, 0.0f, -1.0f);
-static glm::vec3 cam_up(0.0f, 1.0f, 0.0f);
+static glm::vec3 const cam_up(0.0f, 1.0f, 0.0f);
 static float cam_fov = 45.0f;
+static float sens = 0.0002f;
 
+// the camera input, moved by the handlers on the window's thread and
+// sampled once a frame on the engine's, always under cam_sync
+static std::mutex cam_sync;
+static glm::vec3 cam_pos(0.0f, 0.0f, 5.0f);
 static float yaw = -90.0f;
 static float pitch = 0.0f;
-static float sens = 0.0002f;
+
+/**
+ * @return the direction the camera faces at a yaw and pitch, in degrees
+ */
+static glm::vec3 camFront(float yaw, float pitch) {
+    glm::vec3 dir(
+        glm::cos(glm::radians(yaw)) * glm::cos(glm::radians(pitch)),
+        glm::sin(glm::radians(pitch)),
+        glm::sin(glm::radians(yaw)) * glm::cos(glm::radians(pitch))
+    );
+    return glm::normalize(dir);
+}
 
 void moveForward(void *) {
-    cam_pos += cam_speed * cam_front;
+    std::lock_guard lock(cam_sync);
+    cam_pos += cam_speed * camFront(yaw, pitch);
 }
 
 void moveLeft(void *) {
-    cam_pos -= glm::normalize(glm::cross(cam_front, cam_up)) * cam_speed;
+    std::lock_guard lock(cam_sync);
+    cam_pos -= glm::normalize(glm::cross(camFront(yaw, pitch), cam_up))
+        * cam_speed;
 }
 
 void moveBackward(void *) {
-    cam_pos -= cam_speed * cam_front;
+    std::lock_guard lock(cam_sync);
+    cam_pos -= cam_speed * camFront(yaw, pitch);
 }
 
 void moveRight(void *) {
-    cam_pos += glm::normalize(glm::cross(cam_front, cam_up)) * cam_speed;
+    std::lock_guard lock(cam_sync);
+    cam_pos += glm::normalize(glm::cross(camFront(yaw, pitch), cam_up))
+        * cam_speed;
 }
 
 void moveUp(void *) {
+    std::lock_guard lock(cam_sync);
     cam_pos += cam_speed * cam_up;
 }
 
 void moveDown(void *) {
+    std::lock_guard lock(cam_sync);
     cam_pos -= cam_speed * cam_up;
 }
 
 void lookUp(void *) {
+    std::lock_guard lock(cam_sync);
     pitch += sens;
 }
 
 void lookDown(void *) {
+    std::lock_guard lock(cam_sync);
     pitch -= sens;
 }
 
 void lookLeft(void *) {
+    std::lock_guard lock(cam_sync);
     yaw -= sens;
 }
 
 void lookRight(void *) {
+    std::lock_guard lock(cam_sync);
     yaw += sens;
 }
 
@@ -122,6 +166,65 @@ void lookRight(void *) {
 //     cam_front = glm::normalize(dir);
 // }
 
+// simulation ------------------------------
+
+/**
+ * The input a frame is simulated with, sampled before the frame starts
+ */
+struct SimInput {
+    glm::vec3 cam_pos;
+    float yaw;
+    float pitch;
+};
+
+/**
+ * What the simulation of a frame hands its rendering
+ */
+struct SimState {
+    glm::quat elephant_rotation;
+    glm::vec3 cam_pos;
+    glm::vec3 cam_front;
+    glm::vec3 cam_up;
+};
+
+/**
+ * Every frame's input and state, a copy for each frame in flight
+ */
+struct Simulation {
+    DoubleBuffered<SimInput> input;
+    DoubleBuffered<SimState> state;
+};
+
+/**
+ * @return the camera input as it stands
+ */
+static SimInput sampleInput() {
+    std::lock_guard lock(cam_sync);
+    return SimInput{ cam_pos, yaw, pitch };
+}
+
+/**
+ * Simulates a frame on from the one before. Only touches the frame's own
+ * copies, never the input the handlers move.
+ * @param arg the Simulation the frames are in
+ */
+void simulate(void *arg) {
+    Simulation &sim = *static_cast<Simulation *>(arg);
+    SimInput const &input = sim.input.current();
+    SimState const &last = sim.state.previous();
+    SimState &next = sim.state.current();
+
+    next.elephant_rotation = glm::rotate(
+        last.elephant_rotation,
+        glm::radians(1.0f),
+        glm::normalize(glm::vec3(1.0f, 0.5f, 0.0f))
+    );
+
+    next.cam_pos = input.cam_pos;
+    next.cam_front = camFront(input.yaw, input.pitch);
+    next.cam_up = cam_up;
+}
+
 // engine ------------------------------
 
 static bool run = true;
@@ -153,38 +256,47 @@ int engineInit(OpenGLWrapper graphics) {
     // enable depth
     glEnable(GL_DEPTH_TEST);
 
-    Registry<std::string, Model> model_reg;
+    // decode textures off the render thread
+    TextureLoader texture_loader(2);
+    TextureLoader::use(&texture_loader);
+
+    // share textures between every model that uses them
+    TextureRegistry texture_registry(TEXTURE_MEMORY_BUDGET);
+    TextureRegistry::use(&texture_registry);
+
+    // simulation runs as a job graph a frame ahead of rendering, which
+    // stays on this thread with the GL context. The scene splits its
+    // systems across the same pool.
+    JobManager jobs(FRAMES_IN_FLIGHT);
+
+    Scene scene(jobs.pool());
+    scene.create();
 
-    Model elephant_model;
-    auto path = "assets/elephant/Mesh_Elephant.obj";
-    elephant_model.create(path);
-    Handle elephant_handle = model_reg.put(path, elephant_model);
+    Handle elephant_handle
+        = scene.loadModel("assets/elephant/Mesh_Elephant.obj");
+    if(elephant_handle.id == Handle::invalid) {
+        fprintf(stderr, "Failed to load model\n");
+        return 1;
+    }
 
-    Scene scene;
+    SimInput input = sampleInput();
     Camera cam;
-    cam.init(cam_pos, cam_front, cam_up, 45.0f,
+    cam.init(input.cam_pos, camFront(input.yaw, input.pitch), cam_up, 45.0f,
             (float) graphics.width / (float) graphics.height);
-    SceneObject &elephant_object1 = scene.addObject(
-        model_reg[elephant_handle],
-        glm::translate(
-            glm::scale(
-                glm::mat4(1.0f),
-                glm::vec3(0.01f, 0.01f, 0.01f)
-            ),
-            glm::vec3(100, 0, 0)
-        ),
+    Transform elephant_transform;
+    elephant_transform.scale = glm::vec3(0.01f, 0.01f, 0.01f);
+
+    elephant_transform.position = glm::vec3(1.0f, 0.0f, 0.0f);
+    ecs::Entity elephant1 = scene.addObject(
+        elephant_handle,
+        elephant_transform,
         program
     );
 
-    SceneObject &elephant_object2 = scene.addObject(
-        model_reg[elephant_handle],
-        glm::translate(
-            glm::scale(
-                glm::mat4(1.0f),
-                glm::vec3(0.01f, 0.01f, 0.01f)
-            ),
-            glm::vec3(-100, 0, 0)
-        ),
+    elephant_transform.position = glm::vec3(-1.0f, 0.0f, 0.0f);
+    scene.addObject(
+        elephant_handle,
+        elephant_transform,
         program
     );
 
@@ -210,44 +322,67 @@ int engineInit(OpenGLWrapper graphics) {
         = std::chrono::system_clock::now().time_since_epoch()
         / std::chrono::milliseconds(10);
 
+    int elephant_transform1 = scene.transformOf(elephant1);
+    Simulation sim{
+        DoubleBuffered<SimInput>(input),
+        DoubleBuffered<SimState>(SimState{
+            scene.transforms.local(elephant_transform1).rotation,
+            cam.pos,
+            cam.front,
+            cam.up
+        })
+    };
+    JobManager::JobId simulate_job
+        = jobs.registerJob("simulate", simulate, &sim);
+    JobManager::ResourceId sim_resource = jobs.registerResource("sim_state");
+    jobs.registerWrite(simulate_job, sim_resource);
+    jobs.compile();
+
+    JobManager::Frame simulating = jobs.runIteration();
     while(run) {
 
         event::waitFor<EngineTickEvent>();
 
-        auto angle_diff = 0.7f;
-        auto last_angle = 1.0f;
+        // render the frame simulated last while the next one simulates.
+        // The next frame's copy of sim_state is the other one, and the one
+        // after that only starts once this one is drawn.
+        JobManager::Frame rendering = simulating;
+        jobs.wait(rendering);
 
-        elephant_object1.world = glm::rotate(
-            elephant_object1.world,
-            last_angle * glm::radians(1.0f),
-            glm::normalize(glm::vec3(1.0f, 0.5f, 0.0f))
-        );
-        last_angle += angle_diff;
+        // the next frame simulates with the input as it stands now. Its
+        // copy was last read two frames back, which has finished.
+        sim.input.get(rendering + 1) = sampleInput();
+        simulating = jobs.runIteration();
 
-        glm::vec3 dir(
-            glm::cos(glm::radians(yaw)) * glm::cos(glm::radians(pitch)),
-            glm::sin(glm::radians(pitch)),
-            glm::sin(glm::radians(yaw)) * glm::cos(glm::radians(pitch))
-        );
-        cam_front = glm::normalize(dir);
+        SimState const &state = sim.state.get(rendering);
+        scene.transforms.setRotation(elephant_transform1,
+            state.elephant_rotation);
 
-        cam.pos = cam_pos;
-        cam.front = cam_front;
-        cam.up = cam_up;
+        cam.pos = state.cam_pos;
+        cam.front = state.cam_front;
+        cam.up = state.cam_up;
 
         // clear the buffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        texture_loader.update(TEXTURE_UPLOAD_BUDGET);
+
         scene.draw(cam);
 
         // swap buffers
         graphics.swapBuffers();
     }
 
-    // clean everything up
-    graphics.destroy();
-    elephant_model.destroy(); // this is bad with registry but im lazy
+    // the jobs outlive the simulation state, so let the last frame finish
+    // with it first
+    jobs.wait(simulating);
+
+    // clean everything up while the context is still current, releasing
+    // the scene's textures before the registry destroys them
+    scene.destroy();
+    texture_registry.destroy();
     program.destroy();
+    graphics.destroy();
 
     return 0;
 }
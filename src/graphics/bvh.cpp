@@ -0,0 +1,623 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/bvh.h"
+
+// rebuild once the cost has grown by this much since the last build
+static constexpr float REBUILD_THRESHOLD = 1.3f;
+// the number of buckets centroids are sorted into when splitting
+static constexpr int NUM_BINS = 16;
+
+/**
+ * @return half the surface area of a box, all the heuristic needs
+ */
+static float area(glm::vec3 const &min, glm::vec3 const &max) {
+    glm::vec3 d = max - min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+Bvh::Bvh() :
+    root(null),
+    num_proxies(0),
+    build_cost(0.0f),
+    edits(0),
+    built(2),
+    building(false),
+    threads(1) { }
+
+Bvh::~Bvh() {
+    // the worker pushes its result when done, so wait for it
+    if(building) {
+        delete built.pop();
+    }
+}
+
+int Bvh::allocateNode() {
+    if(!free_nodes.empty()) {
+        int index = free_nodes.back();
+        free_nodes.pop_back();
+        return index;
+    }
+    nodes.emplace_back();
+    return (int) nodes.size() - 1;
+}
+
+void Bvh::freeNode(int index) {
+    free_nodes.push_back(index);
+}
+
+/**
+ * Recomputes the boxes from a node up to the root, stopping early once a
+ * box comes out the same
+ * @param index the first node to recompute
+ */
+void Bvh::refit(int index) {
+    while(index != null) {
+        Node &node = nodes[index];
+        glm::vec3 min = glm::min(nodes[node.left].min, nodes[node.right].min);
+        glm::vec3 max = glm::max(nodes[node.left].max, nodes[node.right].max);
+        if(min == node.min && max == node.max) {
+            return;
+        }
+        node.min = min;
+        node.max = max;
+        index = node.parent;
+    }
+}
+
+/**
+ * Links a leaf into the tree next to the node it is cheapest to pair it
+ * with, going down from the root
+ * @param leaf the leaf, with its box set
+ */
+void Bvh::insertLeaf(int leaf) {
+    if(root == null) {
+        root = leaf;
+        nodes[leaf].parent = null;
+        return;
+    }
+
+    glm::vec3 min = nodes[leaf].min;
+    glm::vec3 max = nodes[leaf].max;
+
+    int index = root;
+    while(nodes[index].left != null) {
+        Node const &node = nodes[index];
+        float combined = area(glm::min(node.min, min),
+                glm::max(node.max, max));
+
+        // pairing with this node makes a new parent, and grows every
+        // ancestor below it by the same amount as going down would
+        float here = 2.0f * combined;
+        float inherited = 2.0f * (combined - area(node.min, node.max));
+
+        float costs[2];
+        int children[2] = { node.left, node.right };
+        for(int i = 0; i < 2; i++) {
+            Node const &child = nodes[children[i]];
+            float grown = area(glm::min(child.min, min),
+                    glm::max(child.max, max));
+            costs[i] = inherited + (child.left == null
+                    ? grown : grown - area(child.min, child.max));
+        }
+
+        if(here < costs[0] && here < costs[1]) {
+            break;
+        }
+        index = costs[0] < costs[1] ? node.left : node.right;
+    }
+
+    int sibling = index;
+    int old_parent = nodes[sibling].parent;
+    int parent = allocateNode();
+    nodes[parent] = {
+        glm::min(nodes[sibling].min, min),
+        glm::max(nodes[sibling].max, max),
+        old_parent, sibling, leaf, null
+    };
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+
+    if(old_parent == null) {
+        root = parent;
+        return;
+    }
+
+    if(nodes[old_parent].left == sibling) {
+        nodes[old_parent].left = parent;
+    }
+    else {
+        nodes[old_parent].right = parent;
+    }
+    refit(old_parent);
+}
+
+/**
+ * Unlinks a leaf from the tree, putting its sibling in place of their
+ * parent. The leaf itself is not freed.
+ * @param leaf the leaf
+ */
+void Bvh::removeLeaf(int leaf) {
+    if(leaf == root) {
+        root = null;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandparent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf
+        ? nodes[parent].right : nodes[parent].left;
+
+    nodes[sibling].parent = grandparent;
+    freeNode(parent);
+
+    if(grandparent == null) {
+        root = sibling;
+        return;
+    }
+
+    if(nodes[grandparent].left == parent) {
+        nodes[grandparent].left = sibling;
+    }
+    else {
+        nodes[grandparent].right = sibling;
+    }
+    refit(grandparent);
+}
+
+int Bvh::insert(glm::vec3 const &min, glm::vec3 const &max) {
+    int proxy;
+    if(!free_proxies.empty()) {
+        proxy = free_proxies.back();
+        free_proxies.pop_back();
+    }
+    else {
+        proxies.push_back({});
+        proxy = (int) proxies.size() - 1;
+    }
+
+    int leaf = allocateNode();
+    nodes[leaf] = { min, max, null, null, null, proxy };
+    insertLeaf(leaf);
+
+    Proxy &p = proxies[proxy];
+    p.min = min;
+    p.max = max;
+    p.leaf = leaf;
+    p.generation++;
+    p.alive = true;
+
+    num_proxies++;
+    edits++;
+    return proxy;
+}
+
+void Bvh::remove(int proxy) {
+    Proxy &p = proxies[proxy];
+    removeLeaf(p.leaf);
+    freeNode(p.leaf);
+
+    p.leaf = null;
+    p.alive = false;
+    free_proxies.push_back(proxy);
+
+    num_proxies--;
+    edits++;
+}
+
+void Bvh::update(int proxy, glm::vec3 const &min, glm::vec3 const &max) {
+    Proxy &p = proxies[proxy];
+    p.min = min;
+    p.max = max;
+
+    Node &leaf = nodes[p.leaf];
+    leaf.min = min;
+    leaf.max = max;
+    refit(leaf.parent);
+
+    edits++;
+}
+
+float Bvh::cost() const {
+    if(root == null || nodes[root].left == null) {
+        return 0.0f;
+    }
+
+    float total = 0.0f;
+    stack.clear();
+    stack.push_back({ root, 0 });
+    while(!stack.empty()) {
+        Node const &node = nodes[stack.back().first];
+        stack.pop_back();
+        if(node.left != null) {
+            total += area(node.min, node.max);
+            stack.push_back({ node.left, 0 });
+            stack.push_back({ node.right, 0 });
+        }
+    }
+
+    float root_area = area(nodes[root].min, nodes[root].max);
+    return root_area > 0.0f ? total / root_area : 0.0f;
+}
+
+/**
+ * Builds a subtree top down, splitting each node's items where the surface
+ * area heuristic says is cheapest, among the bucket boundaries along the
+ * longest axis of their centroids
+ * @param items the items, reordered in place
+ * @param begin the first item of the subtree
+ * @param end one past the last item of the subtree
+ * @param parent the parent of the subtree
+ * @param nodes the destination for the nodes
+ * @return the root of the subtree
+ */
+int Bvh::build(std::vector<Item> &items, size_t begin, size_t end,
+        int parent, std::vector<Node> &nodes) {
+    int index = (int) nodes.size();
+    nodes.push_back({ items[begin].min, items[begin].max, parent, null, null,
+            null });
+
+    glm::vec3 min = items[begin].min, max = items[begin].max;
+    glm::vec3 cmin = items[begin].centroid, cmax = items[begin].centroid;
+    for(size_t i = begin + 1; i < end; i++) {
+        min = glm::min(min, items[i].min);
+        max = glm::max(max, items[i].max);
+        cmin = glm::min(cmin, items[i].centroid);
+        cmax = glm::max(cmax, items[i].centroid);
+    }
+    nodes[index].min = min;
+    nodes[index].max = max;
+
+    if(end - begin == 1) {
+        nodes[index].proxy = items[begin].proxy;
+        items[begin].leaf = index;
+        return index;
+    }
+
+    glm::vec3 extent = cmax - cmin;
+    int axis = extent.x > extent.y
+        ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    size_t mid = begin;
+    if(extent[axis] > 0.0f) {
+        struct Bin {
+            glm::vec3 min, max;
+            size_t count;
+        };
+        Bin bins[NUM_BINS];
+        for(Bin &bin : bins) {
+            bin.min = glm::vec3(std::numeric_limits<float>::max());
+            bin.max = glm::vec3(-std::numeric_limits<float>::max());
+            bin.count = 0;
+        }
+
+        float scale = NUM_BINS / extent[axis];
+        auto binOf = [&](Item const &item) {
+            int b = (int) ((item.centroid[axis] - cmin[axis]) * scale);
+            return std::min(b, NUM_BINS - 1);
+        };
+        for(size_t i = begin; i < end; i++) {
+            Bin &bin = bins[binOf(items[i])];
+            bin.min = glm::min(bin.min, items[i].min);
+            bin.max = glm::max(bin.max, items[i].max);
+            bin.count++;
+        }
+
+        // the cost of everything left of each boundary, then everything
+        // right of it
+        float left_cost[NUM_BINS - 1];
+        glm::vec3 bmin = bins[0].min, bmax = bins[0].max;
+        size_t count = 0;
+        for(int b = 0; b < NUM_BINS - 1; b++) {
+            bmin = glm::min(bmin, bins[b].min);
+            bmax = glm::max(bmax, bins[b].max);
+            count += bins[b].count;
+            left_cost[b] = count ? count * area(bmin, bmax) : 0.0f;
+        }
+
+        float best = std::numeric_limits<float>::max();
+        int split = 0;
+        bmin = bins[NUM_BINS - 1].min;
+        bmax = bins[NUM_BINS - 1].max;
+        count = 0;
+        for(int b = NUM_BINS - 1; b > 0; b--) {
+            bmin = glm::min(bmin, bins[b].min);
+            bmax = glm::max(bmax, bins[b].max);
+            count += bins[b].count;
+            if(count == 0 || count == end - begin) {
+                continue;
+            }
+            float c = left_cost[b - 1] + count * area(bmin, bmax);
+            if(c < best) {
+                best = c;
+                split = b;
+            }
+        }
+
+        if(split > 0) {
+            mid = std::partition(items.begin() + begin, items.begin() + end,
+                    [&](Item const &item) { return binOf(item) < split; })
+                - items.begin();
+        }
+    }
+
+    // all in one place, or all in one bin, so any even split will do
+    if(mid == begin || mid == end) {
+        mid = begin + (end - begin) / 2;
+        std::nth_element(items.begin() + begin, items.begin() + mid,
+                items.begin() + end, [axis](Item const &a, Item const &b) {
+                    return a.centroid[axis] < b.centroid[axis];
+                });
+    }
+
+    int left = build(items, begin, mid, index, nodes);
+    int right = build(items, mid, end, index, nodes);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+/**
+ * @return a copy of every live proxy to build a tree from
+ */
+Bvh::Build *Bvh::snapshot() const {
+    Build *b = new Build;
+    b->items.reserve(num_proxies);
+    for(int i = 0; i < (int) proxies.size(); i++) {
+        Proxy const &p = proxies[i];
+        if(p.alive) {
+            b->items.push_back({ p.min, p.max, (p.min + p.max) * 0.5f, i,
+                    p.generation, null });
+        }
+    }
+    b->root = null;
+    return b;
+}
+
+/**
+ * Replaces the tree with a rebuilt one, then brings it up to date with the
+ * proxies inserted, removed or moved since its snapshot was taken. Those
+ * edits still count towards the next rebuild.
+ * @param build the rebuilt tree
+ */
+void Bvh::apply(Build &build) {
+    nodes = std::move(build.nodes);
+    free_nodes.clear();
+    root = build.root;
+
+    // judge later edits against the fresh tree, not the patched one
+    build_cost = cost();
+
+    for(Proxy &p : proxies) {
+        p.leaf = null;
+    }
+
+    std::vector<int> moved;
+    for(Item const &item : build.items) {
+        Proxy &p = proxies[item.proxy];
+        if(!p.alive || p.generation != item.generation) {
+            removeLeaf(item.leaf);
+            freeNode(item.leaf);
+            continue;
+        }
+
+        p.leaf = item.leaf;
+        if(p.min != item.min || p.max != item.max) {
+            moved.push_back(item.proxy);
+        }
+    }
+
+    for(int proxy : moved) {
+        Proxy &p = proxies[proxy];
+        nodes[p.leaf].min = p.min;
+        nodes[p.leaf].max = p.max;
+        refit(nodes[p.leaf].parent);
+    }
+
+    for(int i = 0; i < (int) proxies.size(); i++) {
+        Proxy &p = proxies[i];
+        if(p.alive && p.leaf == null) {
+            p.leaf = allocateNode();
+            nodes[p.leaf] = { p.min, p.max, null, null, null, i };
+            insertLeaf(p.leaf);
+        }
+    }
+}
+
+void Bvh::maintain() {
+    Build *done;
+    if(building && built.popAsync(done)) {
+        apply(*done);
+        delete done;
+        building = false;
+    }
+
+    // checking the cost walks the whole tree, so wait for enough edits
+    if(building || num_proxies < 2
+            || edits < std::max<size_t>(64, num_proxies / 16)) {
+        return;
+    }
+    edits = 0;
+    if(cost() <= build_cost * REBUILD_THRESHOLD) {
+        return;
+    }
+
+    Build *b = snapshot();
+    building = true;
+    threads.run([this, b]() {
+        b->root = Bvh::build(b->items, 0, b->items.size(), null, b->nodes);
+        built.push(b);
+    });
+}
+
+void Bvh::rebuild() {
+    // a background build would be out of date anyway
+    if(building) {
+        delete built.pop();
+        building = false;
+    }
+
+    Build *b = snapshot();
+    if(!b->items.empty()) {
+        b->root = build(b->items, 0, b->items.size(), null, b->nodes);
+    }
+    apply(*b);
+    delete b;
+    edits = 0;
+}
+
+void Bvh::query(glm::vec4 const planes[6], std::vector<int> &out) const {
+    if(root == null) {
+        return;
+    }
+
+    stack.clear();
+    stack.push_back({ root, 0x3f });
+    while(!stack.empty()) {
+        auto [index, mask] = stack.back();
+        stack.pop_back();
+        Node const &node = nodes[index];
+
+        // once a node is inside a plane so is everything below it, so that
+        // plane is dropped from the mask
+        glm::vec3 center = (node.min + node.max) * 0.5f;
+        glm::vec3 extent = (node.max - node.min) * 0.5f;
+        bool outside = false;
+        for(int p = 0; p < 6 && mask; p++) {
+            if(!(mask & (1u << p))) {
+                continue;
+            }
+            glm::vec3 normal(planes[p]);
+            float distance = glm::dot(normal, center) + planes[p].w;
+            float radius = glm::dot(glm::abs(normal), extent);
+            if(distance + radius < 0.0f) {
+                outside = true;
+                break;
+            }
+            if(distance - radius >= 0.0f) {
+                mask &= ~(1u << p);
+            }
+        }
+        if(outside) {
+            continue;
+        }
+
+        if(node.left == null) {
+            out.push_back(node.proxy);
+        }
+        else {
+            stack.push_back({ node.left, mask });
+            stack.push_back({ node.right, mask });
+        }
+    }
+}
+
+void Bvh::query(glm::vec3 const &center, float radius,
+        std::vector<int> &out) const {
+    if(root == null) {
+        return;
+    }
+
+    float radius2 = radius * radius;
+    stack.clear();
+    stack.push_back({ root, 0 });
+    while(!stack.empty()) {
+        Node const &node = nodes[stack.back().first];
+        stack.pop_back();
+
+        glm::vec3 d = center - glm::clamp(center, node.min, node.max);
+        if(glm::dot(d, d) > radius2) {
+            continue;
+        }
+
+        if(node.left == null) {
+            out.push_back(node.proxy);
+        }
+        else {
+            stack.push_back({ node.left, 0 });
+            stack.push_back({ node.right, 0 });
+        }
+    }
+}
+
+// what slab returns for a ray that misses the box
+static constexpr float MISS = std::numeric_limits<float>::infinity();
+
+/**
+ * @return how far along a ray it enters a box, or MISS if it misses
+ */
+static float slab(glm::vec3 const &origin, glm::vec3 const &inv_direction,
+        glm::vec3 const &min, glm::vec3 const &max) {
+    glm::vec3 t0 = (min - origin) * inv_direction;
+    glm::vec3 t1 = (max - origin) * inv_direction;
+    glm::vec3 t_min = glm::min(t0, t1);
+    glm::vec3 t_max = glm::max(t0, t1);
+    float enter = std::max(std::max(t_min.x, t_min.y),
+            std::max(t_min.z, 0.0f));
+    float exit = std::min(std::min(t_max.x, t_max.y), t_max.z);
+    return enter <= exit ? enter : MISS;
+}
+
+int Bvh::raycast(glm::vec3 const &origin, glm::vec3 const &direction,
+        float max_distance, float &distance) const {
+    if(root == null) {
+        return null;
+    }
+
+    glm::vec3 inv_direction = 1.0f / direction;
+    int hit = null;
+    float best = max_distance;
+
+    // a miss is infinitely far, which is not out of reach of an infinite ray
+    auto reaches = [&best](float enter) {
+        return enter != MISS && enter <= best;
+    };
+
+    stack.clear();
+    stack.push_back({ root, 0 });
+    while(!stack.empty()) {
+        Node const &node = nodes[stack.back().first];
+        stack.pop_back();
+
+        float enter = slab(origin, inv_direction, node.min, node.max);
+        if(!reaches(enter)) {
+            continue;
+        }
+
+        if(node.left == null) {
+            hit = node.proxy;
+            best = enter;
+            continue;
+        }
+
+        // visit the nearer child first, so it can rule out the other
+        Node const &left = nodes[node.left];
+        Node const &right = nodes[node.right];
+        float tl = slab(origin, inv_direction, left.min, left.max);
+        float tr = slab(origin, inv_direction, right.min, right.max);
+        std::pair<int, unsigned> nearer = { node.left, 0 };
+        std::pair<int, unsigned> farther = { node.right, 0 };
+        if(tr < tl) {
+            std::swap(nearer, farther);
+            std::swap(tl, tr);
+        }
+        if(reaches(tr)) {
+            stack.push_back(farther);
+        }
+        if(reaches(tl)) {
+            stack.push_back(nearer);
+        }
+    }
+
+    distance = best;
+    return hit;
+}
@@ -1,4 +1,7 @@
+#include <glm/geometric.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 #include "graphics/camera.h"
 
@@ -18,3 +21,24 @@ glm::mat4 Camera::getView() {
     return glm::lookAt(pos, pos + front, up);
 }
 
+void Camera::updateFrustum() {
+    // each plane is the sum or difference of the last row of the clip
+    // matrix and one of the others (Gribb and Hartmann)
+    glm::mat4 clip = proj * getView();
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+    }
+
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+
+    for(glm::vec4 &plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
@@ -0,0 +1,136 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/culling.h"
+
+namespace culling {
+
+void BoxList::clear() {
+    center_x.clear();
+    center_y.clear();
+    center_z.clear();
+    extent_x.clear();
+    extent_y.clear();
+    extent_z.clear();
+}
+
+void BoxList::push(glm::vec3 const &center, glm::vec3 const &extent) {
+    center_x.push_back(center.x);
+    center_y.push_back(center.y);
+    center_z.push_back(center.z);
+    extent_x.push_back(extent.x);
+    extent_y.push_back(extent.y);
+    extent_z.push_back(extent.z);
+}
+
+void BoxList::push(glm::vec3 const &min, glm::vec3 const &max,
+        glm::mat4 const &world) {
+    glm::vec3 center, extent;
+    transform(min, max, world, center, extent);
+    push(center, extent);
+}
+
+void transform(glm::vec3 const &min, glm::vec3 const &max,
+        glm::mat4 const &world, glm::vec3 &center, glm::vec3 &extent) {
+    glm::vec3 local_center = (min + max) * 0.5f;
+    glm::vec3 local_extent = (max - min) * 0.5f;
+
+    // the extent of a rotated box along an axis is the sum of its own
+    // extents projected onto that axis
+    center = glm::vec3(world * glm::vec4(local_center, 1.0f));
+    extent = glm::vec3(0.0f);
+    for(int axis = 0; axis < 3; axis++) {
+        extent += glm::abs(glm::vec3(world[axis])) * local_extent[axis];
+    }
+}
+
+/**
+ * @param plane a frustum plane
+ * @param i the box to test
+ * @return whether or not box i is entirely behind the plane
+ */
+static bool behind(glm::vec4 const &plane, BoxList const &boxes, size_t i) {
+    float distance = plane.x * boxes.center_x[i]
+        + plane.y * boxes.center_y[i]
+        + plane.z * boxes.center_z[i] + plane.w;
+    float radius = std::fabs(plane.x) * boxes.extent_x[i]
+        + std::fabs(plane.y) * boxes.extent_y[i]
+        + std::fabs(plane.z) * boxes.extent_z[i];
+    return distance + radius < 0.0f;
+}
+
+size_t cull(glm::vec4 const planes[6], BoxList const &boxes,
+        uint8_t *visible) {
+    size_t n = boxes.size();
+    size_t count = 0;
+    size_t i = 0;
+
+#ifdef CULLING_SSE
+    // broadcast each plane once, and its absolute normal for the extents
+    __m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for(int p = 0; p < 6; p++) {
+        px[p] = _mm_set1_ps(planes[p].x);
+        py[p] = _mm_set1_ps(planes[p].y);
+        pz[p] = _mm_set1_ps(planes[p].z);
+        pw[p] = _mm_set1_ps(planes[p].w);
+        ax[p] = _mm_set1_ps(std::fabs(planes[p].x));
+        ay[p] = _mm_set1_ps(std::fabs(planes[p].y));
+        az[p] = _mm_set1_ps(std::fabs(planes[p].z));
+    }
+
+    __m128 zero = _mm_setzero_ps();
+    for(; i + 4 <= n; i += 4) {
+        __m128 cx = _mm_loadu_ps(&boxes.center_x[i]);
+        __m128 cy = _mm_loadu_ps(&boxes.center_y[i]);
+        __m128 cz = _mm_loadu_ps(&boxes.center_z[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.extent_x[i]);
+        __m128 ey = _mm_loadu_ps(&boxes.extent_y[i]);
+        __m128 ez = _mm_loadu_ps(&boxes.extent_z[i]);
+
+        // set in each lane whose box is behind any plane
+        __m128 outside = zero;
+        for(int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+                _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+                _mm_mul_ps(az[p], ez));
+            outside = _mm_or_ps(outside,
+                _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for(int lane = 0; lane < 4; lane++) {
+            uint8_t in = !(mask & (1 << lane));
+            visible[i + lane] = in;
+            count += in;
+        }
+    }
+#endif
+
+    // whatever is left over from the groups of four
+    for(; i < n; i++) {
+        uint8_t in = 1;
+        for(int p = 0; p < 6 && in; p++) {
+            in = !behind(planes[p], boxes, i);
+        }
+        visible[i] = in;
+        count += in;
+    }
+
+    return count;
+}
+
+};
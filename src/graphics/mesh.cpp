@@ -1,17 +1,58 @@
 #include <stdio.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <glad/gl.h>
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 #include "graphics/material.h"
 #include "graphics/mesh.h"
 #include "graphics/texture.h"
+#include "graphics/texture_loader.h"
+#include "graphics/texture_registry.h"
 #include "graphics/vertex.h"
 
+Mesh::Mesh(Mesh &&other) noexcept {
+    *this = std::move(other);
+}
+
+Mesh &Mesh::operator=(Mesh &&other) noexcept {
+    if(this != &other) {
+        destroy();
+        vao = std::exchange(other.vao, 0);
+        vbo = std::exchange(other.vbo, 0);
+        ebo = std::exchange(other.ebo, 0);
+        num_indices = std::exchange(other.num_indices, 0);
+        materials = std::move(other.materials);
+        other.materials.clear();
+        lods = std::move(other.lods);
+        other.lods.clear();
+        bounds_min = other.bounds_min;
+        bounds_max = other.bounds_max;
+        center = other.center;
+        radius = other.radius;
+    }
+    return *this;
+}
+
+Mesh::~Mesh() {
+    destroy();
+}
+
 void Mesh::create(std::vector<Vertex> vertices,
         std::vector<unsigned int> indices, std::vector<Material> materials) {
-    num_indices = indices.size();
+    create(vertices.data(), vertices.size(), indices.data(), indices.size(),
+            std::move(materials));
+}
+
+void Mesh::create(Vertex const *vertices, size_t num_vertices,
+        unsigned int const *indices, size_t num_indices,
+        std::vector<Material> materials) {
+    this->num_indices = num_indices;
 
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
@@ -19,10 +60,10 @@ void Mesh::create(std::vector<Vertex> vertices,
     glGenBuffers(1, &ebo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-            &vertices[0], GL_STATIC_DRAW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(Vertex), vertices,
+            GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(unsigned int),
+            indices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
@@ -34,29 +75,78 @@ void Mesh::create(std::vector<Vertex> vertices,
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
             (void*) (6 * sizeof(float)));
 
-    this->materials = materials;
+    this->materials = std::move(materials);
+    setLods({});
+}
+
+void Mesh::setBounds(glm::vec3 const &min, glm::vec3 const &max) {
+    bounds_min = min;
+    bounds_max = max;
+    center = (min + max) * 0.5f;
+    radius = glm::length(max - center);
 }
 
-void Mesh::draw(ShaderProgram const &shader) {
+void Mesh::setLods(std::vector<MeshLod> levels) {
+    lods = std::move(levels);
+    if(lods.empty()) {
+        lods.push_back({ 0, num_indices, 0.0f });
+    }
+}
+
+void Mesh::bindInstanceBuffer(unsigned int buffer) {
     glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
 
-    for(int i = 0; i < materials.size(); i += 3) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE, materials[i].ambient.id);
-        glActiveTexture(GL_TEXTURE0 + i + 1);
-        glBindTexture(GL_TEXTURE, materials[i].diffuse.id);
-        glActiveTexture(GL_TEXTURE0 + i + 2);
-        glBindTexture(GL_TEXTURE, materials[i].specular.id);
+    // a mat4 attribute takes one location per column
+    for(int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                (void*) (i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + i, 1);
     }
 
-    glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
 }
 
+void Mesh::draw(unsigned int instances, unsigned int base_instance,
+        unsigned int lod) const {
+    MeshLod const &level = lods[lod];
+    glDrawElementsInstancedBaseInstance(GL_TRIANGLES, level.num_indices,
+            GL_UNSIGNED_INT,
+            (void*) (level.first_index * sizeof(unsigned int)), instances,
+            base_instance);
+}
+
 void Mesh::destroy() {
+    if(vao == 0) {
+        return;
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    vao = vbo = ebo = 0;
+    num_indices = 0;
+    lods.clear();
+
+    TextureRegistry *registry = TextureRegistry::current();
+    TextureLoader *loader = TextureLoader::current();
+
     for(int i = 0; i < materials.size(); i++) {
         materials[i].ambient.destroy();
-        materials[i].diffuse.destroy();
         materials[i].specular.destroy();
+
+        // shared textures belong to the registry
+        if(registry && materials[i].diffuse_handle.id != Handle::invalid) {
+            registry->release(materials[i].diffuse_handle);
+        }
+        else {
+            if(loader) {
+                loader->cancel(materials[i].diffuse.id);
+            }
+            materials[i].diffuse.destroy();
+        }
     }
+
+    materials.clear();
 }
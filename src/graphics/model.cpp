@@ -1,28 +1,75 @@
 #include <cstdio>
 #include <fstream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
 #include "graphics/model.h"
 #include "graphics/shader.h"
 
+#include "utils/mesh_cache.h"
+#include "utils/mesh_simplify.h"
 #include "utils/obj_loader.h"
 
-bool Model::create(std::string path) {
-    return obj_loader::loadObj(meshes, path);
+/**
+ * Fills in the bounds of a model from those of its meshes
+ * @param model the model
+ */
+static void computeBounds(Model &model) {
+    if(model.meshes.empty()) {
+        return;
+    }
+
+    model.bounds_min = model.meshes[0].bounds_min;
+    model.bounds_max = model.meshes[0].bounds_max;
+    for(Mesh const &m : model.meshes) {
+        model.bounds_min = glm::min(model.bounds_min, m.bounds_min);
+        model.bounds_max = glm::max(model.bounds_max, m.bounds_max);
+    }
+
+    model.center = (model.bounds_min + model.bounds_max) * 0.5f;
+    model.radius = glm::length(model.bounds_max - model.center);
 }
 
-void Model::destroy() {
-    for(Mesh m : meshes) {
-        m.destroy();
+bool Model::create(std::string path) {
+    // a fresh cache skips parsing entirely
+    if(mesh_cache::load(meshes, path)) {
+        computeBounds(*this);
+        return true;
     }
+
+    MeshData data;
+    if(!obj_loader::parseObj(data, path)) {
+        return false;
+    }
+
+    // simplified once here, the cache keeps the levels from then on
+    mesh_simplify::buildLods(data);
+
+    // a failed write only means parsing again next time
+    mesh_cache::save(data, path);
+
+    obj_loader::loadTextures(data.materials);
+
+    Mesh m;
+    m.create(std::move(data.vertices), std::move(data.indices),
+            std::move(data.materials));
+    m.setBounds(data.bounds_min, data.bounds_max);
+    m.setLods(std::move(data.lods));
+    meshes.push_back(std::move(m));
+
+    computeBounds(*this);
+    return true;
 }
 
-void Model::draw(ShaderProgram const &shader) {
-    for(Mesh mesh : meshes) {
-        mesh.draw(shader);
+void Model::destroy() {
+    for(Mesh &m : meshes) {
+        m.destroy();
     }
+    meshes.clear();
 }
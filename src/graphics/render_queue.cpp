@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <glad/gl.h>
+
+#include "graphics/material.h"
+#include "graphics/mesh.h"
+#include "graphics/render_queue.h"
+#include "graphics/shader.h"
+
+// tracked state that matches nothing, since other code binds things too
+static constexpr unsigned int unknown = ~0u;
+
+uint64_t RenderQueue::makeKey(unsigned int pass, ShaderProgram const &shader,
+        Mesh const &mesh, float depth) {
+    unsigned int texture = mesh.materials.empty()
+        ? 0 : mesh.materials[0].diffuse.id;
+
+    // the bits of a positive float order the same way it does, so its top
+    // 24 (the sign is always 0) quantize it without knowing the depth range
+    uint32_t depth_bits = 0;
+    if(depth > 0.0f) {
+        std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+    }
+
+    return (uint64_t) (pass & 0x3) << 62
+        | (uint64_t) (shader.id & 0xfff) << 50
+        | (uint64_t) (texture & 0x3fff) << 36
+        | (uint64_t) (mesh.vao & 0xfff) << 24
+        | depth_bits >> 7;
+}
+
+void RenderQueue::sort() {
+    size_t n = packets.size();
+    if(n < 2) {
+        return;
+    }
+
+    // count every byte of every key up front, one histogram per byte
+    size_t counts[8][256] = {};
+    for(DrawPacket const &packet : packets) {
+        for(int byte = 0; byte < 8; byte++) {
+            counts[byte][(packet.key >> (byte * 8)) & 0xff]++;
+        }
+    }
+
+    scratch.resize(n);
+    DrawPacket *src = packets.data();
+    DrawPacket *dest = scratch.data();
+
+    // least significant byte first, each pass keeping the order of the last
+    for(int byte = 0; byte < 8; byte++) {
+        int shift = byte * 8;
+
+        // every key has the same byte here, so nothing would move
+        if(counts[byte][(src[0].key >> shift) & 0xff] == n) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for(size_t &count : counts[byte]) {
+            size_t bucket_size = count;
+            count = offset;
+            offset += bucket_size;
+        }
+
+        for(size_t i = 0; i < n; i++) {
+            dest[counts[byte][(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+        std::swap(src, dest);
+    }
+
+    if(src != packets.data()) {
+        std::copy(src, src + n, packets.data());
+    }
+}
+
+void RenderQueue::submit() {
+    stats = {};
+
+    unsigned int program = unknown;
+    unsigned int vertex_array = unknown;
+    unsigned int textures[3] = { unknown, unknown, unknown };
+
+    bool shininess_set = false;
+    float current_shininess = 0.0f;
+
+    for(DrawPacket const &packet : packets) {
+        if(packet.shader->id != program) {
+            program = packet.shader->id;
+            glUseProgram(program);
+            stats.program_binds++;
+
+            // uniforms belong to the program, so they have to be set again
+            shininess_set = false;
+        }
+
+        if(packet.mesh->vao != vertex_array) {
+            vertex_array = packet.mesh->vao;
+            glBindVertexArray(vertex_array);
+            stats.vertex_array_binds++;
+        }
+
+        // the units match the mat.* samplers set up by the scene
+        if(!packet.mesh->materials.empty()) {
+            Material const &material = packet.mesh->materials[0];
+            unsigned int ids[3] = {
+                material.diffuse.id, material.ambient.id, material.specular.id
+            };
+            for(int unit = 0; unit < 3; unit++) {
+                if(ids[unit] != textures[unit]) {
+                    textures[unit] = ids[unit];
+                    glActiveTexture(GL_TEXTURE0 + unit);
+                    glBindTexture(GL_TEXTURE_2D, ids[unit]);
+                    stats.texture_binds++;
+                }
+            }
+
+            if(packet.shininess.valid() && (!shininess_set
+                        || material.shininess != current_shininess)) {
+                current_shininess = material.shininess;
+                shininess_set = true;
+                packet.shader->set(packet.shininess, current_shininess);
+                stats.uniform_sets++;
+            }
+        }
+
+        packet.mesh->draw(packet.instances, packet.base_instance,
+                packet.lod);
+        stats.draw_calls++;
+        stats.instances += packet.instances;
+    }
+
+    glBindVertexArray(0);
+}
@@ -1,10 +1,64 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <stdio.h>
+#include <string_view>
 
 #include <glad/gl.h>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "graphics/shader.h"
+#include "graphics/uniform_buffer.h"
+
+/**
+ * Builds the uniform table of a linked program, and binds the shared uniform
+ * blocks it uses to their binding points
+ * @param program the program to reflect
+ */
+static void reflect(ShaderProgram &program) {
+    char name[256];
+    int length;
+
+    int num_uniforms;
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+    program.uniforms.clear();
+    for(int i = 0; i < num_uniforms; i++) {
+        Uniform uniform;
+        GLenum type;
+        glGetActiveUniform(program.id, i, sizeof(name), &length,
+                &uniform.size, &type, name);
+        uniform.type = type;
+        uniform.location = glGetUniformLocation(program.id, name);
+
+        // members of uniform blocks have no location of their own
+        if(uniform.location == -1) {
+            continue;
+        }
+
+        // arrays are reported as name[0], look them up by name
+        std::string_view base(name, length);
+        if(base.ends_with("[0]")) {
+            base.remove_suffix(3);
+        }
+        uniform.name = base;
+
+        program.uniforms.push_back(uniform);
+    }
+
+    std::sort(program.uniforms.begin(), program.uniforms.end(),
+            [](Uniform const &a, Uniform const &b) { return a.name < b.name; });
+
+    int num_blocks;
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_BLOCKS, &num_blocks);
+    for(int i = 0; i < num_blocks; i++) {
+        glGetActiveUniformBlockName(program.id, i, sizeof(name), &length,
+                name);
+        std::string_view block(name, length);
+        if(block == "Camera") {
+            glUniformBlockBinding(program.id, i, uniform_block::camera);
+        }
+    }
+}
 
 bool ShaderProgram::create(std::string vertex_path, std::string fragment_path) {
     std::ifstream vertex_file(vertex_path);
@@ -91,7 +145,7 @@ bool ShaderProgram::create(std::string vertex_path, std::string fragment_path) {
     glAttachShader(id, fragment_id);
     glLinkProgram(id);
 
-    glGetProgramiv(id, GL_COMPILE_STATUS, &status);
+    glGetProgramiv(id, GL_LINK_STATUS, &status);
 
     if(!status) {
         glGetProgramInfoLog(id, 1024, 0, infoLog);
@@ -111,6 +165,8 @@ bool ShaderProgram::create(std::string vertex_path, std::string fragment_path) {
     glDeleteShader(vertex_id);
     glDeleteShader(fragment_id);
 
+    reflect(*this);
+
     return true;
 }
 
@@ -122,28 +178,52 @@ void ShaderProgram::use() {
     glUseProgram(id);
 }
 
-bool ShaderProgram::setUniformInt(std::string name, int value) const {
-    int location = glGetUniformLocation(id, name.c_str());
-    if(location == -1) {
-        return false;
+UniformHandle ShaderProgram::uniform(std::string_view name) const {
+    auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name,
+            [](Uniform const &u, std::string_view n) { return u.name < n; });
+    if(it == uniforms.end() || it->name != name) {
+        return UniformHandle{};
+    }
+    return UniformHandle{ it->location };
+}
+
+void ShaderProgram::set(UniformHandle handle, int value) const {
+    if(handle.valid()) {
+        glUniform1i(handle.location, value);
     }
+}
 
-    glUniform1i(location, value);
+void ShaderProgram::set(UniformHandle handle, float value) const {
+    if(handle.valid()) {
+        glUniform1f(handle.location, value);
+    }
+}
 
-    return true;
+void ShaderProgram::set(UniformHandle handle, glm::vec3 const &value) const {
+    if(handle.valid()) {
+        glUniform3fv(handle.location, 1, glm::value_ptr(value));
+    }
 }
 
-bool ShaderProgram::setUniformFloat(std::string name, float value) const {
-    int location = glGetUniformLocation(id, name.c_str());
-    if(location == -1) {
-        return false;
+void ShaderProgram::set(UniformHandle handle, glm::mat4 const &value) const {
+    if(handle.valid()) {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE,
+                glm::value_ptr(value));
     }
+}
 
-    glUniform1f(location, value);
+bool ShaderProgram::setUniformInt(std::string_view name, int value) const {
+    UniformHandle handle = uniform(name);
+    set(handle, value);
+    return handle.valid();
+}
 
-    return true;
+bool ShaderProgram::setUniformFloat(std::string_view name, float value) const {
+    UniformHandle handle = uniform(name);
+    set(handle, value);
+    return handle.valid();
 }
 
-bool ShaderProgram::operator<(ShaderProgram const other) const {
+bool ShaderProgram::operator<(ShaderProgram const &other) const {
     return this->id < other.id;
 }
@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <string>
+#include <vector>
 
 #include <glad/gl.h>
 
@@ -8,16 +9,74 @@
 
 #include "graphics/texture.h"
 
+#include "utils/block_compress.h"
+#include "utils/image.h"
+#include "utils/mipmap.h"
+#include "utils/texture_cache.h"
+
 bool Texture::create(std::string path) {
-    int width, height;
-    unsigned char *data = stbi_load(path.c_str(), &width, &height, 0, 4);
+    // a cooked texture skips decoding and mip generation
+    if(texture_cache::load(*this, path)) {
+        return true;
+    }
 
-    if(!data) {
+    std::vector<Image> images(1);
+    if(!images[0].create(path)) {
         std::fprintf(stderr, "Failed to load texture %s\n", path.c_str());
 
         return false;
     }
 
+    mipmap::build(images);
+
+    std::vector<TextureLevel> levels;
+    for(Image const &image : images) {
+        levels.push_back({ image.width, image.height, image.pixels.data() });
+    }
+    create(levels.data(), levels.size());
+
+    return true;
+}
+
+// not part of core OpenGL, but supported by every desktop driver
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/**
+ * @param format the format of a texture
+ * @return the OpenGL internal format of a compressed format
+ */
+static GLenum compressedFormat(TextureFormat format) {
+    switch(format) {
+    case TextureFormat::bc1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TextureFormat::bc3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+}
+
+void Texture::uploadLevel(TextureLevel const &level, int index,
+        TextureFormat format) {
+    if(format == TextureFormat::rgba8) {
+        glTexImage2D(GL_TEXTURE_2D, index, GL_RGBA, level.width, level.height,
+                0, GL_RGBA, GL_UNSIGNED_BYTE, level.pixels);
+    }
+    else {
+        glCompressedTexImage2D(GL_TEXTURE_2D, index, compressedFormat(format),
+                level.width, level.height, 0,
+                block_compress::levelSize(format, level.width, level.height),
+                level.pixels);
+    }
+}
+
+void Texture::create(TextureLevel const *levels, int num_levels,
+        TextureFormat format) {
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_2D, id);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
@@ -26,13 +85,11 @@ bool Texture::create(std::string path) {
             GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-            GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
+    for(int i = 0; i < num_levels; i++) {
+        uploadLevel(levels[i], i, format);
+    }
 
-    return true;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
 }
 
 void Texture::destroy() {
@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "graphics/texture.h"
+#include "graphics/texture_loader.h"
+
+#include "utils/image.h"
+#include "utils/mipmap.h"
+#include "utils/texture_cache.h"
+
+TextureLoader *TextureLoader::active = nullptr;
+
+TextureLoader::TextureLoader(unsigned num_threads) :
+    threads(num_threads),
+    uploading(nullptr),
+    num_pending(0) { }
+
+TextureLoader::~TextureLoader() {
+    // the workers push into the queue, so wait out any still decoding
+    unsigned queued = num_pending - (uploading ? 1 : 0);
+    for(unsigned i = 0; i < queued; i++) {
+        delete decoded.pop();
+    }
+    delete uploading;
+
+    if(active == this) {
+        active = nullptr;
+    }
+}
+
+/**
+ * Runs on a worker thread. Reads the cooked mip chain if there is one, and
+ * otherwise decodes the image and builds the chain itself. Cooked levels
+ * may be block compressed, and are uploaded as they are.
+ * @param request the texture to decode
+ */
+void TextureLoader::decode(Request *request) {
+    std::vector<Image> &levels = request->levels;
+
+    if(!texture_cache::read(levels, request->format, request->path)) {
+        request->format = TextureFormat::rgba8;
+        levels.resize(1);
+        if(levels[0].create(request->path)) {
+            mipmap::build(levels);
+        }
+        else {
+            levels.clear();
+        }
+    }
+
+    request->ok = !levels.empty();
+    request->next_level = (int) levels.size() - 1;
+    decoded.push(request);
+}
+
+/**
+ * Uploads the smallest level of a texture that has not been uploaded yet,
+ * and makes it the base level so that only the levels present are sampled
+ * @param request the texture to upload to
+ */
+void TextureLoader::uploadLevel(Request &request) {
+    int i = request.next_level;
+    Image &level = request.levels[i];
+
+    glBindTexture(GL_TEXTURE_2D, request.id);
+    Texture::uploadLevel({ level.width, level.height, level.pixels.data() },
+            i, request.format);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+            (int) request.levels.size() - 1);
+
+    // the staging copy is no longer needed
+    std::vector<unsigned char>().swap(level.pixels);
+    request.next_level--;
+}
+
+/**
+ * Drops the texture currently being uploaded
+ */
+void TextureLoader::finish() {
+    if(!uploading->cancelled) {
+        requests.erase(uploading->id);
+    }
+    delete uploading;
+    uploading = nullptr;
+    num_pending--;
+}
+
+void TextureLoader::load(Texture &texture, std::string const &path) {
+    glGenTextures(1, &texture.id);
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+            GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // a single mid grey texel until the real image arrives
+    static unsigned char const placeholder[4] = { 128, 128, 128, 255 };
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    Request *request = new Request{ texture.id, path, {},
+        TextureFormat::rgba8, false, 0, false };
+    requests[texture.id] = request;
+    num_pending++;
+    threads.run([this, request]() { decode(request); });
+}
+
+void TextureLoader::cancel(unsigned int id) {
+    auto it = requests.find(id);
+    if(it == requests.end()) {
+        return;
+    }
+
+    // a worker may still be decoding it, so it is dropped once it comes
+    // out of the queue
+    it->second->cancelled = true;
+    requests.erase(it);
+}
+
+size_t TextureLoader::update(size_t byte_budget) {
+    size_t spent = 0;
+
+    while(true) {
+        if(!uploading) {
+            if(!decoded.popAsync(uploading)) {
+                break;
+            }
+
+            if(!uploading->ok && !uploading->cancelled) {
+                std::fprintf(stderr, "Failed to load texture %s\n",
+                        uploading->path.c_str());
+                finish();
+                continue;
+            }
+        }
+
+        // the texture was destroyed while it was loading, and its id may
+        // already belong to another
+        if(uploading->cancelled) {
+            finish();
+            continue;
+        }
+
+        size_t bytes = uploading->levels[uploading->next_level].pixels.size();
+        if(spent > 0 && spent + bytes > byte_budget) {
+            break;
+        }
+
+        uploadLevel(*uploading);
+        spent += bytes;
+
+        if(uploading->next_level < 0) {
+            finish();
+        }
+    }
+
+    return spent;
+}
@@ -0,0 +1,147 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+#include <stb/stb_image.h>
+
+#include "graphics/texture.h"
+#include "graphics/texture_loader.h"
+#include "graphics/texture_registry.h"
+
+#include "utils/asset_stamp.h"
+#include "utils/registry.h"
+#include "utils/texture_cache.h"
+
+TextureRegistry *TextureRegistry::active = nullptr;
+
+TextureRegistry::TextureRegistry(size_t budget) :
+    budget(budget),
+    resident(0) { }
+
+/**
+ * Estimates how much texture memory an image takes up once uploaded, from
+ * its cooked copy or else the dimensions in its header
+ * @param path the path to the image file
+ * @return the estimated size in bytes
+ */
+static size_t estimateSize(std::string const &path) {
+    size_t size = texture_cache::residentSize(path);
+    if(size > 0) {
+        return size;
+    }
+
+    // uncompressed RGBA8, plus a third for the mip chain
+    int width, height, channels;
+    if(!stbi_info(path.c_str(), &width, &height, &channels)) {
+        return 0;
+    }
+    return (size_t) width * height * 4 * 4 / 3;
+}
+
+/**
+ * Destroys a texture, first cancelling its load if it is still loading so
+ * the upload cannot land on a texture that reuses the id
+ * @param texture the texture to destroy
+ */
+static void destroyTexture(Texture &texture) {
+    TextureLoader *loader = TextureLoader::current();
+    if(loader) {
+        loader->cancel(texture.id);
+    }
+    texture.destroy();
+}
+
+/**
+ * Destroys the least recently released textures until the budget is met
+ */
+void TextureRegistry::evict() {
+    while(resident > budget && !unused.empty()) {
+        Entry &entry = textures[unused.front()];
+        unused.pop_front();
+
+        destroyTexture(entry.texture);
+        resident -= entry.size;
+
+        uint64_t hash = entry.hash;
+        textures.remove(hash);
+    }
+}
+
+Handle TextureRegistry::acquire(std::string const &path) {
+    std::error_code ec;
+    std::string canonical
+        = std::filesystem::weakly_canonical(path, ec).generic_string();
+    if(ec) {
+        canonical = path;
+    }
+
+    // only rehash a file that has been modified since it was last seen
+    auto [it, inserted] = stamps.try_emplace(canonical);
+    AssetStamp &stamp = it->second;
+    bool touched;
+    if((inserted || !stamp.matches(canonical, touched))
+            && !stamp.create(canonical)) {
+        std::fprintf(stderr, "Failed to load texture %s\n", path.c_str());
+        stamps.erase(it);
+        return Handle{};
+    }
+
+    Handle handle = textures.find(stamp.hash);
+    if(handle.id != Handle::invalid) {
+        Entry &entry = textures[handle];
+        if(entry.refs++ == 0) {
+            unused.erase(entry.unused_it);
+        }
+        return handle;
+    }
+
+    Entry entry = {};
+    entry.hash = stamp.hash;
+    entry.path = canonical;
+    entry.size = estimateSize(canonical);
+    entry.refs = 1;
+
+    TextureLoader *loader = TextureLoader::current();
+    if(loader) {
+        loader->load(entry.texture, canonical);
+    }
+    else if(!entry.texture.create(canonical)) {
+        return Handle{};
+    }
+
+    handle = textures.put(entry.hash, entry);
+    resident += entry.size;
+    evict();
+
+    return handle;
+}
+
+void TextureRegistry::release(Handle handle) {
+    Entry &entry = textures[handle];
+    assert(entry.refs > 0 && "releasing an unreferenced texture?");
+
+    if(--entry.refs == 0) {
+        unused.push_back(handle);
+        entry.unused_it = std::prev(unused.end());
+        evict();
+    }
+}
+
+void TextureRegistry::setBudget(size_t bytes) {
+    budget = bytes;
+    evict();
+}
+
+void TextureRegistry::destroy() {
+    for(auto &[handle, entry] : textures.entries) {
+        destroyTexture(entry.texture);
+    }
+    textures.entries.clear();
+    textures.registry.clear();
+    unused.clear();
+    resident = 0;
+}
@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <latch>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define TRANSFORM_SSE
+#include <emmintrin.h>
+#endif
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "graphics/transform_hierarchy.h"
+
+// the smallest depth worth splitting across workers, and the smallest share
+static constexpr size_t parallel_threshold = 4096;
+static constexpr size_t min_chunk_size = 1024;
+
+// slots out of order are only sorted once they are this share of them all
+static constexpr size_t unsorted_fraction = 8;
+
+/**
+ * Multiplies two matrices, a column at a time with SSE where available
+ * @param a the left matrix
+ * @param b the right matrix
+ * @param out the destination, must not be a or b
+ */
+static void multiply(glm::mat4 const &a, glm::mat4 const &b, glm::mat4 &out) {
+#ifdef TRANSFORM_SSE
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for(int c = 0; c < 4; c++) {
+        __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+        column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+        column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+        column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+        _mm_storeu_ps(&out[c][0], column);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+/**
+ * @return the matrix of a local transform
+ */
+static glm::mat4 compose(glm::vec3 const &position, glm::quat const &rotation,
+        glm::vec3 const &scale) {
+    glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(
+        glm::vec4(r[0] * scale.x, 0.0f),
+        glm::vec4(r[1] * scale.y, 0.0f),
+        glm::vec4(r[2] * scale.z, 0.0f),
+        glm::vec4(position, 1.0f));
+}
+
+TransformHierarchy::TransformHierarchy(ThreadPool &threads) :
+    num_alive(0),
+    num_unsorted(0),
+    threads(threads) { }
+
+/**
+ * Queues a slot at its depth, unless it already is
+ * @param slot the slot
+ */
+void TransformHierarchy::markDirty(int slot) {
+    if(!dirty[slot]) {
+        dirty[slot] = 1;
+        pending[depths[slot]].push_back(slot);
+    }
+}
+
+/**
+ * Adds a slot to the front of its parent's children
+ * @param slot the slot
+ * @param parent_slot the parent's slot, or null
+ */
+void TransformHierarchy::link(int slot, int parent_slot) {
+    parents[slot] = parent_slot;
+    next_siblings[slot] = null;
+    if(parent_slot != null) {
+        next_siblings[slot] = first_children[parent_slot];
+        first_children[parent_slot] = slot;
+    }
+}
+
+/**
+ * Removes a slot from its parent's children
+ * @param slot the slot
+ */
+void TransformHierarchy::unlink(int slot) {
+    int parent_slot = parents[slot];
+    if(parent_slot == null) {
+        return;
+    }
+
+    int *link = &first_children[parent_slot];
+    while(*link != slot) {
+        link = &next_siblings[*link];
+    }
+    *link = next_siblings[slot];
+    parents[slot] = null;
+    next_siblings[slot] = null;
+}
+
+/**
+ * Sets the depths of a slot's subtree from the depth of its parent. Queued
+ * slots whose depth changes are queued again at the new one, and left to be
+ * skipped at the old one.
+ * @param slot the root of the subtree
+ */
+void TransformHierarchy::updateDepths(int slot) {
+    std::vector<int> stack = { slot };
+    while(!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+
+        unsigned depth = parents[s] == null ? 0 : depths[parents[s]] + 1;
+        if(depth + 2 > pending.size()) {
+            pending.resize(depth + 2);
+        }
+        if(depth != depths[s]) {
+            depths[s] = depth;
+            if(dirty[s]) {
+                pending[depth].push_back(s);
+            }
+        }
+
+        for(int c = first_children[s]; c != null; c = next_siblings[c]) {
+            stack.push_back(c);
+        }
+    }
+}
+
+int TransformHierarchy::create(Transform const &local, int parent) {
+    int id;
+    if(!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+    }
+    else {
+        id = (int) slots.size();
+        slots.push_back(null);
+    }
+
+    int slot = (int) ids.size();
+    slots[id] = slot;
+    positions.push_back(local.position);
+    rotations.push_back(local.rotation);
+    scales.push_back(local.scale);
+    worlds.emplace_back(1.0f);
+    parents.push_back(null);
+    first_children.push_back(null);
+    next_siblings.push_back(null);
+    depths.push_back(0);
+    ids.push_back(id);
+    dirty.push_back(0);
+
+    link(slot, parent == null ? null : slots[parent]);
+    updateDepths(slot);
+    markDirty(slot);
+
+    // it only stays in depth order if nothing before it is deeper
+    if(slot > 0 && depths[slot - 1] > depths[slot]) {
+        num_unsorted++;
+    }
+
+    num_alive++;
+    return id;
+}
+
+void TransformHierarchy::destroy(int id) {
+    int slot = slots[id];
+    unlink(slot);
+
+    // the slots stay until the next sort drops them
+    std::vector<int> stack = { slot };
+    while(!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+
+        slots[ids[s]] = null;
+        free_ids.push_back(ids[s]);
+        ids[s] = null;
+        num_alive--;
+        num_unsorted++;
+
+        for(int c = first_children[s]; c != null; c = next_siblings[c]) {
+            stack.push_back(c);
+        }
+    }
+}
+
+void TransformHierarchy::setParent(int id, int parent) {
+    int slot = slots[id];
+    int parent_slot = parent == null ? null : slots[parent];
+    for(int s = parent_slot; s != null; s = parents[s]) {
+        assert(s != slot && "parenting a transform to its own descendant?");
+    }
+
+    markDirty(slot);
+
+    unlink(slot);
+    link(slot, parent_slot);
+    updateDepths(slot);
+    num_unsorted++;
+}
+
+int TransformHierarchy::parent(int id) const {
+    int parent_slot = parents[slots[id]];
+    return parent_slot == null ? null : ids[parent_slot];
+}
+
+void TransformHierarchy::setLocal(int id, Transform const &local) {
+    int slot = slots[id];
+    positions[slot] = local.position;
+    rotations[slot] = local.rotation;
+    scales[slot] = local.scale;
+    markDirty(slot);
+}
+
+void TransformHierarchy::setPosition(int id, glm::vec3 const &position) {
+    int slot = slots[id];
+    positions[slot] = position;
+    markDirty(slot);
+}
+
+void TransformHierarchy::setRotation(int id, glm::quat const &rotation) {
+    int slot = slots[id];
+    rotations[slot] = rotation;
+    markDirty(slot);
+}
+
+void TransformHierarchy::setScale(int id, glm::vec3 const &scale) {
+    int slot = slots[id];
+    scales[slot] = scale;
+    markDirty(slot);
+}
+
+Transform TransformHierarchy::local(int id) const {
+    int slot = slots[id];
+    return { positions[slot], rotations[slot], scales[slot] };
+}
+
+/**
+ * Reorders the slots by depth, dropping destroyed ones, and requeues
+ * whatever was queued at its new slot and depth
+ */
+void TransformHierarchy::sort() {
+    size_t n = ids.size();
+
+    // a counting sort, which keeps the order within each depth
+    std::vector<size_t> offsets(pending.size() + 1, 0);
+    for(size_t s = 0; s < n; s++) {
+        if(ids[s] != null) {
+            offsets[depths[s] + 1]++;
+        }
+    }
+    for(size_t d = 1; d < offsets.size(); d++) {
+        offsets[d] += offsets[d - 1];
+    }
+
+    std::vector<int> new_slots(n, null);
+    std::vector<int> order(num_alive);
+    for(size_t s = 0; s < n; s++) {
+        if(ids[s] != null) {
+            size_t to = offsets[depths[s]]++;
+            new_slots[s] = (int) to;
+            order[to] = (int) s;
+        }
+    }
+
+    auto remap = [&new_slots](int s) {
+        return s == null ? null : new_slots[s];
+    };
+    auto gather = [&order](auto &array) {
+        std::remove_reference_t<decltype(array)> sorted(order.size());
+        for(size_t to = 0; to < order.size(); to++) {
+            sorted[to] = array[order[to]];
+        }
+        array = std::move(sorted);
+    };
+
+    gather(positions);
+    gather(rotations);
+    gather(scales);
+    gather(worlds);
+    gather(parents);
+    gather(first_children);
+    gather(next_siblings);
+    gather(depths);
+    gather(ids);
+    gather(dirty);
+
+    // siblings that were destroyed were unlinked, so every link survives
+    for(size_t s = 0; s < order.size(); s++) {
+        parents[s] = remap(parents[s]);
+        first_children[s] = remap(first_children[s]);
+        next_siblings[s] = remap(next_siblings[s]);
+        slots[ids[s]] = (int) s;
+    }
+
+    for(std::vector<int> &level : pending) {
+        level.clear();
+    }
+    for(size_t s = 0; s < order.size(); s++) {
+        if(dirty[s]) {
+            pending[depths[s]].push_back((int) s);
+        }
+    }
+
+    num_unsorted = 0;
+}
+
+/**
+ * Recomputes the world matrices of some slots, whose parents are up to date
+ * @param level the slots
+ * @param count the number of slots
+ */
+void TransformHierarchy::computeWorlds(int const *level, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        int s = level[i];
+        glm::mat4 local = compose(positions[s], rotations[s], scales[s]);
+        if(parents[s] == null) {
+            worlds[s] = local;
+        }
+        else {
+            multiply(worlds[parents[s]], local, worlds[s]);
+        }
+    }
+}
+
+void TransformHierarchy::update() {
+    if(num_unsorted > 0 && num_unsorted * unsorted_fraction >= num_alive) {
+        sort();
+    }
+
+    changed_ids.clear();
+    for(size_t d = 0; d < pending.size(); d++) {
+        std::vector<int> &level = pending[d];
+        if(!level.empty()) {
+            process((int) d, level);
+            level.clear();
+        }
+    }
+}
+
+/**
+ * Recomputes the world matrices queued at a depth, and queues the children
+ * of each a depth below
+ * @param depth the depth
+ * @param level the slots queued at it
+ */
+void TransformHierarchy::process(int depth, std::vector<int> &level) {
+    // entries left behind by a reparent, or repeated by one, are dropped
+    // first so nothing is recomputed twice
+    size_t count = 0;
+    for(int s : level) {
+        if(ids[s] != null && dirty[s] == 1 && depths[s] == (unsigned) depth) {
+            dirty[s] = 2;
+            level[count++] = s;
+        }
+    }
+    level.resize(count);
+    if(count == 0) {
+        return;
+    }
+
+    // every parent is done by now, so the level splits freely
+    size_t num_chunks = std::min<size_t>(threads.size() + 1,
+            count / min_chunk_size);
+    if(count < parallel_threshold || num_chunks < 2) {
+        computeWorlds(level.data(), count);
+    }
+    else {
+        size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+        std::latch done(num_chunks - 1);
+        for(size_t c = 1; c < num_chunks; c++) {
+            size_t begin = c * chunk_size;
+            size_t end = std::min(count, begin + chunk_size);
+            threads.run([this, &level, &done, begin, end]() {
+                computeWorlds(level.data() + begin, end - begin);
+                done.count_down();
+            });
+        }
+        computeWorlds(level.data(), std::min(count, chunk_size));
+        done.wait();
+    }
+
+    // the children have to follow, a level down
+    for(int s : level) {
+        dirty[s] = 0;
+        changed_ids.push_back(ids[s]);
+        for(int c = first_children[s]; c != null; c = next_siblings[c]) {
+            markDirty(c);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#include <cstddef>
+
+#include <glad/gl.h>
+
+#include "graphics/uniform_buffer.h"
+
+void UniformBuffer::create(size_t size) {
+    this->size = size;
+
+    glGenBuffers(1, &id);
+    glBindBuffer(GL_UNIFORM_BUFFER, id);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void UniformBuffer::update(void const *data, size_t size, size_t offset) {
+    glBindBuffer(GL_UNIFORM_BUFFER, id);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void UniformBuffer::bind(unsigned int binding) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+}
+
+void UniformBuffer::destroy() {
+    glDeleteBuffers(1, &id);
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#include "threading/job.h"
+
+thread_local JobManager::Frame JobManager::current_frame = 0;
+
+JobManager::~JobManager() {
+    Frame first = iteration > frames_in_flight
+        ? iteration - frames_in_flight : 0;
+    for(Frame f = first; f < iteration; f++) {
+        wait(f);
+    }
+}
+
+JobManager::JobId JobManager::registerJob(std::string const &name,
+        std::function<void (void *)> ef, void *arg) {
+    assert(!compiled);
+    auto [it, added] = ids.emplace(name, (JobId) jobs.size());
+    if(added) {
+        jobs.push_back({ name, nullptr, nullptr, {}, 0 });
+    }
+
+    Job &job = jobs[it->second];
+    job.entry = std::move(ef);
+    job.arg = arg;
+    return it->second;
+}
+
+JobManager::ResourceId JobManager::registerResource(std::string const &name) {
+    assert(!compiled);
+    resources.push_back({ name, root, {} });
+    return (ResourceId) resources.size() - 1;
+}
+
+void JobManager::registerWrite(JobId job, ResourceId resource) {
+    assert(!compiled);
+    assert(resources[resource].writer == root
+        && "a resource can only have one writer");
+    resources[resource].writer = job;
+}
+
+void JobManager::registerRead(JobId job, ResourceId resource) {
+    assert(!compiled);
+    resources[resource].readers.push_back(job);
+}
+
+std::ostream &JobManager::dumpGraph(std::ostream &os) const {
+    os << "digraph {\n";
+    for(auto &[dependent, dependency] : edges) {
+        os << "    " << jobs[dependent].name << " -> "
+            << jobs[dependency].name << "\n";
+    }
+    os << "}\n";
+    return os;
+}
+
+void JobManager::compile() {
+    assert(!compiled);
+    assert(jobs[root].num_dependencies == 0);
+
+    // readers wait for the writer in the same frame
+    for(Resource const &resource : resources) {
+        assert(resource.writer != root && "a resource nobody writes?");
+        for(JobId reader : resource.readers) {
+            registerDependencies(reader, resource.writer);
+        }
+    }
+
+    // so every job is reached from the root within its frame
+    for(JobId id = 1; id < jobs.size(); id++) {
+        if(jobs[id].num_dependencies == 0) {
+            registerDependencies(id, root);
+        }
+    }
+
+    // the writer waits for the readers of the last frame that used its
+    // copy. That is two frames back, but the lag must stay within the
+    // frames in flight, or the counter it bumps could still be in use by
+    // an earlier frame.
+    uint32_t copy_lag = std::min(2u, frames_in_flight);
+    for(Resource const &resource : resources) {
+        for(JobId reader : resource.readers) {
+            jobs[reader].dependents.push_back({ resource.writer, copy_lag });
+            jobs[resource.writer].num_dependencies++;
+        }
+    }
+
+    // and each job waits for its own run in the frame before
+    for(Job &job : jobs) {
+        job.dependents.push_back({ (JobId) (&job - jobs.data()), 1 });
+        job.num_dependencies++;
+    }
+    // and the root for runIteration
+    jobs[root].num_dependencies++;
+    compiled = true;
+
+    dependents_begin.assign(jobs.size() + 1, 0);
+    for(JobId id = 0; id < jobs.size(); id++) {
+        dependents_begin[id + 1] = dependents_begin[id]
+            + (uint32_t) jobs[id].dependents.size();
+        dependents.insert(dependents.end(), jobs[id].dependents.begin(),
+            jobs[id].dependents.end());
+    }
+
+    counters = std::make_unique<Counter[]>(frames_in_flight * jobs.size());
+    slots = std::make_unique<Slot[]>(frames_in_flight);
+    for(unsigned s = 0; s < frames_in_flight; s++) {
+        for(JobId id = 0; id < jobs.size(); id++) {
+            counters[s * jobs.size() + id].finished.store(0,
+                std::memory_order_relaxed);
+        }
+        slots[s].remaining.store(0, std::memory_order_relaxed);
+        slots[s].completed.store(0, std::memory_order_relaxed);
+    }
+
+    // the first frames have nothing lag frames back to wait for, so count
+    // those links as finished already
+    for(Link const &link : dependents) {
+        for(uint32_t f = 0; f < link.lag; f++) {
+            counters[f * jobs.size() + link.job].finished.fetch_add(1,
+                std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Counts a finished dependency of a job, and queues the job if it was the
+ * last one
+ * @param id the job
+ * @param frame the frame the job is to run in
+ */
+void JobManager::finish(JobId id, Frame frame) {
+    unsigned slot = (unsigned) (frame % frames_in_flight);
+    uint64_t uses = frame / frames_in_flight + 1;
+    uint64_t ready = uses * jobs[id].num_dependencies;
+    // acq_rel, so the job sees what every dependency wrote
+    uint64_t finished = counters[slot * jobs.size() + id].finished.fetch_add(
+        1, std::memory_order_acq_rel) + 1;
+    assert(finished <= ready && "a counter got ahead of its frame?");
+    if(finished == ready) {
+        // queued from a pool thread, so it goes on this thread's deque
+        threads.run([this, id, frame]() { run(id, frame); });
+    }
+}
+
+/**
+ * Runs a job, then counts it as finished for its dependents
+ * @param id the job
+ * @param frame the frame it is running for
+ */
+void JobManager::run(JobId id, Frame frame) {
+    Job &job = jobs[id];
+    current_frame = frame;
+    std::invoke(job.entry, job.arg);
+
+    for(uint32_t i = dependents_begin[id]; i < dependents_begin[id + 1]; i++) {
+        finish(dependents[i].job, frame + dependents[i].lag);
+    }
+
+    Slot &slot = slots[frame % frames_in_flight];
+    if(slot.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        slot.completed.store(frame + 1, std::memory_order_release);
+        slot.completed.notify_all();
+    }
+}
+
+JobManager::Frame JobManager::runIteration() {
+    assert(compiled);
+    Frame frame = iteration++;
+    if(frame >= frames_in_flight) {
+        wait(frame - frames_in_flight);
+    }
+
+    slots[frame % frames_in_flight].remaining.store((uint32_t) jobs.size(),
+        std::memory_order_relaxed);
+    finish(root, frame);
+    return frame;
+}
+
+bool JobManager::finished(Frame frame) const {
+    assert(frame < iteration && "a frame that has not started?");
+    return slots[frame % frames_in_flight].completed.load(
+        std::memory_order_acquire) > frame;
+}
+
+void JobManager::wait(Frame frame) const {
+    assert(frame < iteration && "a frame that has not started?");
+    std::atomic<Frame> &completed
+        = slots[frame % frames_in_flight].completed;
+    Frame seen = completed.load(std::memory_order_acquire);
+    while(seen <= frame) {
+        completed.wait(seen, std::memory_order_acquire);
+        seen = completed.load(std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,147 @@
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "threading/task.h"
+
+// Tasks are allocated from a cache per thread. A task is usually freed by
+// another thread than the one that queued it, so each cache has a second,
+// lock free list the other threads return its blocks to, which the owner
+// takes in one go once its own list runs dry. Caches are never freed, since
+// blocks from them may still be queued anywhere; a thread that exits leaves
+// its cache for the next new thread to take over.
+
+struct TaskCache;
+
+struct TaskBlock {
+    union {
+        alignas(Task) std::byte task[sizeof(Task)];
+        TaskBlock *next;
+    };
+    TaskCache *owner;
+};
+
+struct TaskCache {
+    // only touched by the owning thread
+    TaskBlock *local = nullptr;
+    std::vector<std::unique_ptr<TaskBlock[]>> slabs;
+    // pushed to by any thread, emptied by the owner
+    std::atomic<TaskBlock *> remote = nullptr;
+    // the next cache with no thread, while this one has none either
+    TaskCache *next_orphan = nullptr;
+};
+
+// blocks allocated at a time when a cache runs out
+static constexpr size_t slab_blocks = 256;
+
+// a plain list, so it is still there for threads that exit after statics
+// are destroyed
+static std::mutex orphans_sync;
+static TaskCache *orphans = nullptr;
+
+/**
+ * @return a cache left behind by an exited thread, or a new one
+ */
+static TaskCache *adopt() {
+    std::lock_guard<std::mutex> lock(orphans_sync);
+    if(!orphans) {
+        return new TaskCache();
+    }
+    TaskCache *cache = orphans;
+    orphans = cache->next_orphan;
+    return cache;
+}
+
+static void abandon(TaskCache *cache) {
+    std::lock_guard<std::mutex> lock(orphans_sync);
+    cache->next_orphan = orphans;
+    orphans = cache;
+}
+
+static thread_local TaskCache *local_cache = nullptr;
+static thread_local bool exited = false;
+
+/**
+ * Leaves the thread's cache behind when the thread exits
+ */
+struct TaskCacheRelease {
+    ~TaskCacheRelease() {
+        exited = true;
+        if(local_cache) {
+            abandon(local_cache);
+            local_cache = nullptr;
+        }
+    }
+};
+static thread_local TaskCacheRelease release;
+
+static TaskCache *localCache() {
+    if(!local_cache && !exited) {
+        local_cache = adopt();
+        // constructs the thread local, so it runs at exit
+        (void) &release;
+    }
+    return local_cache;
+}
+
+static void refill(TaskCache &cache) {
+    cache.local = cache.remote.exchange(nullptr, std::memory_order_acquire);
+    if(cache.local) {
+        return;
+    }
+
+    TaskBlock *slab = new TaskBlock[slab_blocks];
+    cache.slabs.emplace_back(slab);
+    for(size_t i = 0; i < slab_blocks; i++) {
+        slab[i].owner = &cache;
+        slab[i].next = i + 1 < slab_blocks ? &slab[i + 1] : nullptr;
+    }
+    cache.local = slab;
+}
+
+static void push(TaskCache &cache, TaskBlock *block) {
+    TaskBlock *head = cache.remote.load(std::memory_order_relaxed);
+    do {
+        block->next = head;
+    } while(!cache.remote.compare_exchange_weak(head, block,
+        std::memory_order_release, std::memory_order_relaxed));
+}
+
+void *Task::operator new(size_t size) {
+    assert(size == sizeof(Task));
+    TaskCache *cache = localCache();
+    // a thread already past its thread locals borrows a cache for the one
+    bool borrowed = !cache;
+    if(borrowed) {
+        cache = adopt();
+    }
+
+    if(!cache->local) {
+        refill(*cache);
+    }
+    TaskBlock *block = cache->local;
+    cache->local = block->next;
+
+    if(borrowed) {
+        abandon(cache);
+    }
+    return block->task;
+}
+
+void Task::operator delete(void *task) {
+    if(!task) {
+        return;
+    }
+    TaskBlock *block = reinterpret_cast<TaskBlock *>(task);
+    if(block->owner == local_cache) {
+        block->next = local_cache->local;
+        local_cache->local = block;
+    }
+    else {
+        push(*block->owner, block);
+    }
+}
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <syncstream>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define THREAD_PAUSE() _mm_pause()
+#else
+#define THREAD_PAUSE() std::this_thread::yield()
+#endif
+
+#include "threading/thread.h"
+
+// how long an idle thread spins, then yields, before it parks
+static constexpr unsigned spin_rounds = 64;
+static constexpr unsigned yield_rounds = 16;
+// the most functions a thread moves from the shared queue to its deque
+static constexpr size_t max_injected_share = 32;
+// how far in the shared queue is taken from before it is moved back down
+static constexpr size_t min_injected_compact = 1024;
+
+thread_local ThreadPool *ThreadPool::local_pool = nullptr;
+thread_local ThreadPool::Worker *ThreadPool::local_worker = nullptr;
+
+ThreadPool::ThreadPool(unsigned n) :
+    num_workers(0),
+    num(0),
+    retiring(0),
+    injected_head(0),
+    num_injected(0),
+    num_sleeping(0),
+    epoch(0) {
+    add(n);
+}
+
+ThreadPool::~ThreadPool() {
+    killAll();
+    unsigned count = num_workers.load();
+    for(unsigned i = 0; i < count; i++) {
+        if(workers[i]->thread.joinable()) {
+            workers[i]->thread.join();
+        }
+    }
+
+    // anything queued after the last thread died never runs
+    Task *task;
+    for(unsigned i = 0; i < count; i++) {
+        while(workers[i]->deque.pop(task)) {
+            delete task;
+        }
+    }
+    for(size_t i = injected_head; i < injected.size(); i++) {
+        delete injected[i];
+    }
+}
+
+ThreadPool &ThreadPool::add(unsigned n) {
+    std::osyncstream(std::cerr) << "ThreadPool@" << this << " -- adding "
+        << n << " threads\n";
+    for(unsigned i = 0; i < n; i++) {
+        unsigned slot = num_workers.load();
+        assert(slot < max_workers && "too many threads added to the pool?");
+
+        workers[slot] = std::make_unique<Worker>();
+        Worker &worker = *workers[slot];
+        worker.seed = 0x9e3779b9u * (slot + 1);
+        num_workers.store(slot + 1, std::memory_order_release);
+        worker.thread = std::thread(&ThreadPool::runner, this,
+            std::ref(worker));
+    }
+    num += n;
+    return *this;
+}
+
+ThreadPool &ThreadPool::kill(unsigned n) {
+    assert(n <= num && "kill more threads than are in the pool?");
+    retiring.fetch_add(n);
+    num -= n;
+    notify(true);
+    return *this;
+}
+
+void ThreadPool::submit(Task *task) {
+    if(local_pool == this) {
+        local_worker->deque.push(task);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(injected_sync);
+        injected.push_back(task);
+        num_injected.fetch_add(1, std::memory_order_relaxed);
+    }
+    notify(false);
+}
+
+/**
+ * Wakes parked threads, if there are any, to look for work
+ * @param all whether to wake all of them rather than one
+ */
+void ThreadPool::notify(bool all) {
+    // pairs with the fence in park: either a thread about to park sees what
+    // was just queued, or this sees that thread counted as sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(num_sleeping.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(sleep_sync);
+    epoch.fetch_add(1, std::memory_order_relaxed);
+    if(all) {
+        wake.notify_all();
+    }
+    else {
+        wake.notify_one();
+    }
+}
+
+/**
+ * Looks for a function to run: first the thread's own deque, newest first,
+ * then the shared queue, then the other threads' deques from a random one
+ * on
+ * @param self the calling thread's worker
+ * @return the function, or nullptr if none was found
+ */
+Task *ThreadPool::find(Worker &self) {
+    Task *task;
+    if(self.deque.pop(task)) {
+        return task;
+    }
+
+    if(num_injected.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(injected_sync);
+        size_t left = injected.size() - injected_head;
+        if(left > 0) {
+            task = injected[injected_head++];
+            // take a share of the rest too, for the others to steal from
+            // rather than all queueing on this lock
+            size_t share = std::min<size_t>((left - 1) / 2,
+                max_injected_share);
+            for(size_t i = 0; i < share; i++) {
+                self.deque.push(injected[injected_head++]);
+            }
+            num_injected.fetch_sub(share + 1, std::memory_order_relaxed);
+
+            if(injected_head == injected.size()) {
+                injected.clear();
+                injected_head = 0;
+            }
+            else if(injected_head >= min_injected_compact
+                    && injected_head * 2 >= injected.size()) {
+                injected.erase(injected.begin(),
+                    injected.begin() + injected_head);
+                injected_head = 0;
+            }
+            return task;
+        }
+    }
+
+    unsigned count = num_workers.load(std::memory_order_acquire);
+    self.seed ^= self.seed << 13;
+    self.seed ^= self.seed >> 17;
+    self.seed ^= self.seed << 5;
+    unsigned start = self.seed % count;
+    for(unsigned i = 0; i < count; i++) {
+        Worker *victim = workers[(start + i) % count].get();
+        if(victim != &self && victim->deque.steal(task)) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @return whether any deque or the shared queue looks to have something in
+ */
+bool ThreadPool::hasWork() {
+    if(num_injected.load() > 0) {
+        return true;
+    }
+    unsigned count = num_workers.load(std::memory_order_acquire);
+    for(unsigned i = 0; i < count; i++) {
+        if(!workers[i]->deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Takes up one of the outstanding kills, if there are any
+ * @return whether the calling thread should die
+ */
+bool ThreadPool::retire() {
+    unsigned left = retiring.load();
+    while(left > 0) {
+        if(retiring.compare_exchange_weak(left, left - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Blocks until woken by notify, unless there is already something to do
+ */
+void ThreadPool::park() {
+    std::unique_lock<std::mutex> lock(sleep_sync);
+    uint64_t seen = epoch.load(std::memory_order_relaxed);
+    num_sleeping.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!hasWork() && retiring.load(std::memory_order_relaxed) == 0) {
+        wake.wait(lock, [this, seen]() {
+            return epoch.load(std::memory_order_relaxed) != seen;
+        });
+    }
+    num_sleeping.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::runner(Worker &self) {
+    local_pool = this;
+    local_worker = &self;
+
+    unsigned idle = 0;
+    while(true) {
+        Task *task = find(self);
+        if(task) {
+            std::invoke(*task);
+            delete task;
+            idle = 0;
+            continue;
+        }
+
+        // only idle threads die, so whatever was queued still runs
+        if(retire()) {
+            break;
+        }
+
+        if(idle < spin_rounds) {
+            THREAD_PAUSE();
+        }
+        else if(idle < spin_rounds + yield_rounds) {
+            std::this_thread::yield();
+        }
+        else {
+            park();
+            idle = 0;
+            continue;
+        }
+        idle++;
+    }
+
+    local_pool = nullptr;
+    local_worker = nullptr;
+}
@@ -0,0 +1,92 @@
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "utils/asset_stamp.h"
+#include "utils/file_source.h"
+
+/**
+ * Gets the size and modification time of a file
+ * @param path the path to the file
+ * @param size the destination for the size
+ * @param mtime the destination for the modification time
+ * @return whether or not the file exists
+ */
+static bool statFile(std::string const &path, uint64_t &size,
+        int64_t &mtime) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if(ec) {
+        return false;
+    }
+
+    auto time = std::filesystem::last_write_time(path, ec);
+    if(ec) {
+        return false;
+    }
+    mtime = time.time_since_epoch().count();
+
+    return true;
+}
+
+/**
+ * Hashes the contents of a file with 64 bit FNV-1a
+ * @param path the path to the file
+ * @param hash the destination for the hash
+ * @return whether or not the file could be read
+ */
+static bool hashFile(std::string const &path, uint64_t &hash) {
+    FileSource source;
+    if(!source.open(path)) {
+        return false;
+    }
+
+    hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](std::string_view bytes) {
+        for(unsigned char c : bytes) {
+            hash = (hash ^ c) * 0x100000001b3ull;
+        }
+    };
+
+    if(source.isMapped()) {
+        mix(source.data());
+    }
+    else {
+        // newlines are part of the contents too
+        for(std::string_view line : source.lines()) {
+            mix(line);
+            mix("\n");
+        }
+    }
+
+    return true;
+}
+
+bool AssetStamp::create(std::string const &path) {
+    return statFile(path, size, mtime) && hashFile(path, hash);
+}
+
+bool AssetStamp::matches(std::string const &path, bool &touched) {
+    touched = false;
+
+    uint64_t current_size;
+    int64_t current_mtime;
+    if(!statFile(path, current_size, current_mtime)
+            || current_size != size) {
+        return false;
+    }
+
+    if(current_mtime == mtime) {
+        return true;
+    }
+
+    uint64_t current_hash;
+    if(!hashFile(path, current_hash) || current_hash != hash) {
+        return false;
+    }
+
+    mtime = current_mtime;
+    touched = true;
+    return true;
+}
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "graphics/texture.h"
+
+#include "utils/block_compress.h"
+#include "utils/image.h"
+
+namespace block_compress {
+
+/**
+ * Copies out the 4x4 block at (bx, by), repeating the edge texels of images
+ * that do not fill it
+ */
+static void fetchBlock(Image const &src, int bx, int by, float block[16][4]) {
+    for(int y = 0; y < 4; y++) {
+        int sy = std::min(by * 4 + y, src.height - 1);
+        for(int x = 0; x < 4; x++) {
+            int sx = std::min(bx * 4 + x, src.width - 1);
+            unsigned char const *p
+                = &src.pixels[((size_t) sy * src.width + sx) * 4];
+            for(int c = 0; c < 4; c++) {
+                block[y * 4 + x][c] = p[c];
+            }
+        }
+    }
+}
+
+/**
+ * Finds the line through a block's texels that best fits them, which the
+ * endpoints are then placed along
+ * @param block the texels
+ * @param channels the number of channels to fit, 3 or 4
+ * @param mean the destination for the centre of the texels
+ * @param axis the destination for the unit direction of the line
+ */
+static void principalAxis(float const block[16][4], int channels,
+        float mean[4], float axis[4]) {
+    for(int c = 0; c < 4; c++) {
+        mean[c] = 0.0f;
+        for(int i = 0; i < 16; i++) {
+            mean[c] += block[i][c];
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float cov[4][4] = {};
+    for(int i = 0; i < 16; i++) {
+        for(int a = 0; a < channels; a++) {
+            for(int b = 0; b < channels; b++) {
+                cov[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+            }
+        }
+    }
+
+    // power iteration converges on the dominant eigenvector quickly enough
+    float v[4] = { 1.0f, 1.0f, 1.0f, channels == 4 ? 1.0f : 0.0f };
+    for(int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float len = 0.0f;
+        for(int a = 0; a < channels; a++) {
+            for(int b = 0; b < channels; b++) {
+                next[a] += cov[a][b] * v[b];
+            }
+            len = std::max(len, std::abs(next[a]));
+        }
+        if(len == 0.0f) {
+            break;
+        }
+        for(int a = 0; a < 4; a++) {
+            v[a] = next[a] / len;
+        }
+    }
+
+    float len = 0.0f;
+    for(int a = 0; a < channels; a++) {
+        len += v[a] * v[a];
+    }
+    len = std::sqrt(len);
+    for(int a = 0; a < 4; a++) {
+        axis[a] = (a < channels && len > 0.0f) ? v[a] / len : 0.0f;
+    }
+}
+
+/**
+ * Places a pair of endpoints at the extremes of the texels along the
+ * principal axis
+ */
+static void fitEndpoints(float const block[16][4], int channels,
+        float e0[4], float e1[4]) {
+    float mean[4];
+    float axis[4];
+    principalAxis(block, channels, mean, axis);
+
+    float lo = 0.0f;
+    float hi = 0.0f;
+    for(int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for(int c = 0; c < channels; c++) {
+            t += (block[i][c] - mean[c]) * axis[c];
+        }
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+
+    for(int c = 0; c < 4; c++) {
+        e0[c] = std::clamp(mean[c] + axis[c] * hi, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * lo, 0.0f, 255.0f);
+    }
+}
+
+/**
+ * Moves a pair of endpoints to the least squares fit of the texels, given
+ * which palette entry each texel was assigned
+ * @param weights how far along from e0 to e1 each texel's entry is
+ */
+static void refineEndpoints(float const block[16][4], int channels,
+        float const weights[16], float e0[4], float e1[4]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for(int i = 0; i < 16; i++) {
+        float b = weights[i];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(int c = 0; c < channels; c++) {
+            ax[c] += a * block[i][c];
+            bx[c] += b * block[i][c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if(std::abs(det) < 1e-6f) {
+        return;
+    }
+
+    for(int c = 0; c < channels; c++) {
+        e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+        e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+    }
+}
+
+// bc1 ------------------------------
+
+static uint16_t packColour(float const c[4]) {
+    int r = (int) std::lround(c[0] * 31.0f / 255.0f);
+    int g = (int) std::lround(c[1] * 63.0f / 255.0f);
+    int b = (int) std::lround(c[2] * 31.0f / 255.0f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void unpackColour(uint16_t packed, float c[3]) {
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    c[0] = (float) ((r << 3) | (r >> 2));
+    c[1] = (float) ((g << 2) | (g >> 4));
+    c[2] = (float) ((b << 3) | (b >> 2));
+}
+
+/**
+ * Assigns each texel the nearest colour of the 4 colour palette
+ * @return the total squared error
+ */
+static float assignColours(float const block[16][4], uint16_t c0, uint16_t c1,
+        unsigned char indices[16]) {
+    float palette[4][3];
+    unpackColour(c0, palette[0]);
+    unpackColour(c1, palette[1]);
+    for(int c = 0; c < 3; c++) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    float total = 0.0f;
+    for(int i = 0; i < 16; i++) {
+        float best = INFINITY;
+        for(int p = 0; p < 4; p++) {
+            float err = 0.0f;
+            for(int c = 0; c < 3; c++) {
+                float d = block[i][c] - palette[p][c];
+                err += d * d;
+            }
+            if(err < best) {
+                best = err;
+                indices[i] = p;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+static void encodeColourBlock(float const block[16][4], unsigned char *out) {
+    static constexpr float weights_of[4] = { 0.0f, 1.0f, 1.0f / 3.0f,
+        2.0f / 3.0f };
+
+    float e0[4], e1[4];
+    fitEndpoints(block, 3, e0, e1);
+
+    uint16_t c0 = packColour(e0);
+    uint16_t c1 = packColour(e1);
+    unsigned char indices[16];
+    float error = assignColours(block, c0, c1, indices);
+
+    // one least squares pass usually tightens the endpoints
+    float weights[16];
+    for(int i = 0; i < 16; i++) {
+        weights[i] = weights_of[indices[i]];
+    }
+    refineEndpoints(block, 3, weights, e0, e1);
+
+    uint16_t r0 = packColour(e0);
+    uint16_t r1 = packColour(e1);
+    unsigned char refined[16];
+    if(assignColours(block, r0, r1, refined) < error) {
+        c0 = r0;
+        c1 = r1;
+        std::memcpy(indices, refined, sizeof(indices));
+    }
+
+    // the first endpoint must be the larger to select 4 colour mode
+    if(c0 < c1) {
+        std::swap(c0, c1);
+        for(int i = 0; i < 16; i++) {
+            indices[i] ^= 1;
+        }
+    }
+    else if(c0 == c1) {
+        std::memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for(int i = 0; i < 16; i++) {
+        bits |= (uint32_t) indices[i] << (i * 2);
+    }
+
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for(int i = 0; i < 4; i++) {
+        out[4 + i] = (bits >> (i * 8)) & 0xff;
+    }
+}
+
+// bc3 ------------------------------
+
+static void encodeAlphaBlock(float const block[16][4], unsigned char *out) {
+    int a0 = 0;
+    int a1 = 255;
+    for(int i = 0; i < 16; i++) {
+        a0 = std::max(a0, (int) block[i][3]);
+        a1 = std::min(a1, (int) block[i][3]);
+    }
+
+    // a0 > a1 selects the 8 value palette, evenly spaced between them
+    uint64_t bits = 0;
+    if(a0 > a1) {
+        float palette[8] = { (float) a0, (float) a1 };
+        for(int k = 2; k < 8; k++) {
+            palette[k] = ((8 - k) * a0 + (k - 1) * a1) / 7.0f;
+        }
+
+        for(int i = 0; i < 16; i++) {
+            int best = 0;
+            float best_err = INFINITY;
+            for(int k = 0; k < 8; k++) {
+                float err = std::abs(block[i][3] - palette[k]);
+                if(err < best_err) {
+                    best_err = err;
+                    best = k;
+                }
+            }
+            bits |= (uint64_t) best << (i * 3);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for(int i = 0; i < 6; i++) {
+        out[2 + i] = (bits >> (i * 8)) & 0xff;
+    }
+}
+
+// bc7 ------------------------------
+
+static constexpr int bc7_weights[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+
+/**
+ * A mode 6 endpoint, 7 bits per channel plus a shared low bit
+ */
+struct Bc7Endpoint {
+    int channels[4];
+    int pbit;
+
+    int value(int c) const { return (channels[c] << 1) | pbit; }
+};
+
+static Bc7Endpoint quantizeBc7(float const e[4]) {
+    Bc7Endpoint best = {};
+    float best_err = INFINITY;
+    for(int p = 0; p < 2; p++) {
+        Bc7Endpoint q = {};
+        q.pbit = p;
+        float err = 0.0f;
+        for(int c = 0; c < 4; c++) {
+            q.channels[c] = std::clamp((int) std::lround((e[c] - p) / 2.0f),
+                    0, 127);
+            float d = e[c] - q.value(c);
+            err += d * d;
+        }
+        if(err < best_err) {
+            best_err = err;
+            best = q;
+        }
+    }
+    return best;
+}
+
+/**
+ * Assigns each texel the nearest entry of the 16 entry palette
+ * @return the total squared error
+ */
+static float assignBc7(float const block[16][4], Bc7Endpoint const &e0,
+        Bc7Endpoint const &e1, unsigned char indices[16]) {
+    float palette[16][4];
+    for(int k = 0; k < 16; k++) {
+        int w = bc7_weights[k];
+        for(int c = 0; c < 4; c++) {
+            palette[k][c] = (float) (((64 - w) * e0.value(c)
+                        + w * e1.value(c) + 32) >> 6);
+        }
+    }
+
+    float total = 0.0f;
+    for(int i = 0; i < 16; i++) {
+        float best = INFINITY;
+        for(int k = 0; k < 16; k++) {
+            float err = 0.0f;
+            for(int c = 0; c < 4; c++) {
+                float d = block[i][c] - palette[k][c];
+                err += d * d;
+            }
+            if(err < best) {
+                best = err;
+                indices[i] = k;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+/**
+ * Writes bits into a block from the least significant bit up
+ */
+struct BitWriter {
+    unsigned char *out;
+    int pos;
+
+    void put(uint32_t value, int bits) {
+        for(int i = 0; i < bits; i++, pos++) {
+            if((value >> i) & 1) {
+                out[pos / 8] |= 1 << (pos % 8);
+            }
+        }
+    }
+};
+
+static void encodeBc7Block(float const block[16][4], unsigned char *out) {
+    float e0[4], e1[4];
+    fitEndpoints(block, 4, e0, e1);
+
+    Bc7Endpoint q0 = quantizeBc7(e0);
+    Bc7Endpoint q1 = quantizeBc7(e1);
+    unsigned char indices[16];
+    float error = assignBc7(block, q0, q1, indices);
+
+    for(int pass = 0; pass < 2; pass++) {
+        float weights[16];
+        for(int i = 0; i < 16; i++) {
+            weights[i] = bc7_weights[indices[i]] / 64.0f;
+        }
+        refineEndpoints(block, 4, weights, e0, e1);
+
+        Bc7Endpoint r0 = quantizeBc7(e0);
+        Bc7Endpoint r1 = quantizeBc7(e1);
+        unsigned char refined[16];
+        float refined_error = assignBc7(block, r0, r1, refined);
+        if(refined_error >= error) {
+            break;
+        }
+        q0 = r0;
+        q1 = r1;
+        error = refined_error;
+        std::memcpy(indices, refined, sizeof(indices));
+    }
+
+    // the first index is stored without its top bit, so it must be below 8
+    if(indices[0] >= 8) {
+        std::swap(q0, q1);
+        for(int i = 0; i < 16; i++) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer = { out, 0 };
+    writer.put(1 << 6, 7);
+    for(int c = 0; c < 4; c++) {
+        writer.put(q0.channels[c], 7);
+        writer.put(q1.channels[c], 7);
+    }
+    writer.put(q0.pbit, 1);
+    writer.put(q1.pbit, 1);
+    writer.put(indices[0], 3);
+    for(int i = 1; i < 16; i++) {
+        writer.put(indices[i], 4);
+    }
+}
+
+size_t levelSize(TextureFormat format, int width, int height) {
+    size_t blocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+    switch(format) {
+    case TextureFormat::bc1:
+        return blocks * 8;
+    case TextureFormat::bc3:
+    case TextureFormat::bc7:
+        return blocks * 16;
+    default:
+        return (size_t) width * height * 4;
+    }
+}
+
+bool hasAlpha(Image const &image) {
+    for(size_t i = 3; i < image.pixels.size(); i += 4) {
+        if(image.pixels[i] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void encode(Image const &src, TextureFormat format, Image &dest) {
+    dest.width = src.width;
+    dest.height = src.height;
+    dest.pixels.assign(levelSize(format, src.width, src.height), 0);
+
+    int blocks_x = (src.width + 3) / 4;
+    int blocks_y = (src.height + 3) / 4;
+    size_t block_size = format == TextureFormat::bc1 ? 8 : 16;
+
+    unsigned char *out = dest.pixels.data();
+    for(int by = 0; by < blocks_y; by++) {
+        for(int bx = 0; bx < blocks_x; bx++) {
+            float block[16][4];
+            fetchBlock(src, bx, by, block);
+
+            switch(format) {
+            case TextureFormat::bc1:
+                encodeColourBlock(block, out);
+                break;
+            case TextureFormat::bc3:
+                encodeAlphaBlock(block, out);
+                encodeColourBlock(block, out + 8);
+                break;
+            case TextureFormat::bc7:
+                encodeBc7Block(block, out);
+                break;
+            default:
+                break;
+            }
+            out += block_size;
+        }
+    }
+}
+
+};
@@ -0,0 +1,246 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/file_source.h"
+
+FileSource::FileSource() :
+    file_size(0),
+    mapped(false),
+    mapping(nullptr),
+#ifdef _WIN32
+    file_handle(INVALID_HANDLE_VALUE),
+    mapping_handle(nullptr),
+#else
+    fd(-1),
+#endif
+    stream(nullptr),
+    buffer(nullptr),
+    buffer_capacity(0),
+    cur(nullptr),
+    end(nullptr) { }
+
+FileSource::~FileSource() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool FileSource::mapFile(std::string const &path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            0);
+
+    if(file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle = file;
+    file_size = size.QuadPart;
+
+    // empty files cannot be mapped, but there is nothing to map anyways
+    if(file_size == 0) {
+        mapped = true;
+        return true;
+    }
+
+    mapping_handle = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if(!mapping_handle) {
+        close();
+        return false;
+    }
+
+    mapping = (char const *) MapViewOfFile(mapping_handle, FILE_MAP_READ, 0,
+            0, 0);
+    if(!mapping) {
+        close();
+        return false;
+    }
+
+    mapped = true;
+    return true;
+}
+
+#else
+
+bool FileSource::mapFile(std::string const &path) {
+    fd = ::open(path.c_str(), O_RDONLY);
+
+    if(fd < 0) {
+        return false;
+    }
+
+    // pipes and devices cannot be mapped, so those get streamed instead
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close();
+        return false;
+    }
+
+    file_size = st.st_size;
+
+    // empty files cannot be mapped, but there is nothing to map anyways
+    if(file_size == 0) {
+        mapped = true;
+        return true;
+    }
+
+    void *view = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(view == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    // the parsers only ever walk forwards
+    madvise(view, file_size, MADV_SEQUENTIAL);
+
+    mapping = (char const *) view;
+    mapped = true;
+    return true;
+}
+
+#endif
+
+bool FileSource::open(std::string const &path) {
+    close();
+
+    if(mapFile(path)) {
+        cur = mapping;
+        end = mapping + file_size;
+        return true;
+    }
+
+    // mapping failed, fall back to streaming the file in chunks
+    stream = std::fopen(path.c_str(), "rb");
+    if(!stream) {
+        return false;
+    }
+
+    std::error_code ec;
+    file_size = std::filesystem::file_size(path, ec);
+    if(ec) {
+        file_size = 0;
+    }
+
+    buffer = (char *) ::operator new(chunk_size, std::align_val_t(chunk_align));
+    buffer_capacity = chunk_size;
+    cur = buffer;
+    end = buffer;
+
+    return true;
+}
+
+void FileSource::close() {
+#ifdef _WIN32
+    if(mapping) {
+        UnmapViewOfFile(mapping);
+    }
+    if(mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if(file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle);
+    }
+    file_handle = INVALID_HANDLE_VALUE;
+    mapping_handle = nullptr;
+#else
+    if(mapping) {
+        munmap((void *) mapping, file_size);
+    }
+    if(fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+#endif
+
+    if(stream) {
+        std::fclose(stream);
+    }
+    if(buffer) {
+        ::operator delete(buffer, std::align_val_t(chunk_align));
+    }
+
+    file_size = 0;
+    mapped = false;
+    mapping = nullptr;
+    stream = nullptr;
+    buffer = nullptr;
+    buffer_capacity = 0;
+    cur = nullptr;
+    end = nullptr;
+}
+
+bool FileSource::refill() {
+    if(!stream) {
+        return false;
+    }
+
+    size_t leftover = end - cur;
+
+    // a single line fills the whole buffer, so make room for more of it
+    if(leftover == buffer_capacity) {
+        size_t capacity = buffer_capacity * 2;
+        char *grown = (char *) ::operator new(capacity,
+                std::align_val_t(chunk_align));
+        std::memcpy(grown, cur, leftover);
+        ::operator delete(buffer, std::align_val_t(chunk_align));
+        buffer = grown;
+        buffer_capacity = capacity;
+    }
+
+    // otherwise keep the partial line and read in behind it
+    else if(leftover > 0) {
+        std::memmove(buffer, cur, leftover);
+    }
+
+    cur = buffer;
+    end = buffer + leftover;
+
+    size_t read = std::fread(buffer + leftover, 1, buffer_capacity - leftover,
+            stream);
+    end += read;
+
+    return read > 0;
+}
+
+bool FileSource::nextLine(std::string_view &line) {
+    while(true) {
+        if(cur < end) {
+            char const *eol = (char const *) std::memchr(cur, '\n', end - cur);
+            if(eol) {
+                line = std::string_view(cur, eol - cur);
+                cur = eol + 1;
+                return true;
+            }
+        }
+
+        if(mapped || !refill()) {
+            // the last line may not have a trailing newline
+            if(cur < end) {
+                line = std::string_view(cur, end - cur);
+                cur = end;
+                return true;
+            }
+
+            return false;
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#include <string>
+#include <vector>
+
+#include <stb/stb_image.h>
+
+#include "utils/image.h"
+
+bool Image::create(std::string const &path) {
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, 0, 4);
+
+    if(!data) {
+        return false;
+    }
+
+    pixels.assign(data, data + (size_t) width * height * 4);
+    stbi_image_free(data);
+
+    return true;
+}
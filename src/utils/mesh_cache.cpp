@@ -0,0 +1,376 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "graphics/material.h"
+#include "graphics/mesh.h"
+#include "graphics/vertex.h"
+
+#include "utils/asset_stamp.h"
+#include "utils/file_source.h"
+#include "utils/mesh_cache.h"
+#include "utils/obj_loader.h"
+
+namespace mesh_cache {
+
+static constexpr char magic[4] = { 'L', 'G', 'M', 'C' };
+static constexpr uint32_t version = 3;
+
+/**
+ * The start of every cache file. Everything is stored in native byte order
+ * and layout, a cache is only meant to be read on the machine that wrote it.
+ */
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_size;
+    uint32_t num_materials;
+
+    // the source file the cache was built from
+    AssetStamp source;
+    // the material libraries it names, each a stamp and then a path, listed
+    // between the header and the vertices
+    uint64_t num_libraries;
+
+    uint64_t num_vertices;
+    uint64_t num_indices;
+    uint64_t num_lods;
+    float bounds_min[3];
+    float bounds_max[3];
+
+    // byte offsets from the start of the file
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t lod_offset;
+    uint64_t material_offset;
+};
+
+static void writeString(std::FILE *file, std::string const &str) {
+    uint32_t length = str.size();
+    std::fwrite(&length, sizeof(length), 1, file);
+    std::fwrite(str.data(), 1, length, file);
+}
+
+static bool readString(char const *&cur, char const *end, std::string &str) {
+    uint32_t length;
+    if(end - cur < (ptrdiff_t) sizeof(length)) {
+        return false;
+    }
+    std::memcpy(&length, cur, sizeof(length));
+    cur += sizeof(length);
+
+    if(end - cur < (ptrdiff_t) length) {
+        return false;
+    }
+    str.assign(cur, length);
+    cur += length;
+
+    return true;
+}
+
+/**
+ * Checks that a header was written by this version of the engine
+ * @param header the header to check
+ * @return whether or not the rest of the file can be read
+ */
+static bool validHeader(Header const &header) {
+    return std::memcmp(header.magic, magic, sizeof(magic)) == 0
+        && header.version == version
+        && header.vertex_size == sizeof(Vertex);
+}
+
+/**
+ * A stamp in a cache that has to be written back, since its source was
+ * touched
+ */
+struct TouchedStamp {
+    uint64_t offset;
+    AssetStamp stamp;
+};
+
+/**
+ * Checks the material libraries listed after a header against their stamps.
+ * A library that was missing when the cache was built has an all zero
+ * stamp, and only matches while it is still missing.
+ * @param header the header
+ * @param list the bytes between the header and the vertices
+ * @param touched the destination for the stamps to write back
+ * @return whether or not every library is unchanged
+ */
+static bool librariesMatch(Header const &header, std::string_view list,
+        std::vector<TouchedStamp> &touched) {
+    char const *cur = list.data();
+    char const *end = list.data() + list.size();
+    for(uint64_t i = 0; i < header.num_libraries; i++) {
+        AssetStamp stamp;
+        std::string path;
+        if(end - cur < (ptrdiff_t) sizeof(stamp)) {
+            return false;
+        }
+        std::memcpy(&stamp, cur, sizeof(stamp));
+        uint64_t offset = sizeof(Header) + (cur - list.data());
+        cur += sizeof(stamp);
+        if(!readString(cur, end, path)) {
+            return false;
+        }
+
+        if(stamp.size == 0 && stamp.mtime == 0 && stamp.hash == 0) {
+            std::error_code ec;
+            if(std::filesystem::exists(path, ec) || ec) {
+                return false;
+            }
+            continue;
+        }
+
+        bool was_touched;
+        if(!stamp.matches(path, was_touched)) {
+            return false;
+        }
+        if(was_touched) {
+            touched.push_back({ offset, stamp });
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Writes a header and touched library stamps back over an existing cache
+ * @param path the path to the cache
+ * @param header the header to write
+ * @param touched the library stamps to write
+ */
+static void rewriteStamps(std::string const &path, Header const &header,
+        std::vector<TouchedStamp> const &touched) {
+    std::FILE *file = std::fopen(path.c_str(), "r+b");
+    if(file) {
+        std::fwrite(&header, sizeof(header), 1, file);
+        for(TouchedStamp const &t : touched) {
+            std::fseek(file, (long) t.offset, SEEK_SET);
+            std::fwrite(&t.stamp, sizeof(t.stamp), 1, file);
+        }
+        std::fclose(file);
+    }
+}
+
+std::string cachePath(std::string const &source_path) {
+    return source_path + ".meshcache";
+}
+
+bool isFresh(std::string const &source_path) {
+    std::string path = cachePath(source_path);
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if(!file) {
+        return false;
+    }
+
+    std::error_code ec;
+    uint64_t file_size = std::filesystem::file_size(path, ec);
+    Header header;
+    bool read = !ec && std::fread(&header, sizeof(header), 1, file) == 1
+        && validHeader(header)
+        && header.vertex_offset >= sizeof(header)
+        && header.vertex_offset <= file_size;
+
+    // the library list sits between the header and the vertices
+    std::string list;
+    if(read) {
+        list.resize(header.vertex_offset - sizeof(header));
+        read = std::fread(list.data(), 1, list.size(), file) == list.size();
+    }
+    std::fclose(file);
+
+    bool touched;
+    std::vector<TouchedStamp> touched_libraries;
+    if(!read || !header.source.matches(source_path, touched)
+            || !librariesMatch(header, list, touched_libraries)) {
+        return false;
+    }
+
+    if(touched || !touched_libraries.empty()) {
+        rewriteStamps(path, header, touched_libraries);
+    }
+
+    return true;
+}
+
+bool load(std::vector<Mesh> &meshes, std::string const &source_path) {
+    std::string path = cachePath(source_path);
+    FileSource source;
+    if(!source.open(path) || !source.isMapped()) {
+        return false;
+    }
+
+    std::string_view file = source.data();
+    if(file.size() < sizeof(Header)) {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(!validHeader(header)) {
+        return false;
+    }
+
+    // make sure a truncated or corrupt cache cannot read out of bounds
+    if(header.vertex_offset < sizeof(header)
+            || header.vertex_offset > file.size()
+            || header.num_vertices
+                > (file.size() - header.vertex_offset) / sizeof(Vertex)
+            || header.index_offset > file.size()
+            || header.num_indices
+                > (file.size() - header.index_offset) / sizeof(unsigned int)
+            || header.lod_offset > file.size()
+            || header.num_lods
+                > (file.size() - header.lod_offset) / sizeof(MeshLod)
+            || header.material_offset > file.size()) {
+        std::fprintf(stderr, "Mesh cache %s is corrupt\n", path.c_str());
+        return false;
+    }
+
+    // a touched but unchanged source only costs a hash, not a reparse
+    bool touched;
+    std::vector<TouchedStamp> touched_libraries;
+    if(!header.source.matches(source_path, touched)
+            || !librariesMatch(header, file.substr(sizeof(header),
+                    header.vertex_offset - sizeof(header)),
+                touched_libraries)) {
+        return false;
+    }
+
+    std::vector<MeshLod> lods(header.num_lods);
+    std::memcpy(lods.data(), file.data() + header.lod_offset,
+            header.num_lods * sizeof(MeshLod));
+    for(MeshLod const &lod : lods) {
+        if(lod.first_index > header.num_indices
+                || lod.num_indices > header.num_indices - lod.first_index) {
+            std::fprintf(stderr, "Mesh cache %s is corrupt\n", path.c_str());
+            return false;
+        }
+    }
+
+    char const *cur = file.data() + header.material_offset;
+    char const *end = file.data() + file.size();
+    std::vector<Material> materials(header.num_materials);
+    for(Material &material : materials) {
+        if(!readString(cur, end, material.name)
+                || !readString(cur, end, material.diffuse_map)) {
+            std::fprintf(stderr, "Mesh cache %s is corrupt\n", path.c_str());
+            return false;
+        }
+    }
+    obj_loader::loadTextures(materials);
+
+    // upload straight out of the mapping
+    Mesh m;
+    m.create((Vertex const *) (file.data() + header.vertex_offset),
+            header.num_vertices,
+            (unsigned int const *) (file.data() + header.index_offset),
+            header.num_indices, std::move(materials));
+    m.setBounds(glm::vec3(header.bounds_min[0], header.bounds_min[1],
+                header.bounds_min[2]),
+            glm::vec3(header.bounds_max[0], header.bounds_max[1],
+                header.bounds_max[2]));
+    m.setLods(std::move(lods));
+    meshes.push_back(std::move(m));
+
+    // record the new modification time so the next load skips the hash
+    source.close();
+    if(touched || !touched_libraries.empty()) {
+        rewriteStamps(path, header, touched_libraries);
+    }
+
+    return true;
+}
+
+bool save(MeshData const &data, std::string const &source_path) {
+    Header header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.vertex_size = sizeof(Vertex);
+    header.num_materials = data.materials.size();
+
+    if(!header.source.create(source_path)) {
+        return false;
+    }
+
+    // a library that could not be stamped was missing, which the zero stamp
+    // records
+    std::vector<AssetStamp> library_stamps(data.material_libraries.size());
+    uint64_t library_bytes = 0;
+    for(size_t i = 0; i < data.material_libraries.size(); i++) {
+        if(!library_stamps[i].create(data.material_libraries[i])) {
+            library_stamps[i] = {};
+        }
+        library_bytes += sizeof(AssetStamp) + sizeof(uint32_t)
+            + data.material_libraries[i].size();
+    }
+    header.num_libraries = data.material_libraries.size();
+
+    header.num_vertices = data.vertices.size();
+    header.num_indices = data.indices.size();
+    header.num_lods = data.lods.size();
+    for(int i = 0; i < 3; i++) {
+        header.bounds_min[i] = data.bounds_min[i];
+        header.bounds_max[i] = data.bounds_max[i];
+    }
+
+    // keep the vertex data 16 byte aligned within the file
+    header.vertex_offset = (sizeof(Header) + library_bytes + 15)
+        & ~(uint64_t) 15;
+    header.index_offset = header.vertex_offset
+        + header.num_vertices * sizeof(Vertex);
+    header.lod_offset = header.index_offset
+        + header.num_indices * sizeof(unsigned int);
+    header.material_offset = header.lod_offset
+        + header.num_lods * sizeof(MeshLod);
+
+    // write to the side and swap it in, so a crash never leaves a torn cache
+    std::string path = cachePath(source_path);
+    std::string temp_path = path + ".tmp";
+    std::FILE *file = std::fopen(temp_path.c_str(), "wb");
+    if(!file) {
+        std::fprintf(stderr, "Failed to write mesh cache %s\n", path.c_str());
+        return false;
+    }
+
+    static char const padding[16] = {};
+    std::fwrite(&header, sizeof(header), 1, file);
+    for(size_t i = 0; i < data.material_libraries.size(); i++) {
+        std::fwrite(&library_stamps[i], sizeof(AssetStamp), 1, file);
+        writeString(file, data.material_libraries[i]);
+    }
+    std::fwrite(padding, 1,
+            header.vertex_offset - sizeof(header) - library_bytes, file);
+    std::fwrite(data.vertices.data(), sizeof(Vertex), data.vertices.size(),
+            file);
+    std::fwrite(data.indices.data(), sizeof(unsigned int),
+            data.indices.size(), file);
+    std::fwrite(data.lods.data(), sizeof(MeshLod), data.lods.size(), file);
+    for(Material const &material : data.materials) {
+        writeString(file, material.name);
+        writeString(file, material.diffuse_map);
+    }
+
+    bool ok = !std::ferror(file);
+    ok = (std::fclose(file) == 0) && ok;
+
+    std::error_code ec;
+    if(ok) {
+        std::filesystem::rename(temp_path, path, ec);
+    }
+    if(!ok || ec) {
+        std::fprintf(stderr, "Failed to write mesh cache %s\n", path.c_str());
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+};
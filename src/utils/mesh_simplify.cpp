@@ -0,0 +1,492 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include "graphics/mesh.h"
+#include "graphics/vertex.h"
+
+#include "utils/mesh_simplify.h"
+
+namespace mesh_simplify {
+
+// how much more an outline plane weighs than a face plane of the same area
+static constexpr double BOUNDARY_WEIGHT = 10.0;
+// the smallest cosine between a face's normal before and after a collapse
+static constexpr float MIN_NORMAL_COS = 0.2f;
+// a level of detail is only kept if it has at most this share of the
+// triangles of the one before
+static constexpr float MIN_REDUCTION = 0.8f;
+
+/**
+ * The sum of squared distances to a set of planes, as the symmetric matrix
+ * (a2 ab ac ad b2 bc bd c2 cd d2), weighted by the area the planes cover
+ */
+struct Quadric {
+    double m[10] = {};
+    double weight = 0.0;
+
+    void addPlane(glm::dvec3 const &n, double d, double w) {
+        m[0] += w * n.x * n.x; m[1] += w * n.x * n.y; m[2] += w * n.x * n.z;
+        m[3] += w * n.x * d;   m[4] += w * n.y * n.y; m[5] += w * n.y * n.z;
+        m[6] += w * n.y * d;   m[7] += w * n.z * n.z; m[8] += w * n.z * d;
+        m[9] += w * d * d;
+        weight += w;
+    }
+
+    void add(Quadric const &q) {
+        for(int i = 0; i < 10; i++) {
+            m[i] += q.m[i];
+        }
+        weight += q.weight;
+    }
+
+    /**
+     * @return the mean squared distance from a point to the planes
+     */
+    double error(glm::dvec3 const &p) const {
+        double e = m[0] * p.x * p.x + 2 * m[1] * p.x * p.y
+            + 2 * m[2] * p.x * p.z + 2 * m[3] * p.x
+            + m[4] * p.y * p.y + 2 * m[5] * p.y * p.z + 2 * m[6] * p.y
+            + m[7] * p.z * p.z + 2 * m[8] * p.z + m[9];
+        return weight > 0.0 ? std::max(0.0, e) / weight : 0.0;
+    }
+};
+
+struct Candidate {
+    double cost;
+    // the corner that moves, and where to
+    unsigned int from;
+    unsigned int to;
+    // the versions of both when the cost was found
+    unsigned int from_version;
+    unsigned int to_version;
+
+    bool operator>(Candidate const &other) const {
+        return cost > other.cost;
+    }
+};
+
+/**
+ * The state of one simplification. Corners are vertices welded by
+ * position, triangles refer to vertices and so to corners through them.
+ * Running it again with a lower target carries on from where it stopped,
+ * since the quadrics remember the planes of the full mesh.
+ */
+class Simplifier {
+public:
+
+    Simplifier(std::vector<Vertex> const &vertices,
+            std::vector<unsigned int> const &indices);
+
+    float run(size_t target_indices, std::vector<unsigned int> &out);
+
+private:
+
+    std::vector<Vertex> const &vertices;
+
+    // the corner of each vertex, and the vertices and position of each corner
+    std::vector<unsigned int> vertex_corners;
+    std::vector<std::vector<unsigned int>> corner_vertices;
+    std::vector<glm::vec3> positions;
+
+    std::vector<std::array<unsigned int, 3>> triangles;
+    std::vector<uint8_t> dead;
+    size_t num_alive;
+
+    // the triangles around each corner, dead ones dropped lazily
+    std::vector<std::vector<unsigned int>> corner_triangles;
+    std::vector<Quadric> quadrics;
+    std::vector<unsigned int> versions;
+    std::vector<uint8_t> removed;
+    double max_error;
+
+    std::priority_queue<Candidate, std::vector<Candidate>,
+        std::greater<Candidate>> heap;
+
+    // scratch
+    std::vector<unsigned int> neighbours_a;
+    std::vector<unsigned int> neighbours_b;
+
+    unsigned int corner(unsigned int triangle, int i) const {
+        return vertex_corners[triangles[triangle][i]];
+    }
+
+    void weld();
+    void addOutlines();
+    void neighbours(unsigned int c, std::vector<unsigned int> &out);
+    void push(unsigned int a, unsigned int b);
+    bool valid(unsigned int from, unsigned int to);
+    void collapse(unsigned int from, unsigned int to);
+    unsigned int closestVertex(unsigned int vertex, unsigned int to) const;
+};
+
+Simplifier::Simplifier(std::vector<Vertex> const &vertices,
+        std::vector<unsigned int> const &indices) :
+    vertices(vertices),
+    num_alive(0),
+    max_error(0.0) {
+
+    weld();
+
+    size_t num_triangles = indices.size() / 3;
+    triangles.resize(num_triangles);
+    dead.assign(num_triangles, 0);
+    corner_triangles.resize(positions.size());
+    quadrics.resize(positions.size());
+    versions.assign(positions.size(), 0);
+    removed.assign(positions.size(), 0);
+
+    for(size_t t = 0; t < num_triangles; t++) {
+        for(int i = 0; i < 3; i++) {
+            triangles[t][i] = indices[t * 3 + i];
+        }
+
+        unsigned int a = corner(t, 0), b = corner(t, 1), c = corner(t, 2);
+        if(a == b || b == c || c == a) {
+            dead[t] = 1;
+            continue;
+        }
+        num_alive++;
+
+        // each face's plane goes to its corners, weighted by its area
+        glm::dvec3 pa = positions[a], pb = positions[b], pc = positions[c];
+        glm::dvec3 n = glm::cross(pb - pa, pc - pa);
+        double area = glm::length(n) * 0.5;
+        if(area > 0.0) {
+            n /= area * 2.0;
+            for(unsigned int k : { a, b, c }) {
+                quadrics[k].addPlane(n, -glm::dot(n, pa), area);
+            }
+        }
+        for(unsigned int k : { a, b, c }) {
+            corner_triangles[k].push_back((unsigned int) t);
+        }
+    }
+
+    addOutlines();
+
+    for(size_t c = 0; c < positions.size(); c++) {
+        neighbours((unsigned int) c, neighbours_a);
+        for(unsigned int k : neighbours_a) {
+            if(c < k) {
+                push((unsigned int) c, k);
+            }
+        }
+    }
+}
+
+/**
+ * Maps every vertex to the first vertex with the same position
+ */
+void Simplifier::weld() {
+    struct PositionHash {
+        size_t operator()(glm::vec3 const &p) const {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u)
+                ^ (bits[2] * 83492791u);
+        }
+    };
+
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> found;
+    vertex_corners.resize(vertices.size());
+    for(size_t v = 0; v < vertices.size(); v++) {
+        auto [it, inserted] = found.try_emplace(vertices[v].position,
+            (unsigned int) positions.size());
+        if(inserted) {
+            positions.push_back(vertices[v].position);
+            corner_vertices.emplace_back();
+        }
+        vertex_corners[v] = it->second;
+        corner_vertices[it->second].push_back((unsigned int) v);
+    }
+}
+
+/**
+ * Adds a plane through each open edge and each attribute seam, at right
+ * angles to its face, so collapses along the outline are cheap and
+ * collapses across it are not
+ */
+void Simplifier::addOutlines() {
+    struct Edge {
+        unsigned int count;
+        unsigned int triangle;
+        unsigned int va, vb;
+        bool seam;
+    };
+
+    std::unordered_map<uint64_t, Edge> edges;
+    for(size_t t = 0; t < triangles.size(); t++) {
+        if(dead[t]) {
+            continue;
+        }
+        for(int i = 0; i < 3; i++) {
+            unsigned int va = triangles[t][i];
+            unsigned int vb = triangles[t][(i + 1) % 3];
+            unsigned int a = vertex_corners[va], b = vertex_corners[vb];
+            uint64_t key = a < b ? (uint64_t) a << 32 | b
+                : (uint64_t) b << 32 | a;
+            auto [it, inserted] = edges.try_emplace(key,
+                Edge{ 0, (unsigned int) t, va, vb, false });
+            Edge &edge = it->second;
+            // the other side of a smooth edge runs the other way, over the
+            // same two vertices
+            if(!inserted && !(edge.va == vb && edge.vb == va)) {
+                edge.seam = true;
+            }
+            edge.count++;
+        }
+    }
+
+    for(auto const &[key, edge] : edges) {
+        if(edge.count != 1 && !edge.seam) {
+            continue;
+        }
+
+        unsigned int a = vertex_corners[edge.va];
+        unsigned int b = vertex_corners[edge.vb];
+        glm::dvec3 pa = positions[a], pb = positions[b];
+        glm::dvec3 p0 = positions[corner(edge.triangle, 0)];
+        glm::dvec3 p1 = positions[corner(edge.triangle, 1)];
+        glm::dvec3 p2 = positions[corner(edge.triangle, 2)];
+        glm::dvec3 n = glm::cross(pb - pa, glm::cross(p1 - p0, p2 - p0));
+        double length = glm::length(n);
+        if(length == 0.0) {
+            continue;
+        }
+
+        n /= length;
+        double w = glm::dot(pb - pa, pb - pa) * BOUNDARY_WEIGHT;
+        quadrics[a].addPlane(n, -glm::dot(n, pa), w);
+        quadrics[b].addPlane(n, -glm::dot(n, pa), w);
+    }
+}
+
+/**
+ * Finds the corners that share a live triangle with a corner, dropping dead
+ * triangles from its list on the way
+ */
+void Simplifier::neighbours(unsigned int c, std::vector<unsigned int> &out) {
+    out.clear();
+    std::vector<unsigned int> &around = corner_triangles[c];
+    size_t kept = 0;
+    for(unsigned int t : around) {
+        if(dead[t]) {
+            continue;
+        }
+        around[kept++] = t;
+        for(int i = 0; i < 3; i++) {
+            unsigned int k = corner(t, i);
+            if(k != c) {
+                out.push_back(k);
+            }
+        }
+    }
+    around.resize(kept);
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+/**
+ * Queues the cheaper way of collapsing an edge
+ */
+void Simplifier::push(unsigned int a, unsigned int b) {
+    Quadric q = quadrics[a];
+    q.add(quadrics[b]);
+    double to_b = q.error(positions[b]);
+    double to_a = q.error(positions[a]);
+    if(to_b <= to_a) {
+        heap.push({ to_b, a, b, versions[a], versions[b] });
+    }
+    else {
+        heap.push({ to_a, b, a, versions[b], versions[a] });
+    }
+}
+
+/**
+ * Checks that collapsing an edge would neither fold a face over nor pinch
+ * the surface into a non-manifold one
+ */
+bool Simplifier::valid(unsigned int from, unsigned int to) {
+    neighbours(from, neighbours_a);
+    neighbours(to, neighbours_b);
+
+    size_t shared_triangles = 0;
+    for(unsigned int t : corner_triangles[from]) {
+        glm::vec3 p[3];
+        bool has_to = false;
+        for(int i = 0; i < 3; i++) {
+            unsigned int k = corner(t, i);
+            has_to |= k == to;
+            p[i] = positions[k];
+        }
+        if(has_to) {
+            shared_triangles++;
+            continue;
+        }
+
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        for(int i = 0; i < 3; i++) {
+            if(corner(t, i) == from) {
+                p[i] = positions[to];
+            }
+        }
+        glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+        float lengths = glm::length(before) * glm::length(after);
+        if(lengths == 0.0f
+                || glm::dot(before, after) < MIN_NORMAL_COS * lengths) {
+            return false;
+        }
+    }
+
+    // the link condition: the ends of the edge may only share the corners
+    // opposite it
+    size_t common = 0;
+    for(size_t i = 0, j = 0;
+            i < neighbours_a.size() && j < neighbours_b.size();) {
+        if(neighbours_a[i] < neighbours_b[j]) {
+            i++;
+        }
+        else if(neighbours_b[j] < neighbours_a[i]) {
+            j++;
+        }
+        else {
+            common++;
+            i++;
+            j++;
+        }
+    }
+    return common <= shared_triangles;
+}
+
+/**
+ * Finds the vertex of a corner whose attributes are closest to another
+ * vertex's, so triangles on each side of a seam keep their own side
+ */
+unsigned int Simplifier::closestVertex(unsigned int vertex,
+        unsigned int to) const {
+    std::vector<unsigned int> const &candidates = corner_vertices[to];
+    unsigned int best = candidates[0];
+    float best_distance = INFINITY;
+    for(unsigned int v : candidates) {
+        glm::vec2 duv = vertices[v].uv - vertices[vertex].uv;
+        glm::vec3 dn = vertices[v].normal - vertices[vertex].normal;
+        float distance = glm::dot(duv, duv) + glm::dot(dn, dn);
+        if(distance < best_distance) {
+            best = v;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+void Simplifier::collapse(unsigned int from, unsigned int to) {
+    for(unsigned int t : corner_triangles[from]) {
+        if(dead[t]) {
+            continue;
+        }
+
+        bool has_to = false;
+        for(int i = 0; i < 3; i++) {
+            has_to |= corner(t, i) == to;
+        }
+        if(has_to) {
+            dead[t] = 1;
+            num_alive--;
+            continue;
+        }
+
+        for(int i = 0; i < 3; i++) {
+            if(corner(t, i) == from) {
+                triangles[t][i] = closestVertex(triangles[t][i], to);
+            }
+        }
+        corner_triangles[to].push_back(t);
+    }
+
+    corner_triangles[from].clear();
+    quadrics[to].add(quadrics[from]);
+    removed[from] = 1;
+    versions[from]++;
+    versions[to]++;
+
+    neighbours(to, neighbours_b);
+    for(unsigned int k : neighbours_b) {
+        push(to, k);
+    }
+}
+
+float Simplifier::run(size_t target_indices,
+        std::vector<unsigned int> &out) {
+    while(num_alive * 3 > target_indices && !heap.empty()) {
+        Candidate candidate = heap.top();
+        heap.pop();
+
+        // an edge whose ends changed since it was queued has been queued
+        // again at its new cost
+        if(removed[candidate.from] || removed[candidate.to]
+                || versions[candidate.from] != candidate.from_version
+                || versions[candidate.to] != candidate.to_version) {
+            continue;
+        }
+        if(!valid(candidate.from, candidate.to)) {
+            continue;
+        }
+
+        collapse(candidate.from, candidate.to);
+        max_error = std::max(max_error, candidate.cost);
+    }
+
+    out.clear();
+    out.reserve(num_alive * 3);
+    for(size_t t = 0; t < triangles.size(); t++) {
+        if(!dead[t]) {
+            out.insert(out.end(), triangles[t].begin(), triangles[t].end());
+        }
+    }
+
+    return (float) std::sqrt(max_error);
+}
+
+float simplify(std::vector<Vertex> const &vertices,
+        std::vector<unsigned int> const &indices, size_t target_indices,
+        std::vector<unsigned int> &out) {
+    Simplifier simplifier(vertices, indices);
+    return simplifier.run(target_indices, out);
+}
+
+void buildLods(MeshData &data, size_t max_lods) {
+    size_t full = data.indices.size();
+    data.lods.clear();
+    data.lods.push_back({ 0, (unsigned int) full, 0.0f });
+
+    // each level carries on simplifying from the one before
+    Simplifier simplifier(data.vertices, data.indices);
+    std::vector<unsigned int> level;
+    size_t previous = full;
+    while(data.lods.size() < max_lods) {
+        float error = simplifier.run(previous / 6 * 3, level);
+        if(level.empty() || level.size() > previous * MIN_REDUCTION) {
+            break;
+        }
+
+        data.lods.push_back({ (unsigned int) data.indices.size(),
+            (unsigned int) level.size(), error });
+        data.indices.insert(data.indices.end(), level.begin(), level.end());
+        previous = level.size();
+    }
+}
+
+};
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define MIPMAP_SSE
+#include <emmintrin.h>
+#endif
+
+#include "utils/image.h"
+#include "utils/mipmap.h"
+
+namespace mipmap {
+
+/**
+ * One RGBA texel in linear floating point, the unit everything is filtered in
+ */
+#ifdef MIPMAP_SSE
+struct Texel {
+    __m128 v;
+
+    static Texel zero() { return { _mm_setzero_ps() }; }
+    static Texel load(float const *p) { return { _mm_loadu_ps(p) }; }
+    static Texel set(float r, float g, float b, float a) {
+        return { _mm_setr_ps(r, g, b, a) };
+    }
+
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+
+    void madd(Texel t, float w) {
+        v = _mm_add_ps(v, _mm_mul_ps(t.v, _mm_set1_ps(w)));
+    }
+
+    Texel saturate() const {
+        return { _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()),
+                _mm_set1_ps(1.0f)) };
+    }
+};
+#else
+struct Texel {
+    float v[4];
+
+    static Texel zero() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+    static Texel load(float const *p) { return { { p[0], p[1], p[2], p[3] } }; }
+    static Texel set(float r, float g, float b, float a) {
+        return { { r, g, b, a } };
+    }
+
+    void store(float *p) const {
+        for(int c = 0; c < 4; c++) {
+            p[c] = v[c];
+        }
+    }
+
+    void madd(Texel t, float w) {
+        for(int c = 0; c < 4; c++) {
+            v[c] += t.v[c] * w;
+        }
+    }
+
+    Texel saturate() const {
+        Texel t;
+        for(int c = 0; c < 4; c++) {
+            t.v[c] = std::clamp(v[c], 0.0f, 1.0f);
+        }
+        return t;
+    }
+};
+#endif
+
+/**
+ * A mip level kept in linear floating point between passes, so that every
+ * level is filtered from unquantized data
+ */
+struct Plane {
+    int width;
+    int height;
+    std::vector<float> texels;
+
+    Texel texel(int x, int y) const {
+        return Texel::load(&texels[((size_t) y * width + x) * 4]);
+    }
+};
+
+/**
+ * An 8 bit image read through a decode table
+ */
+struct Encoded {
+    Image const &image;
+    float const *decode;
+
+    Texel texel(int x, int y) const {
+        unsigned char const *p
+            = &image.pixels[((size_t) y * image.width + x) * 4];
+        return Texel::set(decode[p[0]], decode[p[1]], decode[p[2]],
+                p[3] * (1.0f / 255.0f));
+    }
+};
+
+/**
+ * A separable downsampling kernel. Output texel x reads source texels
+ * 2x + first through 2x + first + taps - 1.
+ */
+struct Kernel {
+    int taps;
+    int first;
+    float weights[8];
+};
+
+static constexpr Kernel box_kernel = { 2, 0, { 0.5f, 0.5f } };
+
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for(int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * @return a sinc low pass at half the sample rate under a Kaiser window
+ *         spanning 4 source texels either side of the output texel
+ */
+static Kernel const &kaiserKernel() {
+    static Kernel const kernel = []() {
+        Kernel k = { 8, -3, {} };
+        double const radius = 4.0;
+        double const beta = 4.0;
+        double const pi = 3.14159265358979323846;
+
+        double total = 0.0;
+        double weights[8];
+        for(int i = 0; i < 8; i++) {
+            // distance from the output texel's centre, in source texels
+            double d = (k.first + i) - 0.5;
+            double x = d / 2.0;
+            double sinc = std::sin(pi * x) / (pi * x);
+            double r = d / radius;
+            double window = besselI0(beta * std::sqrt(1.0 - r * r))
+                / besselI0(beta);
+            weights[i] = sinc * window;
+            total += weights[i];
+        }
+        for(int i = 0; i < 8; i++) {
+            k.weights[i] = (float) (weights[i] / total);
+        }
+        return k;
+    }();
+    return kernel;
+}
+
+static float srgbToLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f
+        : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c) {
+    return c <= 0.0031308f ? c * 12.92f
+        : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * @param srgb whether or not the channel is sRGB encoded
+ * @return the linear value of each 8 bit channel value
+ */
+static float const *decodeTable(bool srgb) {
+    static std::vector<float> const tables[2] = {
+        []() {
+            std::vector<float> t(256);
+            for(int i = 0; i < 256; i++) {
+                t[i] = i / 255.0f;
+            }
+            return t;
+        }(),
+        []() {
+            std::vector<float> t(256);
+            for(int i = 0; i < 256; i++) {
+                t[i] = srgbToLinear(i / 255.0f);
+            }
+            return t;
+        }()
+    };
+    return tables[srgb].data();
+}
+
+// fine enough that quantizing to it never moves the 8 bit result
+static constexpr int encode_steps = 16384;
+
+/**
+ * @return the 8 bit sRGB value of each step of linear intensity
+ */
+static unsigned char const *encodeTable() {
+    static std::vector<unsigned char> const table = []() {
+        std::vector<unsigned char> t(encode_steps);
+        for(int i = 0; i < encode_steps; i++) {
+            float c = linearToSrgb(i / (float) (encode_steps - 1));
+            t[i] = (unsigned char) (c * 255.0f + 0.5f);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+/**
+ * Quantizes a linear level back to 8 bits
+ * @param plane the level to quantize
+ * @param srgb whether or not to sRGB encode the colour channels
+ * @param dest the destination image
+ */
+static void encode(Plane const &plane, bool srgb, Image &dest) {
+    dest.width = plane.width;
+    dest.height = plane.height;
+    dest.pixels.resize((size_t) plane.width * plane.height * 4);
+
+    unsigned char const *table = encodeTable();
+    size_t n = (size_t) plane.width * plane.height;
+
+    // colour channels index the encode table, alpha goes straight to 8 bits
+    float const scale[4] = {
+        srgb ? encode_steps - 1.0f : 255.0f,
+        srgb ? encode_steps - 1.0f : 255.0f,
+        srgb ? encode_steps - 1.0f : 255.0f,
+        255.0f
+    };
+
+    for(size_t i = 0; i < n; i++) {
+        int q[4];
+#ifdef MIPMAP_SSE
+        __m128 t = Texel::load(&plane.texels[i * 4]).saturate().v;
+        _mm_storeu_si128((__m128i *) q,
+                _mm_cvtps_epi32(_mm_mul_ps(t, _mm_loadu_ps(scale))));
+#else
+        Texel t = Texel::load(&plane.texels[i * 4]).saturate();
+        for(int c = 0; c < 4; c++) {
+            q[c] = (int) (t.v[c] * scale[c] + 0.5f);
+        }
+#endif
+
+        unsigned char *out = &dest.pixels[i * 4];
+        for(int c = 0; c < 3; c++) {
+            out[c] = srgb ? table[q[c]] : (unsigned char) q[c];
+        }
+        out[3] = (unsigned char) q[3];
+    }
+}
+
+/**
+ * Halves a level, filtering vertically into a single row of the source's
+ * width and then horizontally out of that row, so no intermediate level is
+ * ever held in full. The tap count is a template parameter so the inner
+ * loops unroll.
+ * @param src the level to downsample, anything with texel(x, y)
+ * @param width the width of the source
+ * @param height the height of the source
+ * @param kernel the kernel to filter with, with taps taps
+ * @param dest the destination, half the size of the source rounded down
+ *             (but never below 1)
+ */
+template <int taps, typename Source>
+static void downsample(Source const &src, int width, int height,
+        Kernel const &kernel, Plane &dest) {
+    dest.width = std::max(width / 2, 1);
+    dest.height = std::max(height / 2, 1);
+    dest.texels.resize((size_t) dest.width * dest.height * 4);
+
+    // the source columns read by each output column, clamped to the edge
+    std::vector<int> columns((size_t) dest.width * taps);
+    for(int x = 0; x < dest.width; x++) {
+        for(int k = 0; k < taps; k++) {
+            columns[x * taps + k]
+                = std::clamp(2 * x + kernel.first + k, 0, width - 1);
+        }
+    }
+
+    std::vector<float> row((size_t) width * 4);
+    int rows[taps];
+    for(int y = 0; y < dest.height; y++) {
+        for(int k = 0; k < taps; k++) {
+            rows[k] = std::clamp(2 * y + kernel.first + k, 0, height - 1);
+        }
+
+        for(int x = 0; x < width; x++) {
+            Texel acc = Texel::zero();
+            for(int k = 0; k < taps; k++) {
+                acc.madd(src.texel(x, rows[k]), kernel.weights[k]);
+            }
+            acc.store(&row[(size_t) x * 4]);
+        }
+
+        float *out = &dest.texels[(size_t) y * dest.width * 4];
+        for(int x = 0; x < dest.width; x++) {
+            int const *sx = &columns[x * taps];
+            Texel acc = Texel::zero();
+            for(int k = 0; k < taps; k++) {
+                acc.madd(Texel::load(&row[(size_t) sx[k] * 4]),
+                        kernel.weights[k]);
+            }
+            acc.store(&out[(size_t) x * 4]);
+        }
+    }
+}
+
+template <int taps>
+static void buildWith(std::vector<Image> &levels, Kernel const &kernel,
+        bool srgb) {
+    Plane current;
+    downsample<taps>(Encoded{ levels[0], decodeTable(srgb) },
+            levels[0].width, levels[0].height, kernel, current);
+    encode(current, srgb, levels.emplace_back());
+
+    while(current.width > 1 || current.height > 1) {
+        Plane next;
+        downsample<taps>(current, current.width, current.height, kernel,
+                next);
+        encode(next, srgb, levels.emplace_back());
+        current = std::move(next);
+    }
+}
+
+void build(std::vector<Image> &levels, Filter filter, bool srgb) {
+    if(levels[0].width <= 1 && levels[0].height <= 1) {
+        return;
+    }
+
+    if(filter == Filter::box) {
+        buildWith<2>(levels, box_kernel, srgb);
+    }
+    else {
+        buildWith<8>(levels, kaiserKernel(), srgb);
+    }
+}
+
+};
@@ -1,245 +1,372 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <charconv>
+#include <chrono>
 #include <cstdio>
-#include <fstream>
+#include <cstring>
+#include <latch>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <glm/common.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
 #include "graphics/mesh.h"
 #include "graphics/model.h"
+#include "graphics/texture_loader.h"
+#include "graphics/texture_registry.h"
 #include "graphics/vertex.h"
 
+#include "threading/thread.h"
+
+#include "utils/file_source.h"
 #include "utils/obj_loader.h"
+#include "utils/triangulator.h"
 
 namespace obj_loader {
 
-static void parseLineFloats(std::vector<float> &dest, std::string line) {
-    int start = 0;
-    for(start = 0; line[start] != ' ' && line[start] != '\n' &&
-            line[start] != '\0'; start++);
-
-    while(line[start] != '\0' && line[start] != '\n') {
-        int end;
-        start++;
-        for(end = start; line[end] != ' ' && line[end] != '\n' &&
-                line[end] != '\0'; end++);
-        dest.push_back(std::stof(line.substr(start, end - start)));
-        start = end;
+// whether parseObj reports each load, files may be parsed on several threads
+static std::atomic<bool> verbose = false;
+
+void setVerbose(bool on) {
+    verbose.store(on, std::memory_order_relaxed);
+}
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char const *skipBlanks(char const *cur, char const *end) {
+    while(cur < end && isBlank(*cur)) {
+        cur++;
     }
+    return cur;
 }
 
-static void parseLineStrings(std::vector<std::string> &dest, std::string line) {
-    int start = 0;
-    for(start = 0; line[start] != ' ' && line[start] != '\n' &&
-            line[start] != '\0'; start++);
-
-    while(line[start] != '\0' && line[start] != '\n') {
-        int end;
-        start++;
-        for(end = start; line[end] != ' ' && line[end] != '\n' &&
-                line[end] != '\0'; end++);
-        dest.push_back(line.substr(start, end - start));
-        start = end;
+/**
+ * Reads the next whitespace delimited token on a line and advances the cursor
+ * past it
+ * @param cur the cursor, pointing somewhere within the line
+ * @param end the end of the line
+ * @return the token, empty if the line is exhausted
+ */
+static std::string_view nextToken(char const *&cur, char const *end) {
+    cur = skipBlanks(cur, end);
+    char const *start = cur;
+    while(cur < end && !isBlank(*cur)) {
+        cur++;
     }
+    return std::string_view(start, cur - start);
 }
 
-static void parseVertexString(std::vector<int> &values,
-        std::string string_vertex) {
-    int start = -1;
-    
-    do {
-        int end;
-        start++;
+/**
+ * Parses the next float on a line and advances the cursor past it
+ * @param cur the cursor, pointing somewhere within the line
+ * @param end the end of the line
+ * @return the parsed value, 0 if there is no valid float
+ */
+static float nextFloat(char const *&cur, char const *end) {
+    cur = skipBlanks(cur, end);
+
+    // from_chars does not accept an explicit plus sign
+    if(cur < end && *cur == '+') {
+        cur++;
+    }
+
+    float value = 0.0f;
+    auto [ptr, ec] = std::from_chars(cur, end, value);
+    cur = ptr;
 
-        for(end = start; string_vertex[end] != '/'
-                && string_vertex[end] != '\0'; end++);
+    return ec == std::errc() ? value : 0.0f;
+}
 
-        std::string string_value = string_vertex.substr(start, end - start);
-        int value;
+/**
+ * Parses one face corner (v, v/vt, v//vn or v/vt/vn) into zero-based indices
+ * and advances the cursor past it. Missing components are set to -1.
+ * @param cur the cursor, pointing somewhere within the line
+ * @param end the end of the line
+ * @param counts the number of positions, uvs and normals seen so far, used to
+ *               resolve negative (relative) indices
+ * @param indices the position, uv and normal indices
+ * @return whether or not a corner was parsed
+ */
+static bool nextCorner(char const *&cur, char const *end, int const counts[3],
+        int indices[3]) {
+    cur = skipBlanks(cur, end);
+    if(cur == end) {
+        return false;
+    }
 
-        if(string_value == "") {
-            value = 0;
+    for(int i = 0; i < 3; i++) {
+        int value = 0;
+        if(cur < end && *cur != '/' && !isBlank(*cur)) {
+            auto [ptr, ec] = std::from_chars(cur, end, value);
+            if(ec != std::errc()) {
+                return false;
+            }
+            cur = ptr;
         }
 
+        if(value > 0) {
+            indices[i] = value - 1;
+        }
+        else if(value < 0) {
+            indices[i] = counts[i] + value;
+        }
         else {
-            value = std::stoi(string_value);
+            indices[i] = -1;
         }
 
-        values.push_back(value);
-        start = end;
+        if(cur < end && *cur == '/') {
+            cur++;
+        }
     }
 
-    while(string_vertex[start] != '\0');
+    return true;
 }
 
-static void createFace(std::vector<Vertex> &face,
-        std::vector<glm::vec3> &positions, std::vector<glm::vec3> &normals,
-        std::vector<glm::vec2> &uvs, std::string line) {
-    std::vector<std::string> string_vertices;
-    parseLineStrings(string_vertices, line);
-
-    for(int i = 0; i < string_vertices.size(); i++) {
-        std::vector<int> values;
-        parseVertexString(values, string_vertices[i]);
-        Vertex v;
-        v.position = positions[values[0] - 1];
-        v.uv = uvs[values[1] - 1];
-        v.normal = normals[values[2] - 1];
-        face.push_back(v);
+/**
+ * Calls a function for every line in a buffer, without its trailing newline
+ * @param data the buffer
+ * @param func the function to call with the start and end of each line
+ */
+template <typename Func>
+static void forEachLine(std::string_view data, Func const &func) {
+    char const *cur = data.data();
+    char const *end = data.data() + data.size();
+    while(cur < end) {
+        char const *eol = (char const *) std::memchr(cur, '\n', end - cur);
+        if(!eol) {
+            eol = end;
+        }
+
+        func(cur, eol);
+
+        cur = eol + (eol < end);
     }
 }
 
-static glm::vec3 createFaceNormal(std::vector<Vertex> &face) {
-    glm::vec3 normal = glm::vec3(0, 0, 0);
-    for(int i = 0; i < face.size(); i++) {
-        if(i == face.size() - 1) {
-            normal += glm::cross(face[i].position,
-                    face[0].position);
+/**
+ * Counts the attribute and face lines in an OBJ buffer so the destination
+ * arrays can be allocated once up front. Lines are told apart with the same
+ * tokenizer the parsers use, so the counts match what they will write.
+ * @param data the buffer
+ * @param counts the number of v, vn, vt and f lines respectively
+ */
+static void countLines(std::string_view data, size_t counts[4]) {
+    forEachLine(data, [counts](char const *cur, char const *eol) {
+        std::string_view type = nextToken(cur, eol);
+        if(type == "v") {
+            counts[0]++;
         }
-        else {
-            normal += glm::cross(face[i].position,
-                    face[i + 1].position);
+        else if(type == "vn") {
+            counts[1]++;
         }
-    }
-
-    return glm::normalize(normal);
+        else if(type == "vt") {
+            counts[2]++;
+        }
+        else if(type == "f") {
+            counts[3]++;
+        }
+    });
 }
 
-static bool isEar(std::vector<Vertex> &face, glm::vec3 normal, int vi) {
-    int face_size = face.size();
-
-    if(vi >= face_size || vi < 0)
-        return false;
-
-    int pvi = (vi == 0) ? (face_size - 1) : (vi - 1);
-    int nvi = (vi == face_size - 1) ? (0) : (vi + 1);
+/**
+ * The attribute arrays that face corners index into
+ */
+struct Attributes {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+};
 
-    glm::vec3 v = face[vi].position;
-    glm::vec3 pv = face[pvi].position;
-    glm::vec3 nv = face[nvi].position;
+/**
+ * A face corner, as indices into the position, uv and normal arrays. Missing
+ * components are -1.
+ */
+struct Corner {
+    int position;
+    int uv;
+    int normal;
 
-    glm::vec3 s1 = v - pv;
-    glm::vec3 s2 = nv - v;
-    glm::vec3 s3 = pv - nv;
+    bool operator==(Corner const &other) const = default;
+};
 
-    // vertex is not convex
-    glm::vec3 vert_dir = glm::normalize(glm::cross(s1, s2));
-    if(glm::dot(vert_dir, normal) < 0) {
-        return false;
+struct CornerHash {
+    size_t operator()(Corner const &c) const {
+        size_t h = (unsigned) c.position;
+        h = h * 0x9e3779b97f4a7c15ull ^ (unsigned) c.uv;
+        h = h * 0x9e3779b97f4a7c15ull ^ (unsigned) c.normal;
+        return h ^ (h >> 29);
     }
+};
 
-    for(int i = 0; i < face_size; i++) {
-        if(i != vi && i != nvi && i != pvi) {
-            glm::vec3 p = face[i].position;
-            glm::vec2 p1x = glm::normalize(glm::cross(s1, p - pv));
-            glm::vec2 p2x = glm::normalize(glm::cross(s2, p - v));
-            glm::vec2 p3x = glm::normalize(glm::cross(s3, p - nv));
+/**
+ * Reusable scratch space for triangulating faces
+ */
+struct FaceScratch {
+    std::vector<glm::vec3> polygon;
+    Triangulator triangulator;
+};
 
-            if(glm::dot(p1x, p2x) > 0 && glm::dot(p2x, p3x) > 0) {
-                return false;
+/**
+ * Parses the corners of a face line, then triangulates it into the
+ * destination corner and index arrays
+ * @param cur the cursor, pointing just past the line type
+ * @param eol the end of the line
+ * @param attribs the attribute arrays to look corners up in
+ * @param counts the number of positions, uvs and normals defined before this
+ *               line, corners referring past these are left zeroed
+ * @param corners the destination corner array
+ * @param indices the destination index array, indexing into the corners
+ * @param scratch scratch space reused between faces
+ */
+static void parseFace(char const *cur, char const *eol,
+        Attributes const &attribs, int const counts[3],
+        std::vector<Corner> &corners, std::vector<unsigned int> &indices,
+        FaceScratch &scratch) {
+    int corner[3];
+
+    int face_offset = corners.size();
+
+    scratch.polygon.clear();
+    while(nextCorner(cur, eol, counts, corner)) {
+        // references to attributes that are not defined (yet) are dropped
+        for(int k = 0; k < 3; k++) {
+            if(corner[k] < 0 || corner[k] >= counts[k]) {
+                corner[k] = -1;
             }
         }
+        corners.push_back(Corner{ corner[0], corner[1], corner[2] });
+
+        // only the positions matter for triangulating
+        scratch.polygon.push_back(corner[0] >= 0
+                ? attribs.positions[corner[0]] : glm::vec3(0.0f));
     }
-    return true;
+
+    scratch.triangulator.triangulate(scratch.polygon, face_offset, indices);
 }
 
-bool loadObj(std::vector<Mesh> &meshes, std::string path) {
-    // ensure that the given file is an object file
-    // assume it is if it ends in .obj
-    if(path.substr(path.size() - 4, 4) != ".obj") {
-        std::fprintf(stderr, "File %s is not an object file\n", path.c_str());
-        return false;
+/**
+ * Handles the material lines of an OBJ file (mtllib and usemtl)
+ * @param type the line type
+ * @param cur the cursor, pointing just past the line type
+ * @param eol the end of the line
+ * @param path the path to the OBJ file, material libraries are relative to it
+ * @param materials the materials loaded so far
+ * @param current_materials the materials used by the mesh
+ * @param libraries the paths of the material libraries named so far
+ * @return false if the line names a material that was never loaded
+ */
+static bool parseMaterialLine(std::string_view type, char const *cur,
+        char const *eol, std::string const &path,
+        std::vector<Material> &materials,
+        std::vector<Material> &current_materials,
+        std::vector<std::string> &libraries) {
+    if(type == "mtllib") {
+        std::string_view name = nextToken(cur, eol);
+        std::string folder = path.substr(0, path.rfind('/') + 1);
+        libraries.push_back(folder + std::string(name));
+        loadMtl(materials, libraries.back());
     }
 
-    std::ifstream model_file(path);
+    else if(type == "usemtl") {
+        std::string_view name = nextToken(cur, eol);
+        for(int i = 0; i < materials.size(); i++) {
+            if(name == materials[i].name) {
+                current_materials.push_back(materials[i]);
+                return true;
+            }
+        }
+
+        std::fprintf(stderr, "Could not find material %.*s\n",
+                (int) name.size(), name.data());
 
-    // ensure the model file exists
-    if(!model_file.is_open()) {
-        std::fprintf(stderr, "File %s does not exist\n", path.c_str());
         return false;
     }
 
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> uvs;
+    return true;
+}
+
+/**
+ * Parses an OBJ file line by line on the calling thread
+ * @param source the opened file
+ * @param path the path to the OBJ file
+ * @param attribs the destination attribute arrays
+ * @param corners the destination face corner array
+ * @param indices the destination index array, indexing into the corners
+ * @param current_materials the destination for the materials used
+ * @param libraries the destination for the material library paths
+ * @return whether or not the file was parsed successfully
+ */
+static bool parseSerial(FileSource &source, std::string const &path,
+        Attributes &attribs, std::vector<Corner> &corners,
+        std::vector<unsigned int> &indices,
+        std::vector<Material> &current_materials,
+        std::vector<std::string> &libraries) {
+    // counting needs the whole file up front, so a streamed file just grows
+    // its arrays as it goes
+    size_t line_counts[4] = { 0, 0, 0, 0 };
+    if(source.isMapped()) {
+        countLines(source.data(), line_counts);
+    }
+
     std::vector<Material> materials;
+    attribs.positions.reserve(line_counts[0]);
+    attribs.normals.reserve(line_counts[1]);
+    attribs.uvs.reserve(line_counts[2]);
 
-    std::vector<Vertex> current_vertices;
-    std::vector<unsigned int> current_indices;
-    std::vector<Material> current_materials;
-    int face_offset = 0;
+    // most faces are triangles, larger faces just grow the arrays
+    corners.reserve(line_counts[3] * 3);
+    indices.reserve(line_counts[3] * 3);
+
+    FaceScratch scratch;
 
     // iterate through each line in the model file
-    std::string line;
-    while(std::getline(model_file, line)) {
+    for(std::string_view line : source.lines()) {
+        char const *cur = line.data();
+        char const *eol = line.data() + line.size();
+
         // get the line type, (AKA the first word of the line)
-        int type_len;
-        for(type_len = 0; line[type_len] != ' ' && line[type_len] != '\n' &&
-                line[type_len] != '\0'; type_len++);
-        std::string type = line.substr(0, type_len);
+        std::string_view type = nextToken(cur, eol);
 
         // line type is a vertex (position) line
         if(type == "v") {
-            // parse a posiiton
-            std::vector<float> values;
-            parseLineFloats(values, line);
-            positions.push_back(glm::vec3(values[0], values[1], values[2]));
+            float x = nextFloat(cur, eol);
+            float y = nextFloat(cur, eol);
+            float z = nextFloat(cur, eol);
+            attribs.positions.push_back(glm::vec3(x, y, z));
         }
 
         // line type is a vertex normal line
         else if(type == "vn") {
-            std::vector<float> values;
-            parseLineFloats(values, line);
-            normals.push_back(glm::vec3(values[0], values[1], values[2]));
+            float x = nextFloat(cur, eol);
+            float y = nextFloat(cur, eol);
+            float z = nextFloat(cur, eol);
+            attribs.normals.push_back(glm::vec3(x, y, z));
         }
 
         // line type is a texture coordinate line
         else if(type == "vt") {
-            // parse a texture coordinate
-            std::vector<float> values;
-            parseLineFloats(values, line);
-            uvs.push_back(glm::vec2(values[0], values[1]));
+            float u = nextFloat(cur, eol);
+            float v = nextFloat(cur, eol);
+            attribs.uvs.push_back(glm::vec2(u, v));
         }
 
         // line type is a face line
         else if(type == "f") {
-            std::vector<Vertex> face;
-            createFace(face, positions, normals, uvs, line);
-            glm::vec3 normal = createFaceNormal(face);
-
-            for(int i = 0; i < face.size(); i++) {
-                current_vertices.push_back(face[i]);
-            }
-
-            int face_size = face.size();
-            std::vector<Vertex> face_left = face;
-
-            while(face_left.size() > 2) {
-                for(int vi = 0; vi < face_left.size(); vi++) {
-                    if(isEar(face_left, normal, vi)) {
-                        int pvi = (vi == 0) ? (face_size - 1) : (vi - 1);
-                        int nvi = (vi == face_size - 1) ? (0) : (vi + 1);
-
-                        for(int vj = 0; vj < face.size(); vj++) {
-                            if(face[vj].position ==
-                                    face_left[pvi].position ||
-                                    face[vj].position ==
-                                    face_left[vi].position ||
-                                    face[vj].position ==
-                                    face_left[nvi].position) {
-                                current_indices.push_back(face_offset + vj);
-                            }
-                        }
-
-                        face_left.erase(face_left.begin() + vi);
-
-                        break;
-                    }
-                }
-            }
-
-            face_offset += face_size;
+            int counts[3] = {
+                (int) attribs.positions.size(), (int) attribs.uvs.size(),
+                (int) attribs.normals.size()
+            };
+            parseFace(cur, eol, attribs, counts, corners, indices, scratch);
         }
 
         else if(type == "o") {
@@ -254,29 +381,9 @@ bool loadObj(std::vector<Mesh> &meshes, std::string path) {
             // ignore for now
         }
 
-        else if(type == "mtllib") {
-            std::vector<std::string> name;
-            parseLineStrings(name, line);
-            std::string folder = path.substr(0, path.rfind('/') + 1); 
-            loadMtl(materials, folder + name[0]);
-        }
-
-        else if(type == "usemtl") {
-            std::vector<std::string> name;
-            parseLineStrings(name, line);
-            bool found = false;
-            for(int i = 0; i < materials.size(); i++) {
-                if(name[0] == materials[i].name) {
-                    current_materials.push_back(materials[i]);
-                    found = true;
-                    break;
-                }
-            }
-
-            if(!found) {
-                std::fprintf(stderr, "Could not find material %s\n",
-                        name[0].c_str());
-
+        else if(type == "mtllib" || type == "usemtl") {
+            if(!parseMaterialLine(type, cur, eol, path, materials,
+                        current_materials, libraries)) {
                 return false;
             }
         }
@@ -291,9 +398,381 @@ bool loadObj(std::vector<Mesh> &meshes, std::string path) {
         }
     }
 
+    return true;
+}
+
+/**
+ * Files smaller than this are parsed serially, splitting them is not worth
+ * the handoff to the pool
+ */
+static constexpr size_t parallel_threshold = 4 << 20;
+
+/**
+ * The smallest chunk a file is split into for parallel parsing
+ */
+static constexpr size_t min_chunk_size = 1 << 20;
+
+/**
+ * Gets the thread pool used for parallel parsing. It is created on first use
+ * and destroyed at exit, which joins its threads.
+ * @return the loader thread pool
+ */
+static ThreadPool &loaderPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+/**
+ * Runs a function once per chunk on the loader pool and waits for every call
+ * to finish
+ * @param num_chunks the number of chunks
+ * @param func the function to run, given the index of the chunk
+ */
+template <typename Func>
+static void forEachChunk(size_t num_chunks, Func const &func) {
+    std::latch done(num_chunks);
+    for(size_t i = 0; i < num_chunks; i++) {
+        loaderPool().run([&func, &done, i]() {
+            func(i);
+            done.count_down();
+        });
+    }
+    done.wait();
+}
+
+/**
+ * Splits a buffer into roughly equal chunks that each start at the beginning
+ * of a line and end just after a newline (or at the end of the buffer)
+ * @param data the buffer to split
+ * @param num_chunks the number of chunks wanted
+ * @return the chunks, possibly fewer than requested for short buffers
+ */
+static std::vector<std::string_view> splitLines(std::string_view data,
+        size_t num_chunks) {
+    std::vector<std::string_view> chunks;
+    chunks.reserve(num_chunks);
+
+    size_t target = data.size() / num_chunks + 1;
+    size_t start = 0;
+    while(start < data.size()) {
+        size_t split = start + target;
+        if(split >= data.size()) {
+            split = data.size();
+        }
+        else {
+            size_t eol = data.find('\n', split);
+            split = (eol == std::string_view::npos) ? data.size() : eol + 1;
+        }
+
+        chunks.push_back(data.substr(start, split - start));
+        start = split;
+    }
+
+    return chunks;
+}
+
+/**
+ * Parses a mapped OBJ file on the loader pool. The output is identical to
+ * parsing it serially.
+ *
+ * The file is split into line-aligned chunks and parsed in three passes:
+ * counting the attribute lines of each chunk, parsing attributes straight
+ * into their final slots (found from a prefix sum of the counts), and then
+ * triangulating the faces of each chunk into its own arrays. A last pass
+ * concatenates the per-chunk corners, shifting their indices by the number
+ * of corners in the chunks before them. Material lines are collected during
+ * the face pass and handled afterwards on the calling thread, in file order.
+ * @param data the contents of the file
+ * @param path the path to the OBJ file
+ * @param attribs the destination attribute arrays
+ * @param corners the destination face corner array
+ * @param indices the destination index array, indexing into the corners
+ * @param current_materials the destination for the materials used
+ * @param libraries the destination for the material library paths
+ * @return whether or not the file was parsed successfully
+ */
+static bool parseParallel(std::string_view data, std::string const &path,
+        Attributes &attribs, std::vector<Corner> &corners,
+        std::vector<unsigned int> &indices,
+        std::vector<Material> &current_materials,
+        std::vector<std::string> &libraries) {
+    size_t wanted = std::min<size_t>(loaderPool().size() * 4,
+            data.size() / min_chunk_size + 1);
+    std::vector<std::string_view> chunks = splitLines(data, wanted);
+    size_t num_chunks = chunks.size();
+
+    // pass one: count the attribute and face lines of every chunk
+    std::vector<std::array<size_t, 4>> line_counts(num_chunks);
+    forEachChunk(num_chunks, [&](size_t i) {
+        line_counts[i].fill(0);
+        countLines(chunks[i], line_counts[i].data());
+    });
+
+    // the prefix sum gives the first position, normal and uv of each chunk
+    std::vector<std::array<size_t, 3>> first(num_chunks);
+    std::array<size_t, 3> totals = { 0, 0, 0 };
+    for(size_t i = 0; i < num_chunks; i++) {
+        first[i] = totals;
+        for(int k = 0; k < 3; k++) {
+            totals[k] += line_counts[i][k];
+        }
+    }
+
+    attribs.positions.resize(totals[0]);
+    attribs.normals.resize(totals[1]);
+    attribs.uvs.resize(totals[2]);
+
+    // pass two: parse the attributes straight into place, each chunk
+    // stopping short of the next chunk's first slot
+    forEachChunk(num_chunks, [&](size_t i) {
+        glm::vec3 *position = attribs.positions.data() + first[i][0];
+        glm::vec3 *normal = attribs.normals.data() + first[i][1];
+        glm::vec2 *uv = attribs.uvs.data() + first[i][2];
+        glm::vec3 const *positions_end = position + line_counts[i][0];
+        glm::vec3 const *normals_end = normal + line_counts[i][1];
+        glm::vec2 const *uvs_end = uv + line_counts[i][2];
+
+        forEachLine(chunks[i], [&](char const *cur, char const *eol) {
+            std::string_view type = nextToken(cur, eol);
+            if(type == "v") {
+                float x = nextFloat(cur, eol);
+                float y = nextFloat(cur, eol);
+                float z = nextFloat(cur, eol);
+                assert(position < positions_end);
+                *position++ = glm::vec3(x, y, z);
+            }
+            else if(type == "vn") {
+                float x = nextFloat(cur, eol);
+                float y = nextFloat(cur, eol);
+                float z = nextFloat(cur, eol);
+                assert(normal < normals_end);
+                *normal++ = glm::vec3(x, y, z);
+            }
+            else if(type == "vt") {
+                float u = nextFloat(cur, eol);
+                float v = nextFloat(cur, eol);
+                assert(uv < uvs_end);
+                *uv++ = glm::vec2(u, v);
+            }
+        });
+    });
+
+    // pass three: triangulate the faces of every chunk, with indices local
+    // to the chunk
+    std::vector<std::vector<Corner>> chunk_corners(num_chunks);
+    std::vector<std::vector<unsigned int>> chunk_indices(num_chunks);
+    std::vector<std::vector<std::string_view>> material_lines(num_chunks);
+    forEachChunk(num_chunks, [&](size_t i) {
+        chunk_corners[i].reserve(line_counts[i][3] * 3);
+        chunk_indices[i].reserve(line_counts[i][3] * 3);
+
+        // a face can only see the attributes defined above it
+        int counts[3] = {
+            (int) first[i][0], (int) first[i][2], (int) first[i][1]
+        };
+        FaceScratch scratch;
+
+        forEachLine(chunks[i], [&](char const *cur, char const *eol) {
+            char const *line = cur;
+            std::string_view type = nextToken(cur, eol);
+            if(type == "v") {
+                counts[0]++;
+            }
+            else if(type == "vt") {
+                counts[1]++;
+            }
+            else if(type == "vn") {
+                counts[2]++;
+            }
+            else if(type == "f") {
+                parseFace(cur, eol, attribs, counts, chunk_corners[i],
+                        chunk_indices[i], scratch);
+            }
+            else if(type == "mtllib" || type == "usemtl") {
+                material_lines[i].push_back(
+                        std::string_view(line, eol - line));
+            }
+        });
+    });
+
+    // material libraries load textures, so they stay on this thread
+    std::vector<Material> materials;
+    for(size_t i = 0; i < num_chunks; i++) {
+        for(std::string_view line : material_lines[i]) {
+            char const *cur = line.data();
+            char const *eol = line.data() + line.size();
+
+            std::string_view type = nextToken(cur, eol);
+            if(!parseMaterialLine(type, cur, eol, path, materials,
+                        current_materials, libraries)) {
+                return false;
+            }
+        }
+    }
+
+    // pass four: concatenate the chunks, offsetting their indices
+    std::vector<size_t> first_corner(num_chunks);
+    std::vector<size_t> first_index(num_chunks);
+    size_t total_corners = 0;
+    size_t total_indices = 0;
+    for(size_t i = 0; i < num_chunks; i++) {
+        first_corner[i] = total_corners;
+        first_index[i] = total_indices;
+        total_corners += chunk_corners[i].size();
+        total_indices += chunk_indices[i].size();
+    }
+
+    corners.resize(total_corners);
+    indices.resize(total_indices);
+    forEachChunk(num_chunks, [&](size_t i) {
+        std::copy(chunk_corners[i].begin(), chunk_corners[i].end(),
+                corners.begin() + first_corner[i]);
+
+        unsigned int offset = first_corner[i];
+        unsigned int *dest = indices.data() + first_index[i];
+        for(unsigned int index : chunk_indices[i]) {
+            *dest++ = index + offset;
+        }
+
+        // free each chunk as soon as it is copied to keep the peak down
+        std::vector<Corner>().swap(chunk_corners[i]);
+        std::vector<unsigned int>().swap(chunk_indices[i]);
+    });
+
+    return true;
+}
+
+/**
+ * Builds one vertex per unique (position, uv, normal) corner and remaps the
+ * indices onto them, so corners shared between faces share a vertex
+ * @param attribs the attribute arrays the corners index into
+ * @param corners the face corners
+ * @param indices the indices into the corners, remapped in place
+ * @param vertices the destination for the unique vertices
+ */
+static void buildVertices(Attributes const &attribs,
+        std::vector<Corner> const &corners,
+        std::vector<unsigned int> &indices, std::vector<Vertex> &vertices) {
+    std::unordered_map<Corner, unsigned int, CornerHash> unique;
+    unique.reserve(corners.size());
+
+    std::vector<unsigned int> remap(corners.size());
+    for(size_t i = 0; i < corners.size(); i++) {
+        Corner const &c = corners[i];
+        auto [it, inserted] = unique.try_emplace(c, vertices.size());
+        if(inserted) {
+            Vertex v = {};
+            if(c.position >= 0) {
+                v.position = attribs.positions[c.position];
+            }
+            if(c.uv >= 0) {
+                v.uv = attribs.uvs[c.uv];
+            }
+            if(c.normal >= 0) {
+                v.normal = attribs.normals[c.normal];
+            }
+            vertices.push_back(v);
+        }
+        remap[i] = it->second;
+    }
+
+    for(unsigned int &index : indices) {
+        index = remap[index];
+    }
+}
+
+bool parseObj(MeshData &data, std::string path, bool split) {
+    // ensure that the given file is an object file
+    // assume it is if it ends in .obj
+    if(path.size() < 4 || path.substr(path.size() - 4, 4) != ".obj") {
+        std::fprintf(stderr, "File %s is not an object file\n", path.c_str());
+        return false;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // ensure the model file exists
+    FileSource source;
+    if(!source.open(path)) {
+        std::fprintf(stderr, "File %s does not exist\n", path.c_str());
+        return false;
+    }
+    size_t file_size = source.size();
+
+    Attributes attribs;
+    std::vector<Corner> corners;
+    std::vector<unsigned int> current_indices;
+    std::vector<Material> current_materials;
+    std::vector<std::string> libraries;
+
+    // large mapped files are split across the loader pool
+    if(split && source.isMapped() && source.size() >= parallel_threshold) {
+        if(!parseParallel(source.data(), path, attribs, corners,
+                    current_indices, current_materials, libraries)) {
+            return false;
+        }
+    }
+    else if(!parseSerial(source, path, attribs, corners, current_indices,
+                current_materials, libraries)) {
+        return false;
+    }
+
+    // the corners index into the attribute arrays rather than the file, so
+    // the mapping can be released before the vertices are built
+    source.close();
+
+    std::vector<Vertex> current_vertices;
+    buildVertices(attribs, corners, current_indices, current_vertices);
+
+    glm::vec3 bounds_min(0.0f);
+    glm::vec3 bounds_max(0.0f);
+    if(!current_vertices.empty()) {
+        bounds_min = bounds_max = current_vertices[0].position;
+    }
+    for(Vertex const &v : current_vertices) {
+        bounds_min = glm::min(bounds_min, v.position);
+        bounds_max = glm::max(bounds_max, v.position);
+    }
+
+    if(verbose.load(std::memory_order_relaxed)) {
+        auto parse_time = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start_time).count();
+        double megabytes = file_size / (1024.0 * 1024.0);
+        std::fprintf(stderr, "Parsed %s: %.2f MB in %.2f ms (%.1f MB/s)\n",
+                path.c_str(), megabytes, parse_time * 1000.0,
+                parse_time > 0.0 ? megabytes / parse_time : 0.0);
+
+        // every corner used to be its own vertex
+        std::fprintf(stderr,
+                "Deduplicated %s: %zu -> %zu vertices (%.2f -> %.2f MB)\n",
+                path.c_str(), corners.size(), current_vertices.size(),
+                corners.size() * sizeof(Vertex) / (1024.0 * 1024.0),
+                current_vertices.size() * sizeof(Vertex) / (1024.0 * 1024.0));
+    }
+
+    data.vertices = std::move(current_vertices);
+    data.indices = std::move(current_indices);
+    data.materials = std::move(current_materials);
+    data.material_libraries = std::move(libraries);
+    data.bounds_min = bounds_min;
+    data.bounds_max = bounds_max;
+
+    return true;
+}
+
+bool loadObj(std::vector<Mesh> &meshes, std::string path) {
+    MeshData data;
+    if(!parseObj(data, path)) {
+        return false;
+    }
+
+    loadTextures(data.materials);
+
     Mesh m;
-    m.create(current_vertices, current_indices, current_materials);
-    meshes.push_back(m);
+    m.create(std::move(data.vertices), std::move(data.indices),
+            std::move(data.materials));
+    m.setBounds(data.bounds_min, data.bounds_max);
+    meshes.push_back(std::move(m));
 
     return true;
 }
@@ -301,45 +780,40 @@ bool loadObj(std::vector<Mesh> &meshes, std::string path) {
 bool loadMtl(std::vector<Material> &materials, std::string path) {
     // ensure that the given file is an material file
     // assume it is if it ends in .mtl
-    if(path.substr(path.size() - 4, 4) != ".mtl") {
+    if(path.size() < 4 || path.substr(path.size() - 4, 4) != ".mtl") {
         std::fprintf(stderr, "File %s is not a material file\n", path.c_str());
         return false;
     }
 
-    std::ifstream model_file(path);
-
-    // ensure the model file exists
-    if(!model_file.is_open()) {
+    // ensure the material file exists
+    FileSource source;
+    if(!source.open(path)) {
         std::fprintf(stderr, "File %s does not exist\n", path.c_str());
         return false;
     }
 
-    Material current_material;
+    Material current_material = {};
     current_material.name = "*";
     current_material.shininess = 0.0f;
 
-    std::string line;
-    while(std::getline(model_file, line)) {
+    for(std::string_view line : source.lines()) {
+        char const *cur = line.data();
+        char const *eol = line.data() + line.size();
+
         // get the line type, (AKA the first word of the line)
-        int type_len;
-        for(type_len = 0; line[type_len] != ' ' && line[type_len] != '\n' &&
-                line[type_len] != '\0'; type_len++);
-        std::string type = line.substr(0, type_len);
+        std::string_view type = nextToken(cur, eol);
 
         if(type == "newmtl") {
             if(current_material.name != "*") {
                 materials.push_back(current_material);
             }
-            std::vector<std::string> name;
-            parseLineStrings(name, line);
-            current_material.name = name[0];
+            current_material.name = nextToken(cur, eol);
         }
 
         else if(type == "map_Kd") {
-            std::vector<std::string> name;
-            parseLineStrings(name, line);
-            std::string folder = path.substr(0, path.rfind('/') + 1); 
-            current_material.diffuse.create(folder + name[0]);
+            std::string_view name = nextToken(cur, eol);
+            std::string folder = path.substr(0, path.rfind('/') + 1);
+            current_material.diffuse_map = folder + std::string(name);
         }
     }
 
@@ -347,4 +821,35 @@ bool loadMtl(std::vector<Material> &materials, std::string path) {
 
     return true;
 }
+
+void loadTextures(std::vector<Material> &materials) {
+    // materials used more than once share their textures
+    std::unordered_map<std::string, Texture> loaded;
+    TextureLoader *loader = TextureLoader::current();
+    TextureRegistry *registry = TextureRegistry::current();
+
+    for(Material &material : materials) {
+        if(material.diffuse_map.empty()) {
+            continue;
+        }
+
+        // the registry shares textures across every model, not just this one
+        if(registry) {
+            material.diffuse_handle = registry->acquire(material.diffuse_map);
+            if(material.diffuse_handle.id != Handle::invalid) {
+                material.diffuse = (*registry)[material.diffuse_handle];
+            }
+            continue;
+        }
+
+        auto [it, inserted] = loaded.try_emplace(material.diffuse_map);
+        if(inserted && loader) {
+            loader->load(it->second, material.diffuse_map);
+        }
+        else if(inserted) {
+            it->second.create(material.diffuse_map);
+        }
+        material.diffuse = it->second;
+    }
+}
 };
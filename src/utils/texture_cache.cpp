@@ -0,0 +1,284 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "graphics/texture.h"
+
+#include "utils/asset_stamp.h"
+#include "utils/block_compress.h"
+#include "utils/file_source.h"
+#include "utils/image.h"
+#include "utils/texture_cache.h"
+
+namespace texture_cache {
+
+static constexpr char magic[4] = { 'L', 'G', 'T', 'X' };
+static constexpr uint32_t version = 2;
+
+// enough for a 65536 x 65536 texture
+static constexpr uint32_t max_levels = 17;
+
+/**
+ * The start of every cooked texture, followed by a table of its levels.
+ * Everything is stored in native byte order.
+ */
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_levels;
+
+    // a TextureFormat, rgba8 or one of the block compressed formats
+    uint32_t format;
+
+    // the source image the texture was cooked from
+    AssetStamp source;
+};
+
+/**
+ * Where one mip level lives within the file
+ */
+struct LevelEntry {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+};
+
+static bool validHeader(Header const &header) {
+    return std::memcmp(header.magic, magic, sizeof(magic)) == 0
+        && header.version == version
+        && header.num_levels > 0
+        && header.num_levels <= max_levels
+        && header.format <= (uint32_t) TextureFormat::bc7;
+}
+
+static void rewriteHeader(std::string const &path, Header const &header) {
+    std::FILE *file = std::fopen(path.c_str(), "r+b");
+    if(file) {
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fclose(file);
+    }
+}
+
+std::string cachePath(std::string const &source_path) {
+    return source_path + ".texcache";
+}
+
+bool isFresh(std::string const &source_path) {
+    std::string path = cachePath(source_path);
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if(!file) {
+        return false;
+    }
+
+    Header header;
+    bool read = std::fread(&header, sizeof(header), 1, file) == 1;
+    std::fclose(file);
+
+    bool touched;
+    if(!read || !validHeader(header)
+            || !header.source.matches(source_path, touched)) {
+        return false;
+    }
+
+    if(touched) {
+        rewriteHeader(path, header);
+    }
+
+    return true;
+}
+
+size_t residentSize(std::string const &source_path) {
+    if(!isFresh(source_path)) {
+        return 0;
+    }
+
+    std::string path = cachePath(source_path);
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if(!file) {
+        return 0;
+    }
+
+    Header header;
+    LevelEntry table[max_levels];
+    bool read = std::fread(&header, sizeof(header), 1, file) == 1
+        && validHeader(header)
+        && std::fread(table, sizeof(LevelEntry), header.num_levels, file)
+            == header.num_levels;
+    std::fclose(file);
+
+    if(!read) {
+        return 0;
+    }
+
+    size_t size = 0;
+    for(uint32_t i = 0; i < header.num_levels; i++) {
+        size += block_compress::levelSize((TextureFormat) header.format,
+                table[i].width, table[i].height);
+    }
+    return size;
+}
+
+/**
+ * Maps a cooked texture and points each level's pixels into the mapping
+ * @param source the file source to map the cooked texture with
+ * @param path the path to the cooked texture
+ * @param levels the destination for the levels, max_levels long
+ * @param num_levels the destination for the number of levels
+ * @param format the destination for the format of the levels
+ * @return whether or not the cooked texture was valid
+ */
+static bool mapLevels(FileSource &source, std::string const &path,
+        TextureLevel *levels, uint32_t &num_levels, TextureFormat &format) {
+    if(!source.open(path) || !source.isMapped()) {
+        return false;
+    }
+
+    std::string_view file = source.data();
+    if(file.size() < sizeof(Header)) {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(!validHeader(header)) {
+        return false;
+    }
+
+    if(file.size() < sizeof(Header) + header.num_levels * sizeof(LevelEntry)) {
+        std::fprintf(stderr, "Cooked texture %s is corrupt\n", path.c_str());
+        return false;
+    }
+
+    char const *table = file.data() + sizeof(Header);
+    for(uint32_t i = 0; i < header.num_levels; i++) {
+        LevelEntry entry;
+        std::memcpy(&entry, table + i * sizeof(LevelEntry), sizeof(entry));
+
+        uint64_t size = block_compress::levelSize(
+                (TextureFormat) header.format, entry.width, entry.height);
+        if(entry.offset > file.size() || size > file.size() - entry.offset) {
+            std::fprintf(stderr, "Cooked texture %s is corrupt\n",
+                    path.c_str());
+            return false;
+        }
+
+        levels[i].width = entry.width;
+        levels[i].height = entry.height;
+        levels[i].pixels = (unsigned char const *) file.data() + entry.offset;
+    }
+
+    num_levels = header.num_levels;
+    format = (TextureFormat) header.format;
+
+    return true;
+}
+
+bool load(Texture &texture, std::string const &source_path) {
+    if(!isFresh(source_path)) {
+        return false;
+    }
+
+    // upload straight out of the mapping
+    FileSource source;
+    TextureLevel levels[max_levels];
+    uint32_t num_levels;
+    TextureFormat format;
+    if(!mapLevels(source, cachePath(source_path), levels, num_levels,
+                format)) {
+        return false;
+    }
+
+    texture.create(levels, num_levels, format);
+
+    return true;
+}
+
+bool read(std::vector<Image> &levels, TextureFormat &format,
+        std::string const &source_path) {
+    if(!isFresh(source_path)) {
+        return false;
+    }
+
+    FileSource source;
+    TextureLevel mapped[max_levels];
+    uint32_t num_levels;
+    if(!mapLevels(source, cachePath(source_path), mapped, num_levels,
+                format)) {
+        return false;
+    }
+
+    levels.resize(num_levels);
+    for(uint32_t i = 0; i < num_levels; i++) {
+        levels[i].width = mapped[i].width;
+        levels[i].height = mapped[i].height;
+        levels[i].pixels.assign(mapped[i].pixels,
+                mapped[i].pixels + block_compress::levelSize(format,
+                    mapped[i].width, mapped[i].height));
+    }
+
+    return true;
+}
+
+bool save(std::vector<Image> const &levels, TextureFormat format,
+        std::string const &source_path) {
+    if(levels.empty() || levels.size() > max_levels) {
+        return false;
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.num_levels = levels.size();
+    header.format = (uint32_t) format;
+
+    if(!header.source.create(source_path)) {
+        return false;
+    }
+
+    std::vector<LevelEntry> table(levels.size());
+    uint64_t offset = sizeof(Header) + table.size() * sizeof(LevelEntry);
+    for(size_t i = 0; i < levels.size(); i++) {
+        table[i].width = levels[i].width;
+        table[i].height = levels[i].height;
+        table[i].offset = offset;
+        offset += levels[i].pixels.size();
+    }
+
+    // write to the side and swap it in, so a crash never leaves a torn file
+    std::string path = cachePath(source_path);
+    std::string temp_path = path + ".tmp";
+    std::FILE *file = std::fopen(temp_path.c_str(), "wb");
+    if(!file) {
+        std::fprintf(stderr, "Failed to write cooked texture %s\n",
+                path.c_str());
+        return false;
+    }
+
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fwrite(table.data(), sizeof(LevelEntry), table.size(), file);
+    for(Image const &level : levels) {
+        std::fwrite(level.pixels.data(), 1, level.pixels.size(), file);
+    }
+
+    bool ok = !std::ferror(file);
+    ok = (std::fclose(file) == 0) && ok;
+
+    std::error_code ec;
+    if(ok) {
+        std::filesystem::rename(temp_path, path, ec);
+    }
+    if(!ok || ec) {
+        std::fprintf(stderr, "Failed to write cooked texture %s\n",
+                path.c_str());
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+};
@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "utils/triangulator.h"
+
+enum : unsigned char {
+    corner_reflex = 1 << 0,
+    corner_visited = 1 << 1,
+    // on the chain running down the left of its monotone piece
+    corner_left = 1 << 2
+};
+
+/**
+ * What the sweep does at a corner, by where its neighbours are
+ */
+enum CornerKind : unsigned char {
+    // both below: a piece starts here, or the piece around it is split
+    corner_start,
+    corner_split,
+    // both above: a piece ends here, or the pieces either side merge
+    corner_end,
+    corner_merge,
+    // one above and one below
+    corner_regular
+};
+
+/**
+ * Projects the polygon onto the axis plane it is most aligned with, mirrored
+ * if needed so that it winds counter-clockwise
+ * @param polygon the corner positions of the polygon
+ */
+void Triangulator::project(std::vector<glm::vec3> const &polygon) {
+    size_t n = polygon.size();
+
+    // newell's method, robust for non-planar and non-convex polygons
+    glm::vec3 normal(0.0f);
+    for(size_t i = 0; i < n; i++) {
+        glm::vec3 const &a = polygon[i];
+        glm::vec3 const &b = polygon[i + 1 == n ? 0 : i + 1];
+        normal.x += (a.y - b.y) * (a.z + b.z);
+        normal.y += (a.z - b.z) * (a.x + b.x);
+        normal.z += (a.x - b.x) * (a.y + b.y);
+    }
+
+    glm::vec3 mag = glm::abs(normal);
+    int u, v;
+    float sign;
+    if(mag.x >= mag.y && mag.x >= mag.z) {
+        u = 1; v = 2; sign = normal.x;
+    }
+    else if(mag.y >= mag.z) {
+        u = 2; v = 0; sign = normal.y;
+    }
+    else {
+        u = 0; v = 1; sign = normal.z;
+    }
+
+    // facing away from the dropped axis, so swap the axes to flip the winding
+    if(sign < 0.0f) {
+        std::swap(u, v);
+    }
+
+    points.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        points[i] = glm::vec2(polygon[i][u], polygon[i][v]);
+    }
+}
+
+/**
+ * @return twice the signed area of the triangle abc, positive if it turns left
+ */
+float Triangulator::turn(unsigned int a, unsigned int b,
+        unsigned int c) const {
+    glm::vec2 ab = points[b] - points[a];
+    glm::vec2 bc = points[c] - points[b];
+    return ab.x * bc.y - ab.y * bc.x;
+}
+
+
+/**
+ * @return whether corner a comes before corner b in the sweep, which runs
+ *         from top to bottom and left to right along a level
+ */
+bool Triangulator::above(unsigned int a, unsigned int b) const {
+    return points[a].y > points[b].y
+        || (points[a].y == points[b].y && points[a].x < points[b].x);
+}
+
+/**
+ * @return twice the signed area of the triangle abc, positive if c lies to
+ *         the left of the line from a to b
+ */
+static float side(glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    glm::vec2 ab = b - a;
+    glm::vec2 ac = c - a;
+    return ab.x * ac.y - ab.y * ac.x;
+}
+
+bool Triangulator::Edge::operator<(Edge const &other) const {
+    // the edge the sweep reached last is placed by which side of the other
+    // edge its top lies on. Edges run downwards, so their left is east.
+    if(top.y > other.top.y || (top.y == other.top.y && top.x <= other.top.x)) {
+        return side(top, bottom, other.top) > 0.0f;
+    }
+    return side(other.top, other.bottom, top) < 0.0f;
+}
+
+/**
+ * Splits a piece of the polygon along the diagonal between two of its
+ * corners. Both corners are copied, each copy taking over the edge leaving
+ * its corner, so that the two pieces are separate linked lists.
+ * @param a the corner the diagonal starts at
+ * @param b the corner it ends at
+ * @return the copy of a, which leads on to a's old neighbour
+ */
+unsigned int Triangulator::addDiagonal(unsigned int a, unsigned int b) {
+    unsigned int a_copy = points.size();
+    unsigned int b_copy = a_copy + 1;
+
+    for(unsigned int corner : { a, b }) {
+        unsigned int copy = points.size();
+        points.push_back(points[corner]);
+        source.push_back(source[corner]);
+        flags.push_back(flags[corner]);
+        kinds.push_back(kinds[corner]);
+        helper.push_back(helper[corner]);
+        status_edge.push_back(status_edge[corner]);
+        prev.push_back(corner);
+        next.push_back(next[corner]);
+        prev[next[corner]] = copy;
+
+        if(status_edge[corner] != status.end()) {
+            status_edge[corner]->corner = copy;
+            status_edge[corner] = status.end();
+        }
+    }
+
+    next[a] = b_copy;
+    prev[b_copy] = a;
+    next[b] = a_copy;
+    prev[a_copy] = b;
+    return a_copy;
+}
+
+/**
+ * Adds the edge leaving a corner to the sweep line, helped by the corner
+ */
+void Triangulator::insertEdge(unsigned int corner) {
+    status_edge[corner]
+        = status.insert(Edge{ points[corner], points[next[corner]], corner });
+    helper[corner] = corner;
+}
+
+/**
+ * Removes the edge arriving at a corner from the sweep line, first joining
+ * the corner to the edge's helper if that is a merge corner
+ * @return the copy of the corner now leading on to its next neighbour
+ */
+unsigned int Triangulator::closeEdge(unsigned int corner) {
+    auto edge = status_edge[prev[corner]];
+    if(edge == status.end()) {
+        // only for self intersecting polygons
+        return corner;
+    }
+
+    unsigned int copy = corner;
+    if(kinds[helper[edge->corner]] == corner_merge) {
+        copy = addDiagonal(corner, helper[edge->corner]);
+    }
+    status_edge[edge->corner] = status.end();
+    status.erase(edge);
+    return copy;
+}
+
+/**
+ * @return the edge on the sweep line directly left of a corner, or the end
+ *         of the sweep line if there is none
+ */
+std::pmr::multiset<Triangulator::Edge>::iterator Triangulator::edgeLeftOf(
+        unsigned int corner) {
+    auto right = status.lower_bound(
+        Edge{ points[corner], points[corner], corner });
+    return right == status.begin() ? status.end() : std::prev(right);
+}
+
+/**
+ * Sweeps down the polygon, adding diagonals at the split and merge corners,
+ * which leaves pieces with no corner that has both neighbours on the same
+ * side of it. Each diagonal joins the corner to the helper of the edge on
+ * its left: the lowest corner passed so far between that edge and the next.
+ */
+void Triangulator::splitMonotone() {
+    for(unsigned int corner : order) {
+        switch(kinds[corner]) {
+        case corner_start:
+            insertEdge(corner);
+            break;
+
+        case corner_end:
+            closeEdge(corner);
+            break;
+
+        case corner_split: {
+            auto left = edgeLeftOf(corner);
+            if(left == status.end()) {
+                insertEdge(corner);
+                break;
+            }
+            unsigned int copy = addDiagonal(corner, helper[left->corner]);
+            helper[left->corner] = corner;
+            insertEdge(copy);
+            break;
+        }
+
+        case corner_merge: {
+            unsigned int copy = closeEdge(corner);
+            auto left = edgeLeftOf(corner);
+            if(left == status.end()) {
+                break;
+            }
+            if(kinds[helper[left->corner]] == corner_merge) {
+                addDiagonal(copy, helper[left->corner]);
+            }
+            helper[left->corner] = copy;
+            break;
+        }
+
+        case corner_regular: {
+            // on the left side of the polygon, with the inside to the right
+            if(above(prev[corner], corner)) {
+                insertEdge(closeEdge(corner));
+                break;
+            }
+
+            auto left = edgeLeftOf(corner);
+            if(left == status.end()) {
+                break;
+            }
+            if(kinds[helper[left->corner]] == corner_merge) {
+                addDiagonal(corner, helper[left->corner]);
+            }
+            helper[left->corner] = corner;
+            break;
+        }
+        }
+    }
+}
+
+/**
+ * Triangulates one monotone piece, going down it a corner at a time from
+ * whichever chain is next. The corners passed that still need triangles
+ * are kept on a stack, and form a concave chain that each new corner cuts
+ * triangles off for as long as it can see past them.
+ * @param first any corner of the piece
+ * @param offset added to every emitted index
+ * @param indices the destination index array
+ */
+void Triangulator::triangulateMonotone(unsigned int first,
+        unsigned int offset, std::vector<unsigned int> &indices) {
+    unsigned int top = first;
+    unsigned int bottom = first;
+    size_t count = 0;
+    unsigned int corner = first;
+    do {
+        flags[corner] |= corner_visited;
+        if(above(corner, top)) {
+            top = corner;
+        }
+        if(above(bottom, corner)) {
+            bottom = corner;
+        }
+        count++;
+        corner = next[corner];
+    } while(corner != first);
+
+    if(count < 3) {
+        return;
+    }
+    // every corner in the same place
+    if(top == bottom) {
+        bottom = prev[top];
+    }
+
+    // merge the chains, the left one running forwards from the top since
+    // the polygon winds counter-clockwise
+    sorted.clear();
+    sorted.push_back(top);
+    flags[top] |= corner_left;
+    unsigned int left = next[top];
+    unsigned int right = prev[top];
+    while(left != bottom || right != bottom) {
+        if(right == bottom || (left != bottom && above(left, right))) {
+            flags[left] |= corner_left;
+            sorted.push_back(left);
+            left = next[left];
+        }
+        else {
+            flags[right] &= ~corner_left;
+            sorted.push_back(right);
+            right = prev[right];
+        }
+    }
+    sorted.push_back(bottom);
+
+    auto emit = [&](unsigned int a, unsigned int b, unsigned int c) {
+        indices.push_back(offset + source[a]);
+        indices.push_back(offset + source[b]);
+        indices.push_back(offset + source[c]);
+    };
+
+    // a corner on the other chain from the stack sees all of it
+    auto fanStack = [&](unsigned int corner, bool on_left) {
+        for(size_t i = 0; i + 1 < stack.size(); i++) {
+            if(on_left) {
+                emit(corner, stack[i + 1], stack[i]);
+            }
+            else {
+                emit(corner, stack[i], stack[i + 1]);
+            }
+        }
+    };
+
+    stack.clear();
+    stack.push_back(sorted[0]);
+    stack.push_back(sorted[1]);
+    for(size_t i = 2; i + 1 < sorted.size(); i++) {
+        unsigned int corner = sorted[i];
+        bool on_left = flags[corner] & corner_left;
+
+        if(on_left != (bool) (flags[stack.back()] & corner_left)) {
+            fanStack(corner, on_left);
+            unsigned int last = stack.back();
+            stack.clear();
+            stack.push_back(last);
+            stack.push_back(corner);
+            continue;
+        }
+
+        // on the same chain, cut off triangles while the stack turns away
+        // from the inside
+        unsigned int last = stack.back();
+        stack.pop_back();
+        while(!stack.empty()) {
+            unsigned int top = stack.back();
+            float t = turn(top, last, corner);
+            if(on_left ? t <= 0.0f : t >= 0.0f) {
+                break;
+            }
+            if(on_left) {
+                emit(top, last, corner);
+            }
+            else {
+                emit(corner, last, top);
+            }
+            last = top;
+            stack.pop_back();
+        }
+        stack.push_back(last);
+        stack.push_back(corner);
+    }
+
+    // the bottom corner is on both chains, so sees the whole stack
+    fanStack(bottom, !(flags[stack.back()] & corner_left));
+}
+
+/**
+ * Fans a polygon out from its first corner
+ * @param n the number of corners
+ * @param offset added to every emitted index
+ * @param indices the destination index array
+ */
+static void fan(size_t n, unsigned int offset,
+        std::vector<unsigned int> &indices) {
+    for(size_t i = 1; i + 1 < n; i++) {
+        indices.push_back(offset);
+        indices.push_back(offset + i);
+        indices.push_back(offset + i + 1);
+    }
+}
+
+void Triangulator::triangulate(std::vector<glm::vec3> const &polygon,
+        unsigned int offset, std::vector<unsigned int> &indices) {
+    size_t n = polygon.size();
+
+    if(n < 3) {
+        return;
+    }
+
+    if(n == 3) {
+        indices.push_back(offset);
+        indices.push_back(offset + 1);
+        indices.push_back(offset + 2);
+        return;
+    }
+
+    project(polygon);
+
+    prev.resize(n);
+    next.resize(n);
+    flags.resize(n);
+
+    bool convex = true;
+    for(size_t i = 0; i < n; i++) {
+        prev[i] = (i == 0) ? n - 1 : i - 1;
+        next[i] = (i == n - 1) ? 0 : i + 1;
+        flags[i] = 0;
+        if(turn(prev[i], i, next[i]) <= 0.0f) {
+            flags[i] = corner_reflex;
+            convex = false;
+        }
+    }
+
+    // convex polygons (most quads) can just be fanned
+    if(convex) {
+        fan(n, offset, indices);
+        return;
+    }
+
+    source.resize(n);
+    kinds.resize(n);
+    helper.resize(n);
+    order.resize(n);
+    status.clear();
+    status_edge.assign(n, status.end());
+    for(size_t i = 0; i < n; i++) {
+        source[i] = i;
+        order[i] = i;
+
+        bool prev_above = above(prev[i], i);
+        bool next_above = above(next[i], i);
+        bool reflex = flags[i] & corner_reflex;
+        if(!prev_above && !next_above) {
+            kinds[i] = reflex ? corner_split : corner_start;
+        }
+        else if(prev_above && next_above) {
+            kinds[i] = reflex ? corner_merge : corner_end;
+        }
+        else {
+            kinds[i] = corner_regular;
+        }
+    }
+
+    std::sort(order.begin(), order.end(),
+        [this](unsigned int a, unsigned int b) { return above(a, b); });
+
+    splitMonotone();
+
+    // the diagonals added copies of corners, each in its own piece
+    size_t start = indices.size();
+    for(size_t i = 0; i < points.size(); i++) {
+        if(!(flags[i] & corner_visited)) {
+            triangulateMonotone(i, offset, indices);
+        }
+    }
+
+    // a self intersecting polygon can leave pieces that are not monotone,
+    // which is fanned instead so that it at least leaves no hole
+    if(indices.size() - start != 3 * (n - 2)) {
+        indices.resize(start);
+        fan(n, offset, indices);
+    }
+}
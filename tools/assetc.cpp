@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <initializer_list>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "graphics/mesh.h"
+
+#include "threading/thread.h"
+
+#include "utils/block_compress.h"
+#include "utils/image.h"
+#include "utils/mesh_cache.h"
+#include "utils/mesh_simplify.h"
+#include "utils/mipmap.h"
+#include "utils/obj_loader.h"
+#include "utils/texture_cache.h"
+
+// Offline asset cooker.
+// Walks an asset tree and writes engine-native copies of every asset next to
+// its source: OBJ files are parsed, triangulated, deduplicated and simplified
+// into levels of detail in .meshcache files, and images are decoded into
+// .texcache files holding their full mip chain, filtered with a Kaiser window
+// in linear light and block compressed: BC1 for opaque images, BC3 for images
+// with alpha, or BC7 for everything with --quality. Model::create and
+// Texture::create pick these up at runtime instead of parsing and decoding.
+// Assets whose cooked copy is up to date (by size and mtime, falling back to
+// a content hash) are skipped, so a rerun only cooks what changed.
+
+enum class AssetKind { mesh, texture };
+
+struct Asset {
+    AssetKind kind;
+    std::string path;
+};
+
+struct Options {
+    bool force = false;
+
+    // whether or not to block compress textures
+    bool compress = true;
+
+    // whether or not to use BC7 for every compressed texture
+    bool quality = false;
+};
+
+struct Totals {
+    std::atomic<unsigned> cooked{0};
+    std::atomic<unsigned> fresh{0};
+    std::atomic<unsigned> failed{0};
+};
+
+static bool hasExtension(std::filesystem::path const &path,
+        std::initializer_list<char const *> extensions) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+            [](unsigned char c) { return std::tolower(c); });
+    for(char const *e : extensions) {
+        if(ext == e) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Finds every cookable asset under a directory
+ * @param root the directory to search
+ * @param assets the destination for the assets found
+ */
+static void findAssets(std::string const &root, std::vector<Asset> &assets) {
+    for(auto const &entry
+            : std::filesystem::recursive_directory_iterator(root)) {
+        if(!entry.is_regular_file()) {
+            continue;
+        }
+
+        // forward slashes, since the loaders find sibling files with them
+        std::string path = entry.path().generic_string();
+        if(hasExtension(entry.path(), { ".obj" })) {
+            assets.push_back(Asset{ AssetKind::mesh, path });
+        }
+        else if(hasExtension(entry.path(),
+                    { ".png", ".jpg", ".jpeg", ".tga", ".bmp" })) {
+            assets.push_back(Asset{ AssetKind::texture, path });
+        }
+    }
+}
+
+static bool cookMesh(std::string const &path) {
+    MeshData data;
+    if(!obj_loader::parseObj(data, path)) {
+        return false;
+    }
+
+    mesh_simplify::buildLods(data);
+    return mesh_cache::save(data, path);
+}
+
+static bool cookTexture(std::string const &path, Options const &options) {
+    std::vector<Image> levels(1);
+    if(!levels[0].create(path)) {
+        std::fprintf(stderr, "Failed to decode %s\n", path.c_str());
+        return false;
+    }
+
+    TextureFormat format = TextureFormat::rgba8;
+    if(options.quality) {
+        format = TextureFormat::bc7;
+    }
+    else if(options.compress) {
+        format = block_compress::hasAlpha(levels[0])
+            ? TextureFormat::bc3
+            : TextureFormat::bc1;
+    }
+
+    // cooking happens once, so spend the time on the sharper filter
+    mipmap::build(levels, mipmap::Filter::kaiser);
+
+    if(format != TextureFormat::rgba8) {
+        for(Image &level : levels) {
+            Image blocks;
+            block_compress::encode(level, format, blocks);
+            level = std::move(blocks);
+        }
+    }
+
+    return texture_cache::save(levels, format, path);
+}
+
+/**
+ * Cooks one asset, unless its cooked copy is already up to date
+ * @param asset the asset to cook
+ * @param options how to cook it
+ * @param totals the counters to update
+ */
+static void cook(Asset const &asset, Options const &options, Totals &totals) {
+    bool fresh = asset.kind == AssetKind::mesh
+        ? mesh_cache::isFresh(asset.path)
+        : texture_cache::isFresh(asset.path);
+
+    if(fresh && !options.force) {
+        totals.fresh++;
+        return;
+    }
+
+    bool ok = asset.kind == AssetKind::mesh
+        ? cookMesh(asset.path)
+        : cookTexture(asset.path, options);
+
+    if(ok) {
+        std::fprintf(stderr, "Cooked %s\n", asset.path.c_str());
+        totals.cooked++;
+    }
+    else {
+        std::fprintf(stderr, "Failed to cook %s\n", asset.path.c_str());
+        totals.failed++;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string root = "assets";
+    Options options;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if(arg == "-f" || arg == "--force") {
+            options.force = true;
+        }
+        else if(arg == "-u" || arg == "--uncompressed") {
+            options.compress = false;
+        }
+        else if(arg == "-q" || arg == "--quality") {
+            options.quality = true;
+        }
+        else if(arg == "-v" || arg == "--verbose") {
+            obj_loader::setVerbose(true);
+        }
+        else if((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            jobs = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg[0] != '-') {
+            root = arg;
+        }
+        else {
+            std::fprintf(stderr,
+                    "usage: %s [-f|--force] [-u|--uncompressed] "
+                    "[-q|--quality] [-v|--verbose] [-j|--jobs n] "
+                    "[asset dir]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    std::error_code ec;
+    if(!std::filesystem::is_directory(root, ec)) {
+        std::fprintf(stderr, "Asset directory %s does not exist\n",
+                root.c_str());
+        return 1;
+    }
+
+    std::vector<Asset> assets;
+    findAssets(root, assets);
+
+    // one task per asset, the pool hands them out as workers free up. It is
+    // declared last so its threads are joined before what the tasks use goes.
+    Totals totals;
+    std::latch done(assets.size());
+    ThreadPool pool(jobs);
+    for(Asset const &asset : assets) {
+        pool.run([&asset, &options, &totals, &done]() {
+            cook(asset, options, totals);
+            done.count_down();
+        });
+    }
+    done.wait();
+
+    std::fprintf(stderr, "%u cooked, %u up to date, %u failed\n",
+            totals.cooked.load(), totals.fresh.load(), totals.failed.load());
+
+    return totals.failed > 0 ? 1 : 0;
+}
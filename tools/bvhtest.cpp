@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+
+#include "graphics/bvh.h"
+
+// Bvh raycast check.
+// Casts rays through a scatter of boxes, both before and after the tree is
+// rebuilt, and checks each hit against testing every box in turn. Rays are
+// cast with an infinite reach and with short ones, and some are aimed away
+// from every box, which must come back as no hit whatever the reach.
+
+struct Box {
+    glm::vec3 min, max;
+};
+
+/**
+ * Tests one box the straightforward way
+ * @return how far along the ray it enters the box, or infinity if it misses
+ */
+static float enter(Box const &box, glm::vec3 const &origin,
+        glm::vec3 const &direction) {
+    float near = 0.0f;
+    float far = std::numeric_limits<float>::infinity();
+    for(int axis = 0; axis < 3; axis++) {
+        // by the inverse, as the tree does, so the distances match exactly
+        float inv = 1.0f / direction[axis];
+        float t0 = (box.min[axis] - origin[axis]) * inv;
+        float t1 = (box.max[axis] - origin[axis]) * inv;
+        near = std::max(near, std::min(t0, t1));
+        far = std::min(far, std::max(t0, t1));
+    }
+    return near <= far ? near : std::numeric_limits<float>::infinity();
+}
+
+/**
+ * Casts a ray through the tree and through every box
+ * @return whether or not the two agree on the nearest box
+ */
+static bool checkRay(Bvh const &bvh, std::vector<Box> const &boxes,
+        glm::vec3 const &origin, glm::vec3 const &direction,
+        float max_distance) {
+    float expected = std::numeric_limits<float>::infinity();
+    for(Box const &box : boxes) {
+        float t = enter(box, origin, direction);
+        if(t <= max_distance) {
+            expected = std::min(expected, t);
+        }
+    }
+
+    float distance = -1.0f;
+    int proxy = bvh.raycast(origin, direction, max_distance, distance);
+    if(std::isinf(expected)) {
+        if(proxy == Bvh::null) {
+            return true;
+        }
+        std::fprintf(stderr, "ray hit box %d at %g, expected a miss\n",
+                proxy, distance);
+        return false;
+    }
+
+    if(proxy == Bvh::null || distance != expected
+            || enter(boxes[proxy], origin, direction) != expected) {
+        std::fprintf(stderr, "ray hit box %d at %g, expected a box at %g\n",
+                proxy, distance, expected);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Casts a set of rays at every reach
+ * @return the number of rays that disagreed
+ */
+static int checkRays(Bvh const &bvh, std::vector<Box> const &boxes,
+        std::mt19937 &rng, int count, int &hits) {
+    std::uniform_real_distribution<float> position(-80.0f, 80.0f);
+    std::normal_distribution<float> axis(0.0f, 1.0f);
+    float const reaches[] = { std::numeric_limits<float>::infinity(), 40.0f,
+        10.0f };
+
+    int failures = 0;
+    for(int i = 0; i < count; i++) {
+        glm::vec3 origin(position(rng), position(rng), position(rng));
+        glm::vec3 direction(axis(rng), axis(rng), axis(rng));
+
+        for(float reach : reaches) {
+            failures += checkRay(bvh, boxes, origin, direction, reach) ? 0 : 1;
+            float distance;
+            hits += bvh.raycast(origin, direction, reach, distance)
+                != Bvh::null;
+        }
+    }
+
+    // from outside the scatter, straight away from it
+    for(int i = 0; i < count / 10; i++) {
+        glm::vec3 direction = glm::normalize(glm::vec3(axis(rng), axis(rng),
+                    axis(rng)));
+        glm::vec3 origin = direction * 100.0f;
+        for(float reach : reaches) {
+            failures += checkRay(bvh, boxes, origin, direction, reach) ? 0 : 1;
+        }
+    }
+    return failures;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    Bvh bvh;
+    std::vector<Box> boxes;
+
+    float distance;
+    bool ok = bvh.raycast(glm::vec3(0.0f), glm::vec3(1.0f),
+            std::numeric_limits<float>::infinity(), distance) == Bvh::null;
+    if(!ok) {
+        std::fprintf(stderr, "a ray hit an empty tree\n");
+    }
+
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.1f, 3.0f);
+    for(int i = 0; i < 2000; i++) {
+        glm::vec3 center(position(rng), position(rng), position(rng));
+        glm::vec3 extent(size(rng), size(rng), size(rng));
+        Box box = { center - extent, center + extent };
+        int proxy = bvh.insert(box.min, box.max);
+        boxes.resize(std::max<size_t>(boxes.size(), proxy + 1));
+        boxes[proxy] = box;
+    }
+
+    int hits = 0;
+    int failures = checkRays(bvh, boxes, rng, 2000, hits);
+    bvh.rebuild();
+    failures += checkRays(bvh, boxes, rng, 2000, hits);
+
+    std::printf("%d rays hit, %d disagreed\n", hits, failures);
+    return ok && failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/bvh.h"
+#include "graphics/camera.h"
+#include "graphics/culling.h"
+
+// Frustum culling benchmark.
+// Scatters boxes over a large level around a camera, the way an outdoor level
+// leaves most objects off screen, and times culling them all against the
+// camera's frustum, checking the result against a plain per box test. Then
+// times building a Bvh over the same boxes and querying it, which only visits
+// the part of the level near the frustum.
+
+/**
+ * Tests one box the straightforward way, plane by plane
+ * @return whether or not box i may be visible
+ */
+static bool reference(glm::vec4 const planes[6], culling::BoxList const &boxes,
+        size_t i) {
+    for(int p = 0; p < 6; p++) {
+        glm::vec4 const &plane = planes[p];
+        float distance = plane.x * boxes.center_x[i]
+            + plane.y * boxes.center_y[i]
+            + plane.z * boxes.center_z[i] + plane.w;
+        float radius = std::fabs(plane.x) * boxes.extent_x[i]
+            + std::fabs(plane.y) * boxes.extent_y[i]
+            + std::fabs(plane.z) * boxes.extent_z[i];
+        if(distance + radius < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int runs = 20;
+
+    Camera cam;
+    cam.init(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f), 45.0f, 16.0f / 9.0f);
+    cam.updateFrustum();
+
+    // a level 400 units across, the camera sees 100 units ahead
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    culling::BoxList boxes;
+    for(size_t i = 0; i < count; i++) {
+        boxes.push(glm::vec3(position(rng), position(rng) * 0.05f,
+                    position(rng)),
+                glm::vec3(size(rng), size(rng), size(rng)));
+    }
+
+    std::vector<uint8_t> visible(count);
+    size_t num_visible = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int run = 0; run < runs; run++) {
+        num_visible = culling::cull(cam.planes, boxes, visible.data());
+    }
+    auto end = std::chrono::steady_clock::now();
+    double cull_ms
+        = std::chrono::duration<double, std::milli>(end - start).count()
+        / runs;
+
+    size_t mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; i++) {
+        mismatches += reference(cam.planes, boxes, i) != (bool) visible[i];
+    }
+    end = std::chrono::steady_clock::now();
+    double reference_ms
+        = std::chrono::duration<double, std::milli>(end - start).count();
+
+    std::printf("%zu boxes, %zu visible\n", count, num_visible);
+    std::printf("culling::cull %.3f ms, per box reference %.3f ms\n",
+            cull_ms, reference_ms);
+    if(mismatches > 0) {
+        std::fprintf(stderr, "%zu boxes disagree with the reference\n",
+                mismatches);
+        return 1;
+    }
+
+    Bvh bvh;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; i++) {
+        glm::vec3 center(boxes.center_x[i], boxes.center_y[i],
+                boxes.center_z[i]);
+        glm::vec3 extent(boxes.extent_x[i], boxes.extent_y[i],
+                boxes.extent_z[i]);
+        bvh.insert(center - extent, center + extent);
+    }
+    end = std::chrono::steady_clock::now();
+    double insert_ms
+        = std::chrono::duration<double, std::milli>(end - start).count();
+
+    start = std::chrono::steady_clock::now();
+    bvh.rebuild();
+    end = std::chrono::steady_clock::now();
+    double build_ms
+        = std::chrono::duration<double, std::milli>(end - start).count();
+
+    std::vector<int> found;
+    start = std::chrono::steady_clock::now();
+    for(int run = 0; run < runs; run++) {
+        found.clear();
+        bvh.query(cam.planes, found);
+    }
+    end = std::chrono::steady_clock::now();
+    double query_ms
+        = std::chrono::duration<double, std::milli>(end - start).count()
+        / runs;
+
+    std::printf("Bvh inserted in %.3f ms, rebuilt in %.3f ms, "
+            "frustum query %.3f ms\n", insert_ms, build_ms, query_ms);
+    if(found.size() != num_visible) {
+        std::fprintf(stderr, "Bvh found %zu boxes, expected %zu\n",
+                found.size(), num_visible);
+        return 1;
+    }
+
+    return 0;
+}
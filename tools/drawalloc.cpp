@@ -0,0 +1,169 @@
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/vec3.hpp>
+
+#include "graphics/camera.h"
+#include "graphics/scene.h"
+#include "graphics/shader.h"
+#include "graphics/transform_hierarchy.h"
+
+#include "threading/thread.h"
+
+#include "recording_gl.h"
+#include "test_scene.h"
+
+// Per frame allocation check.
+// Replaces the global operator new with one that counts, then draws a scene
+// of a few hundred objects, some attached to others, through the recording
+// GL while the camera turns and a share of the objects move every frame.
+// The motion is run twice over: the first pass lets every vector on the
+// draw path grow to fit, and the second, which repeats it exactly, must not
+// allocate at all.
+
+static std::atomic<size_t> allocations = 0;
+
+static void *allocate(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// over-allocates and keeps malloc's pointer just below the aligned block,
+// since aligned_alloc is missing from the Windows C runtime
+static void *allocate(size_t size, std::align_val_t align) {
+    size_t alignment = (size_t) align;
+    char *base = (char *) allocate(size + alignment + sizeof(void *));
+    uintptr_t start = (uintptr_t) (base + sizeof(void *));
+    char *p = base + sizeof(void *)
+        + (alignment - start % alignment) % alignment;
+    ((void **) p)[-1] = base;
+    return p;
+}
+
+static void deallocate(void *p, std::align_val_t) {
+    if(p) {
+        std::free(((void **) p)[-1]);
+    }
+}
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, std::align_val_t align) {
+    return allocate(size, align);
+}
+void *operator new[](size_t size, std::align_val_t align) {
+    return allocate(size, align);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t align) noexcept {
+    deallocate(p, align);
+}
+void operator delete[](void *p, std::align_val_t align) noexcept {
+    deallocate(p, align);
+}
+void operator delete(void *p, size_t, std::align_val_t align) noexcept {
+    deallocate(p, align);
+}
+void operator delete[](void *p, size_t, std::align_val_t align) noexcept {
+    deallocate(p, align);
+}
+
+/**
+ * Draws a pass of frames, turning the camera and moving every fourth object
+ * the same way each pass
+ * @param movers the transforms to move
+ * @return the allocations made during the pass
+ */
+static size_t drawPass(Scene &scene, Camera &cam,
+        std::vector<int> const &movers, int frames) {
+    size_t before = allocations.load();
+    for(int frame = 0; frame < frames; frame++) {
+        float angle = 6.28318530718f * frame / frames;
+        cam.front = glm::vec3(std::sin(angle) * 0.5f, 0.0f, -1.0f);
+
+        for(size_t i = 0; i < movers.size(); i += 4) {
+            Transform local = scene.transforms.local(movers[i]);
+            local.position.y = 2.0f * std::sin(angle + i);
+            local.rotation
+                = glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f));
+            scene.transforms.setLocal(movers[i], local);
+        }
+
+        recording_gl::state.draws.clear();
+        scene.draw(cam);
+    }
+    return allocations.load() - before;
+}
+
+int main() {
+    recording_gl::install();
+
+    // a few threads to split the scene's systems across, standing in for
+    // the engine's job pool
+    ThreadPool workers(3);
+    Scene scene(workers);
+    scene.create();
+
+    Handle models[3] = {
+        scene.models.put("cube", makeModel(1, 100)),
+        scene.models.put("pair", makeModel(2, 101)),
+        scene.models.put("other cube", makeModel(1, 102)),
+    };
+    ShaderProgram shaders[2] = { makeShader(10), makeShader(11) };
+
+    // a field of objects ahead of the camera, every other one carrying a
+    // child of its own
+    std::vector<int> movers;
+    for(int i = 0; i < 256; i++) {
+        Transform local;
+        local.position = glm::vec3((i % 16) * 3.0f - 24.0f, 0.0f,
+                -10.0f - (i / 16) * 3.0f);
+        ecs::Entity entity = scene.addObject(models[i % 3], local,
+                shaders[i % 2]);
+        movers.push_back(scene.transformOf(entity));
+
+        if(i % 2 == 0) {
+            Transform child;
+            child.position = glm::vec3(0.0f, 1.5f, 0.0f);
+            scene.addObject(models[(i + 1) % 3], child, shaders[(i + 1) % 2],
+                    entity);
+        }
+    }
+
+    Camera cam;
+    cam.init(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f), 60.0f, 16.0f / 9.0f);
+
+    int const frames = 120;
+    size_t warm = drawPass(scene, cam, movers, frames);
+    size_t steady = drawPass(scene, cam, movers, frames);
+
+    std::printf("%d frames of %u draws, %u instances\n", frames,
+            scene.queue.stats.draw_calls, scene.queue.stats.instances);
+    std::printf("  %zu allocations while warming up, %zu after\n", warm,
+            steady);
+
+    scene.destroy();
+
+    if(steady != 0) {
+        std::fprintf(stderr, "Scene::draw allocated %.2f times a frame\n",
+                (double) steady / frames);
+        return 1;
+    }
+    std::printf("no allocations per frame\n");
+    return 0;
+}
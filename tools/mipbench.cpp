@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "utils/image.h"
+#include "utils/mipmap.h"
+
+// Mip chain benchmark.
+// Times building the full mip chain of random RGBA8 images from 64x64 up to
+// 4096x4096 with mipmap::build, for each filter in sRGB and in linear space.
+// The 8 bit, gamma incorrect box filter it replaced is timed alongside as the
+// baseline. glGenerateMipmap needs a GL context, which this does not create,
+// so the driver's side of the comparison is left to a profiler in the engine.
+
+/**
+ * The previous mip chain builder, kept as the baseline: a 2x2 average of the
+ * 8 bit values, each level from the quantized level above it
+ */
+static void baselineBuild(std::vector<Image> &levels) {
+    while(levels.back().width > 1 || levels.back().height > 1) {
+        Image const &src = levels.back();
+        Image dest;
+        dest.width = std::max(src.width / 2, 1);
+        dest.height = std::max(src.height / 2, 1);
+        dest.pixels.resize((size_t) dest.width * dest.height * 4);
+
+        for(int y = 0; y < dest.height; y++) {
+            int y0 = std::min(y * 2, src.height - 1);
+            int y1 = std::min(y * 2 + 1, src.height - 1);
+            unsigned char const *row0 = src.pixels.data()
+                + (size_t) y0 * src.width * 4;
+            unsigned char const *row1 = src.pixels.data()
+                + (size_t) y1 * src.width * 4;
+            unsigned char *out = dest.pixels.data()
+                + (size_t) y * dest.width * 4;
+
+            for(int x = 0; x < dest.width; x++) {
+                int x0 = std::min(x * 2, src.width - 1) * 4;
+                int x1 = std::min(x * 2 + 1, src.width - 1) * 4;
+                for(int c = 0; c < 4; c++) {
+                    int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c]
+                        + row1[x1 + c];
+                    out[x * 4 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+
+        levels.push_back(std::move(dest));
+    }
+}
+
+/**
+ * Times building a chain from a base image, best of a few runs
+ * @return the time in milliseconds
+ */
+template <typename Build>
+static double timeBuild(Image const &base, int runs, Build const &build) {
+    double best = 0.0;
+    std::vector<Image> levels;
+    for(int run = 0; run < runs; run++) {
+        levels.assign(1, base);
+        auto start = std::chrono::steady_clock::now();
+        build(levels);
+        auto end = std::chrono::steady_clock::now();
+        double ms
+            = std::chrono::duration<double, std::milli>(end - start).count();
+        if(run == 0 || ms < best) {
+            best = ms;
+        }
+
+        int expected = 1;
+        for(int size = std::max(base.width, base.height); size > 1;
+                size /= 2) {
+            expected++;
+        }
+        if((int) levels.size() != expected) {
+            std::fprintf(stderr, "%dx%d built %zu levels, expected %d\n",
+                    base.width, base.height, levels.size(), expected);
+            return -1.0;
+        }
+    }
+    return best;
+}
+
+int main() {
+    int const sizes[] = { 64, 256, 1024, 2048, 4096 };
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    std::printf("full chain, best of 5 runs, ms\n");
+    std::printf("%10s %13s %13s %13s %13s %13s\n", "size", "baseline",
+            "box sRGB", "box linear", "kaiser sRGB", "kaiser linear");
+    for(int size : sizes) {
+        Image base;
+        base.width = base.height = size;
+        base.pixels.resize((size_t) size * size * 4);
+        for(unsigned char &c : base.pixels) {
+            c = (unsigned char) byte(rng);
+        }
+
+        int runs = 5;
+        double times[5] = {
+            timeBuild(base, runs, baselineBuild),
+            timeBuild(base, runs, [](std::vector<Image> &levels) {
+                mipmap::build(levels, mipmap::Filter::box, true);
+            }),
+            timeBuild(base, runs, [](std::vector<Image> &levels) {
+                mipmap::build(levels, mipmap::Filter::box, false);
+            }),
+            timeBuild(base, runs, [](std::vector<Image> &levels) {
+                mipmap::build(levels, mipmap::Filter::kaiser, true);
+            }),
+            timeBuild(base, runs, [](std::vector<Image> &levels) {
+                mipmap::build(levels, mipmap::Filter::kaiser, false);
+            }),
+        };
+        for(double t : times) {
+            if(t < 0.0) {
+                return 1;
+            }
+        }
+
+        std::printf("%4dx%-5d %13.3f %13.3f %13.3f %13.3f %13.3f\n", size,
+                size, times[0], times[1], times[2], times[3], times[4]);
+    }
+
+    return 0;
+}
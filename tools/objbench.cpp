@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "graphics/mesh.h"
+
+#include "utils/obj_loader.h"
+
+// OBJ parsing benchmark.
+// Times obj_loader::parseObj on the elephant asset, a small file parsed on the
+// calling thread, and on a synthetic grid of quads with millions of faces,
+// which is split across the loader pool. Reports the parse rate in MB/s and
+// how far deduplication shrank the vertices, each face corner having been a
+// vertex of its own before.
+
+/**
+ * Writes an OBJ of a flat grid of quads, each corner with a position, uv and
+ * normal
+ * @param path the file to write
+ * @param faces at least this many quads are written
+ * @return whether or not the file could be written
+ */
+static bool writeGrid(std::string const &path, size_t faces) {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if(!file) {
+        return false;
+    }
+
+    size_t side = 1;
+    while(side * side < faces) {
+        side++;
+    }
+    size_t verts = side + 1;
+
+    for(size_t y = 0; y < verts; y++) {
+        for(size_t x = 0; x < verts; x++) {
+            std::fprintf(file, "v %.4f 0.0 %.4f\n", x * 0.01, y * 0.01);
+        }
+    }
+    for(size_t y = 0; y < verts; y++) {
+        for(size_t x = 0; x < verts; x++) {
+            std::fprintf(file, "vt %.4f %.4f\n", (double) x / side,
+                    (double) y / side);
+        }
+    }
+    std::fprintf(file, "vn 0.0 1.0 0.0\n");
+
+    for(size_t y = 0; y < side; y++) {
+        for(size_t x = 0; x < side; x++) {
+            size_t a = y * verts + x + 1;
+            size_t b = a + 1;
+            size_t c = b + verts;
+            size_t d = a + verts;
+            std::fprintf(file, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n",
+                    a, a, b, b, c, c, d, d);
+        }
+    }
+
+    return std::fclose(file) == 0;
+}
+
+/**
+ * Parses a file a few times and prints the best run
+ * @return whether or not every run parsed
+ */
+static bool bench(std::string const &path, int runs) {
+    double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+    double best = 0.0;
+    MeshData data;
+    for(int run = 0; run < runs; run++) {
+        data = MeshData();
+        auto start = std::chrono::steady_clock::now();
+        if(!obj_loader::parseObj(data, path)) {
+            std::fprintf(stderr, "Could not parse %s\n", path.c_str());
+            return false;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        if(run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    // parseObj leaves the indices three to a triangle, one per corner
+    size_t corners = data.indices.size();
+    std::printf("%s\n", path.c_str());
+    std::printf("  %.2f MB in %.2f ms, %.1f MB/s\n", megabytes,
+            best * 1000.0, best > 0.0 ? megabytes / best : 0.0);
+    std::printf("  %zu triangles, %zu corners -> %zu vertices "
+            "(%.2f -> %.2f MB)\n", corners / 3, corners,
+            data.vertices.size(),
+            corners * sizeof(Vertex) / (1024.0 * 1024.0),
+            data.vertices.size() * sizeof(Vertex) / (1024.0 * 1024.0));
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t faces = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    int runs = 5;
+
+    if(!bench("assets/elephant/Mesh_Elephant.obj", runs)) {
+        return 1;
+    }
+
+    std::string grid = (std::filesystem::temp_directory_path()
+            / "objbench_grid.obj").string();
+    if(!writeGrid(grid, faces)) {
+        std::fprintf(stderr, "Could not write %s\n", grid.c_str());
+        return 1;
+    }
+    bool parsed = bench(grid, runs);
+    std::filesystem::remove(grid);
+
+    return parsed ? 0 : 1;
+}
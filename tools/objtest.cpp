@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "graphics/mesh.h"
+
+#include "utils/obj_loader.h"
+
+// Serial against parallel OBJ parsing check.
+// Writes OBJ files large enough to be split across the loader pool, full of
+// the lines a sloppy exporter leaves behind: attributes indented by spaces
+// and tabs, bare tags with no values, CRLF endings, unknown and garbage
+// lines, faces with relative indices or indices past what is defined, and
+// polygons of every size. Each file is parsed once split and once serially,
+// and the two meshes must match bit for bit.
+
+/**
+ * Writes a file of repeated blocks of awkward lines
+ * @param path the file to write
+ * @param bytes at least this many bytes are written
+ * @param variant picks the mix of lines, so each file splits differently
+ * @return whether or not the file could be written
+ */
+static bool writeObj(std::string const &path, size_t bytes, int variant) {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if(!file) {
+        return false;
+    }
+
+    char const *indents[] = { "", " ", "\t", "  \t " };
+    size_t written = 0;
+    for(int block = 0; written < bytes; block++) {
+        char const *indent = indents[(block + variant) % 4];
+        char const *eol = (block + variant) % 3 == 0 ? "\r\n" : "\n";
+        float x = block * 0.25f;
+
+        written += std::fprintf(file, "%sv %.3f %.3f 0.5%s", indent, x,
+                -x, eol);
+        written += std::fprintf(file, "%sv\t%.3f 1.0 +2.0%s", indent, x, eol);
+        written += std::fprintf(file, "v%s", eol);
+        written += std::fprintf(file, "%svt %.3f 0.75%s", indent, x, eol);
+        written += std::fprintf(file, "vt%s", eol);
+        written += std::fprintf(file, "%svn 0.0 1.0 0.0%s", indent, eol);
+        written += std::fprintf(file, " vn%s", eol);
+        written += std::fprintf(file, "vp 0.5 0.5%s", eol);
+        written += std::fprintf(file, "%s# v 9 9 9%s", indent, eol);
+        written += std::fprintf(file, "%s", eol);
+        written += std::fprintf(file, "vx garbage line%s", eol);
+        written += std::fprintf(file, "%sf -3/-2/-1 -2/-1/-2 -1/-2/-1%s",
+                indent, eol);
+        written += std::fprintf(file, "f -6 -5 -4 -3 -2%s", eol);
+        written += std::fprintf(file, "\tf %d//1 %d//1 %d//1 %d//1%s",
+                3 * block + 1, 3 * block + 2, 3 * block + 3,
+                3 * block + 9, eol);
+        if((block + variant) % 5 == 0) {
+            written += std::fprintf(file, "o part%d%s", block, eol);
+            written += std::fprintf(file, "  s off%s", eol);
+        }
+    }
+
+    // the last line without a newline
+    std::fprintf(file, "  v 1 2 3");
+    return std::fclose(file) == 0;
+}
+
+/**
+ * @return whether two meshes are identical, down to the bits of every float
+ */
+static bool same(MeshData const &a, MeshData const &b) {
+    return a.vertices.size() == b.vertices.size()
+        && a.indices == b.indices
+        && std::memcmp(a.vertices.data(), b.vertices.data(),
+                a.vertices.size() * sizeof(Vertex)) == 0
+        && std::memcmp(&a.bounds_min, &b.bounds_min, sizeof(glm::vec3)) == 0
+        && std::memcmp(&a.bounds_max, &b.bounds_max, sizeof(glm::vec3)) == 0;
+}
+
+int main() {
+    // comfortably past the size files start being split at
+    size_t const bytes = 6 << 20;
+    bool ok = true;
+
+    for(int variant = 0; variant < 3; variant++) {
+        std::string path = (std::filesystem::temp_directory_path()
+                / ("objtest_" + std::to_string(variant) + ".obj")).string();
+        if(!writeObj(path, bytes, variant)) {
+            std::fprintf(stderr, "Could not write %s\n", path.c_str());
+            return 1;
+        }
+
+        MeshData split, serial;
+        bool parsed = obj_loader::parseObj(split, path, true)
+            && obj_loader::parseObj(serial, path, false);
+        std::filesystem::remove(path);
+        if(!parsed) {
+            std::fprintf(stderr, "Could not parse variant %d\n", variant);
+            return 1;
+        }
+
+        bool match = same(split, serial) && !serial.indices.empty();
+        std::printf("variant %d: %zu triangles, %zu vertices, %s\n", variant,
+                serial.indices.size() / 3, serial.vertices.size(),
+                match ? "identical" : "DIFFERENT");
+        ok = ok && match;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "utils/ring_queue.h"
+#include "utils/tsq.h"
+
+// Queue contention benchmark.
+// Moves items from a number of producer threads to a number of consumer
+// threads through TSQ, through RingQueue with its blocking push and pop, and
+// through RingQueue polled with pushAsync and popAsync, for every mix of 1 to
+// 16 producers and consumers. Checks every item arrived exactly once by
+// summing them. The single producer, single consumer RingQueue runs on its
+// own first.
+
+/**
+ * @return the items that thread i of n handles out of count
+ */
+static size_t share(size_t count, size_t n, size_t i) {
+    return count / n + (i < count % n ? 1 : 0);
+}
+
+/**
+ * Times moving count items through a queue
+ * @param push pushes one item, called from producer threads
+ * @param pop pops one item, called from consumer threads
+ * @return millions of items per second, or a negative number if the items
+ *         that came out were not the ones that went in
+ */
+template <typename Push, typename Pop>
+static double transfer(size_t producers, size_t consumers, size_t count,
+        Push &&push, Pop &&pop) {
+    std::atomic<uint64_t> sum = 0;
+    std::atomic<bool> go = false;
+    std::vector<std::thread> threads;
+
+    size_t first = 0;
+    for(size_t p = 0; p < producers; p++) {
+        size_t n = share(count, producers, p);
+        threads.emplace_back([&push, &go, first, n]() {
+            while(!go.load()) {
+                std::this_thread::yield();
+            }
+            for(size_t i = first; i < first + n; i++) {
+                push(i + 1);
+            }
+        });
+        first += n;
+    }
+    for(size_t c = 0; c < consumers; c++) {
+        size_t n = share(count, consumers, c);
+        threads.emplace_back([&pop, &go, &sum, n]() {
+            while(!go.load()) {
+                std::this_thread::yield();
+            }
+            uint64_t local = 0;
+            for(size_t i = 0; i < n; i++) {
+                local += pop();
+            }
+            sum.fetch_add(local);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for(std::thread &t : threads) {
+        t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if(sum.load() != (uint64_t) count * (count + 1) / 2) {
+        return -1.0;
+    }
+    return count / std::chrono::duration<double>(end - start).count() / 1e6;
+}
+
+template <typename Queue>
+static double blocking(size_t producers, size_t consumers, size_t count) {
+    Queue queue;
+    return transfer(producers, consumers, count,
+        [&queue](size_t item) { queue.push(item); },
+        [&queue]() { return queue.pop(); });
+}
+
+template <typename Queue>
+static double polling(size_t producers, size_t consumers, size_t count) {
+    Queue queue;
+    return transfer(producers, consumers, count,
+        [&queue](size_t item) {
+            while(!queue.pushAsync(item)) {
+                std::this_thread::yield();
+            }
+        },
+        [&queue]() {
+            size_t item;
+            while(!queue.popAsync(item)) {
+                std::this_thread::yield();
+            }
+            return item;
+        });
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    bool failed = false;
+
+    double spsc_blocking
+        = blocking<RingQueue<size_t, RingSharing::spsc>>(1, 1, count);
+    double spsc_polling
+        = polling<RingQueue<size_t, RingSharing::spsc>>(1, 1, count);
+    std::printf("%zu items, million items/s\n", count);
+    std::printf("spsc ring: blocking %.2f, polling %.2f\n", spsc_blocking,
+            spsc_polling);
+    failed |= spsc_blocking < 0.0 || spsc_polling < 0.0;
+
+    std::printf("%9s %9s %10s %14s %14s\n", "producers", "consumers", "TSQ",
+            "ring blocking", "ring polling");
+    for(size_t producers = 1; producers <= 16; producers *= 2) {
+        for(size_t consumers = 1; consumers <= 16; consumers *= 2) {
+            double tsq = blocking<TSQ<size_t>>(producers, consumers, count);
+            double ring = blocking<RingQueue<size_t>>(producers, consumers,
+                    count);
+            double ring_polling = polling<RingQueue<size_t>>(producers,
+                    consumers, count);
+            std::printf("%9zu %9zu %10.2f %14.2f %14.2f\n", producers,
+                    consumers, tsq, ring, ring_polling);
+            failed |= tsq < 0.0 || ring < 0.0 || ring_polling < 0.0;
+        }
+    }
+
+    if(failed) {
+        std::fprintf(stderr, "items were lost or duplicated\n");
+        return 1;
+    }
+    return 0;
+}
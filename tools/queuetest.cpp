@@ -0,0 +1,159 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "utils/ring_queue.h"
+
+// Parked waiter check.
+// Parks two threads on one atomic through the ring queue's await, each
+// wanting a different value, waits until both are counted as parked, then
+// publishes the values one at a time. Each thread must wake for its own
+// value, and the one still waiting must stay parked until its value comes.
+// Then does the same through the queue itself, with three pops or three
+// pushes blocked on a queue of two cells, so two of them share a cell.
+// A watchdog fails the check if any round stops making progress.
+
+static std::atomic<unsigned> progress = 0;
+static std::atomic<char const *> stage = "";
+
+/**
+ * Fails the check if progress stops moving for a few seconds
+ * @param finished set once every round is done
+ */
+static void watch(std::atomic<bool> const &finished) {
+    unsigned seen = progress.load();
+    auto last = std::chrono::steady_clock::now();
+    while(!finished.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto now = std::chrono::steady_clock::now();
+        if(progress.load() != seen) {
+            seen = progress.load();
+            last = now;
+        }
+        else if(now - last > std::chrono::seconds(5)) {
+            std::fprintf(stderr, "a parked thread was never woken: %s\n",
+                    stage.load());
+            std::fflush(stderr);
+            std::_Exit(1);
+        }
+    }
+}
+
+/**
+ * Parks two threads on one atomic and wakes them one after the other
+ * @return whether each thread woke for its own value and not before
+ */
+static bool twoWaiters() {
+    std::atomic<size_t> value = 0;
+    std::atomic<unsigned> parked = 0;
+    std::atomic<size_t> woken[2] = { 0, 0 };
+
+    std::vector<std::thread> threads;
+    for(size_t want = 1; want <= 2; want++) {
+        threads.emplace_back([&, want]() {
+            ring_queue::await(value, parked,
+                [want](size_t v) { return v == want; });
+            woken[want - 1].store(value.load());
+        });
+    }
+
+    // only publish once both are past spinning
+    while(parked.load() != 2) {
+        std::this_thread::yield();
+    }
+
+    ring_queue::publish(value, 1, parked);
+    threads[0].join();
+    progress++;
+    bool ok = woken[0].load() == 1 && woken[1].load() == 0;
+
+    ring_queue::publish(value, 2, parked);
+    threads[1].join();
+    progress++;
+    return ok && woken[1].load() == 2 && parked.load() == 0;
+}
+
+/**
+ * Blocks three pops on an empty queue of two cells, then pushes their items
+ * @return whether every item came out once
+ */
+static bool sharedCellPops() {
+    RingQueue<int> queue(2);
+    std::atomic<int> sum = 0;
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 3; i++) {
+        threads.emplace_back([&]() { sum.fetch_add(queue.pop()); });
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+    for(int item = 1; item <= 3; item++) {
+        queue.push(item);
+    }
+    for(std::thread &thread : threads) {
+        thread.join();
+    }
+    progress++;
+    return sum.load() == 6;
+}
+
+/**
+ * Blocks three pushes on a full queue of two cells, then pops every item
+ * @return whether every item came out once
+ */
+static bool sharedCellPushes() {
+    RingQueue<int> queue(2);
+    queue.push(1);
+    queue.push(2);
+
+    std::vector<std::thread> threads;
+    for(int item = 3; item <= 5; item++) {
+        threads.emplace_back([&queue, item]() { queue.push(item); });
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+    int sum = 0;
+    for(int i = 0; i < 5; i++) {
+        sum += queue.pop();
+    }
+    for(std::thread &thread : threads) {
+        thread.join();
+    }
+    progress++;
+    return sum == 15;
+}
+
+int main() {
+    int const rounds = 1000;
+    bool ok = true;
+
+    std::atomic<bool> finished = false;
+    std::thread watchdog(watch, std::cref(finished));
+
+    stage = "two waiters on one atomic";
+    for(int i = 0; i < rounds && ok; i++) {
+        ok = twoWaiters();
+    }
+    std::printf("two waiters on one atomic: %s\n", ok ? "ok" : "FAILED");
+
+    stage = "pops sharing a cell";
+    bool pops = true;
+    for(int i = 0; i < rounds && pops; i++) {
+        pops = sharedCellPops();
+    }
+    std::printf("pops sharing a cell: %s\n", pops ? "ok" : "FAILED");
+
+    stage = "pushes sharing a cell";
+    bool pushes = true;
+    for(int i = 0; i < rounds && pushes; i++) {
+        pushes = sharedCellPushes();
+    }
+    std::printf("pushes sharing a cell: %s\n", pushes ? "ok" : "FAILED");
+
+    finished = true;
+    watchdog.join();
+    return ok && pops && pushes ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#ifndef TOOLS_RECORDING_GL_H
+#define TOOLS_RECORDING_GL_H
+
+#include <vector>
+
+#include <glad/gl.h>
+
+/**
+ * A stand-in for the OpenGL entry points the scene draws through, so that
+ * its draw path can be checked without a window or a context. glad calls
+ * everything through function pointers, which install points at recorders
+ * that hand out names, track the bound program and vertex array, and log
+ * each instanced draw. Nothing is allocated once the draw log has grown to
+ * fit a frame.
+ */
+namespace recording_gl {
+
+struct Draw {
+    unsigned int program;
+    unsigned int vertex_array;
+    int count;
+    int instances;
+    unsigned int base_instance;
+};
+
+struct State {
+    unsigned int next_name = 1;
+    unsigned int program = 0;
+    unsigned int vertex_array = 0;
+    unsigned int calls = 0;
+    std::vector<Draw> draws;
+};
+
+inline State state;
+
+static void GLAD_API_PTR genNames(GLsizei n, GLuint *names) {
+    for(GLsizei i = 0; i < n; i++) {
+        names[i] = state.next_name++;
+    }
+    state.calls++;
+}
+
+static void GLAD_API_PTR deleteNames(GLsizei, GLuint const *) {
+    state.calls++;
+}
+
+static void GLAD_API_PTR useProgram(GLuint program) {
+    state.program = program;
+    state.calls++;
+}
+
+static void GLAD_API_PTR bindVertexArray(GLuint vertex_array) {
+    state.vertex_array = vertex_array;
+    state.calls++;
+}
+
+static void GLAD_API_PTR drawElementsInstancedBaseInstance(GLenum,
+        GLsizei count, GLenum, void const *, GLsizei instances,
+        GLuint base_instance) {
+    state.draws.push_back({ state.program, state.vertex_array, count,
+        instances, base_instance });
+    state.calls++;
+}
+
+// everything else only counts as a call, whatever it takes
+template <typename... Args>
+static void GLAD_API_PTR ignore(Args...) {
+    state.calls++;
+}
+
+/**
+ * Points glad's function pointers at the recorders
+ */
+inline void install() {
+    glad_glGenBuffers = genNames;
+    glad_glGenVertexArrays = genNames;
+    glad_glGenTextures = genNames;
+    glad_glDeleteBuffers = deleteNames;
+    glad_glDeleteVertexArrays = deleteNames;
+    glad_glDeleteTextures = deleteNames;
+    glad_glUseProgram = useProgram;
+    glad_glBindVertexArray = bindVertexArray;
+    glad_glDrawElementsInstancedBaseInstance
+        = drawElementsInstancedBaseInstance;
+
+    glad_glActiveTexture = ignore;
+    glad_glEnableVertexAttribArray = ignore;
+    glad_glBindBuffer = ignore;
+    glad_glBindTexture = ignore;
+    glad_glVertexAttribDivisor = ignore;
+    glad_glUniform1i = ignore;
+    glad_glUniform1f = ignore;
+    glad_glUniform3fv = ignore;
+    glad_glUniformMatrix4fv = ignore;
+    glad_glBindBufferBase = ignore;
+    glad_glBufferData = ignore;
+    glad_glBufferSubData = ignore;
+    glad_glVertexAttribPointer = ignore;
+
+    state.draws.reserve(1024);
+}
+
+};
+
+#endif // TOOLS_RECORDING_GL_H
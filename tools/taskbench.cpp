@@ -0,0 +1,172 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <latch>
+#include <thread>
+#include <vector>
+
+#include "threading/thread.h"
+#include "utils/tsq.h"
+
+// Task throughput benchmark.
+// Runs a large number of tiny tasks through ThreadPool at a range of thread
+// counts, and through the pool it replaced, which had every thread take
+// commands from one shared TSQ. Tasks are queued two ways: all from the main
+// thread, and as a binary tree where each task queues its two children, the
+// way jobs queue the jobs that depend on them.
+
+/**
+ * The previous ThreadPool, kept as the baseline: one locked queue shared by
+ * every thread
+ */
+class SharedQueuePool {
+private:
+
+    struct Command {
+        enum { run, die } cmd;
+        std::function<void ()> func;
+    };
+
+    TSQ<Command> commandQueue;
+    std::vector<std::thread> threads;
+
+    static void runner(TSQ<Command> &commandQueue) {
+        while(true) {
+            Command cmd = commandQueue.pop();
+            if(cmd.cmd == Command::die) {
+                return;
+            }
+            std::invoke(cmd.func);
+        }
+    }
+
+public:
+
+    SharedQueuePool(unsigned n) {
+        for(unsigned i = 0; i < n; i++) {
+            threads.emplace_back(runner, std::ref(commandQueue));
+        }
+    }
+
+    ~SharedQueuePool() {
+        for(size_t i = 0; i < threads.size(); i++) {
+            commandQueue.push({ Command::die, nullptr });
+        }
+        for(std::thread &t : threads) {
+            t.join();
+        }
+    }
+
+    template <typename Callable>
+    void run(Callable &&func) {
+        commandQueue.push({ Command::run, std::forward<Callable>(func) });
+    }
+};
+
+// the work in each task, small enough that queueing costs dominate
+static std::atomic<unsigned> sink;
+static void work() {
+    unsigned x = 1;
+    for(int i = 0; i < 32; i++) {
+        x = x * 1664525u + 1013904223u;
+    }
+    sink.fetch_add(x, std::memory_order_relaxed);
+}
+
+/**
+ * Counts finished tasks down, letting the main thread go after the last
+ */
+struct Countdown {
+    std::atomic<size_t> left;
+    std::latch done;
+
+    Countdown(size_t count) : left(count), done(1) { }
+
+    void finish() {
+        if(left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.count_down();
+        }
+    }
+};
+
+template <typename Pool>
+static void spawn(Pool &pool, Countdown &countdown, int depth) {
+    work();
+    if(depth > 0) {
+        pool.run([&pool, &countdown, depth]() {
+            spawn(pool, countdown, depth - 1);
+        });
+        pool.run([&pool, &countdown, depth]() {
+            spawn(pool, countdown, depth - 1);
+        });
+    }
+    countdown.finish();
+}
+
+/**
+ * @return tasks per second for tasks all queued by the calling thread
+ */
+template <typename Pool>
+static double flat(unsigned threads, size_t count) {
+    Pool pool(threads);
+    Countdown countdown(count);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; i++) {
+        pool.run([&countdown]() {
+            work();
+            countdown.finish();
+        });
+    }
+    countdown.done.wait();
+    auto end = std::chrono::steady_clock::now();
+    return count / std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * @return tasks per second for a tree of tasks queued by their parents
+ */
+template <typename Pool>
+static double tree(unsigned threads, int depth) {
+    Pool pool(threads);
+    size_t count = (size_t(2) << depth) - 1;
+    Countdown countdown(count);
+    auto start = std::chrono::steady_clock::now();
+    pool.run([&pool, &countdown, depth]() {
+        spawn(pool, countdown, depth);
+    });
+    countdown.done.wait();
+    auto end = std::chrono::steady_clock::now();
+    return count / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int depth = 0;
+    while((size_t(2) << (depth + 1)) - 1 <= count) {
+        depth++;
+    }
+
+    std::vector<unsigned> thread_counts = { 1, 2, 4, 8 };
+    unsigned hardware = std::thread::hardware_concurrency();
+    if(hardware > thread_counts.back()) {
+        thread_counts.push_back(hardware);
+    }
+
+    std::printf("%zu queued from main, %zu in a tree, million tasks/s\n",
+            count, (size_t(2) << depth) - 1);
+    std::printf("%8s %14s %14s %14s %14s\n", "threads", "shared flat",
+            "stealing flat", "shared tree", "stealing tree");
+    for(unsigned threads : thread_counts) {
+        double shared_flat = flat<SharedQueuePool>(threads, count);
+        double stealing_flat = flat<ThreadPool>(threads, count);
+        double shared_tree = tree<SharedQueuePool>(threads, depth);
+        double stealing_tree = tree<ThreadPool>(threads, depth);
+        std::printf("%8u %14.2f %14.2f %14.2f %14.2f\n", threads,
+                shared_flat / 1e6, stealing_flat / 1e6, shared_tree / 1e6,
+                stealing_tree / 1e6);
+    }
+
+    return 0;
+}
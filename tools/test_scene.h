@@ -0,0 +1,77 @@
+#ifndef TOOLS_TEST_SCENE_H
+#define TOOLS_TEST_SCENE_H
+
+#include <utility>
+#include <vector>
+
+#include <glad/gl.h>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "graphics/material.h"
+#include "graphics/mesh.h"
+#include "graphics/model.h"
+#include "graphics/shader.h"
+#include "graphics/vertex.h"
+
+// Models and shaders for the checks that draw a scene through the recording
+// GL, built in memory instead of loaded from assets and linked.
+
+/**
+ * Builds a model of unit cubes side by side, with a material of its own
+ * @param meshes the number of meshes
+ * @param diffuse the id to give the diffuse texture, which sorts the model
+ *                apart from the others
+ */
+inline Model makeModel(int meshes, unsigned int diffuse) {
+    Model model;
+    model.bounds_min = glm::vec3(-0.5f);
+    model.bounds_max = glm::vec3(-0.5f + meshes, 0.5f, 0.5f);
+    model.center = (model.bounds_min + model.bounds_max) * 0.5f;
+    model.radius = glm::length(model.bounds_max - model.center);
+
+    for(int i = 0; i < meshes; i++) {
+        glm::vec3 min(-0.5f + i, -0.5f, -0.5f);
+        glm::vec3 max(0.5f + i, 0.5f, 0.5f);
+
+        std::vector<Vertex> vertices;
+        for(int corner = 0; corner < 8; corner++) {
+            glm::vec3 position(corner & 1 ? max.x : min.x,
+                    corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z);
+            vertices.push_back({ position, glm::vec3(0.0f), glm::vec2(0.0f) });
+        }
+        std::vector<unsigned int> indices = {
+            0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+            2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5
+        };
+
+        Material material{};
+        material.diffuse.id = diffuse;
+        material.shininess = 16.0f * (i + 1);
+
+        Mesh mesh;
+        mesh.create(std::move(vertices), std::move(indices), { material });
+        mesh.setBounds(min, max);
+        model.meshes.push_back(std::move(mesh));
+    }
+    return model;
+}
+
+/**
+ * Makes a shader program as linking would leave it, with the material
+ * uniforms the scene sets
+ */
+inline ShaderProgram makeShader(unsigned int id) {
+    ShaderProgram shader;
+    shader.id = id;
+    shader.uniforms = {
+        { "mat.ambient", 1, GL_SAMPLER_2D, 1 },
+        { "mat.diffuse", 0, GL_SAMPLER_2D, 1 },
+        { "mat.shininess", 3, GL_FLOAT, 1 },
+        { "mat.specular", 2, GL_SAMPLER_2D, 1 },
+    };
+    return shader;
+}
+
+#endif // TOOLS_TEST_SCENE_H
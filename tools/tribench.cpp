@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "utils/triangulator.h"
+
+// Polygon triangulation benchmark.
+// Times Triangulator on polygons from a triangle up to 10k corners, in two
+// shapes: a convex circle, which is fanned, and a star whose every other
+// corner is reflex, which is split into monotone pieces by the sweep.
+// Each result is checked for n - 2 triangles covering the polygon's area.
+
+enum class Shape { convex, reflex };
+
+/**
+ * Builds a polygon in the xz plane, counter-clockwise seen from above
+ * @param shape convex for a circle, reflex for a star
+ * @param corners the number of corners
+ */
+static std::vector<glm::vec3> makePolygon(Shape shape, unsigned corners) {
+    std::vector<glm::vec3> polygon;
+    polygon.reserve(corners);
+    for(unsigned i = 0; i < corners; i++) {
+        float angle = 6.28318530718f * i / corners;
+        float radius = shape == Shape::reflex && corners > 3 && i % 2 == 1
+            ? 0.5f : 1.0f;
+        polygon.emplace_back(radius * std::cos(angle), 0.0f,
+                -radius * std::sin(angle));
+    }
+    return polygon;
+}
+
+/**
+ * @return the area of a polygon in the xz plane
+ */
+static double area(std::vector<glm::vec3> const &polygon) {
+    double sum = 0.0;
+    for(size_t i = 0; i < polygon.size(); i++) {
+        glm::vec3 const &a = polygon[i];
+        glm::vec3 const &b = polygon[(i + 1) % polygon.size()];
+        sum += (double) a.x * b.z - (double) b.x * a.z;
+    }
+    return std::fabs(sum) * 0.5;
+}
+
+/**
+ * @return the summed area of the triangles of a triangulation
+ */
+static double area(std::vector<glm::vec3> const &polygon,
+        std::vector<unsigned int> const &indices) {
+    double sum = 0.0;
+    for(size_t i = 0; i + 2 < indices.size(); i += 3) {
+        sum += area({ polygon[indices[i]], polygon[indices[i + 1]],
+                polygon[indices[i + 2]] });
+    }
+    return sum;
+}
+
+int main() {
+    unsigned const sizes[] = { 3, 4, 8, 16, 64, 256, 1024, 4096, 10000 };
+    // enough runs at every size to triangulate about this many corners
+    size_t const corners_per_size = 1000000;
+
+    Triangulator triangulator;
+    std::vector<unsigned int> indices;
+
+    std::printf("%8s %10s %14s %14s\n", "corners", "shape", "us/polygon",
+            "ns/corner");
+    for(Shape shape : { Shape::convex, Shape::reflex }) {
+        for(unsigned corners : sizes) {
+            std::vector<glm::vec3> polygon = makePolygon(shape, corners);
+            size_t runs = corners_per_size / corners;
+
+            // once to warm the scratch space up and check the result
+            indices.clear();
+            triangulator.triangulate(polygon, 0, indices);
+            double expected = area(polygon);
+            if(indices.size() != 3 * (size_t) (corners - 2)
+                    || std::fabs(area(polygon, indices) - expected)
+                        > 1e-3 * expected) {
+                std::fprintf(stderr, "bad triangulation of %u corners\n",
+                        corners);
+                return 1;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for(size_t run = 0; run < runs; run++) {
+                indices.clear();
+                triangulator.triangulate(polygon, 0, indices);
+            }
+            auto end = std::chrono::steady_clock::now();
+            double ns
+                = std::chrono::duration<double, std::nano>(end - start).count()
+                / runs;
+
+            std::printf("%8u %10s %14.3f %14.2f\n", corners,
+                    shape == Shape::convex ? "convex" : "reflex", ns / 1000.0,
+                    ns / corners);
+        }
+    }
+
+    return 0;
+}